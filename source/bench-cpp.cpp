@@ -0,0 +1,231 @@
+#include "fdt.hpp"
+#include "bench-dt.h"
+#include <stdio.h>
+
+
+#define BENCH_ROUNDS                20
+#define BENCH_CELLS                 4096
+
+
+typedef struct bench_result {
+    uint64_t c_ns;
+    uint64_t cpp_ns;
+    uint64_t c_sum;
+    uint64_t cpp_sum;
+
+}bench_result_t;
+
+
+static __attribute__((noinline)) uint64_t bench_walk_c(fdt_node_t *node)
+{
+    fdt_node_t *child = NULL;
+    fdt_prop_t *prop = NULL;
+    uint64_t sum = node->name_len;
+
+    fdt_for_each_node_prop(node, prop) {
+        sum += prop->name_len + fdt_get_prop_value_size(prop);
+    }
+    fdt_for_each_node_child(node, child) {
+        sum += bench_walk_c(child);
+    }
+
+    return sum;
+}
+
+
+static __attribute__((noinline)) uint64_t bench_walk_cpp(fdt::node node)
+{
+    uint64_t sum = node.get()->name_len;
+
+    for(fdt::prop prop : node.props()) {
+        sum += prop.name().size() + prop.value_size();
+    }
+    for(fdt::node child : node.children()) {
+        sum += bench_walk_cpp(child);
+    }
+
+    return sum;
+}
+
+
+static __attribute__((noinline)) uint64_t bench_read_c(fdt_node_t *root)
+{
+    fdt_node_t *top = NULL;
+    fdt_node_t *child = NULL;
+    uint64_t sum = 0;
+
+    fdt_for_each_node_child(root, top) {
+        fdt_for_each_node_child(top, child) {
+            uint32_t reg = 0;
+            const char *compatible = fdt_read_prop_string(child, "compatible");
+
+            if(fdt_read_prop_u32(child, "reg", &reg) == 0) {
+                sum += reg;
+            }
+            sum += compatible ? compatible[0] : 0;
+        }
+    }
+
+    return sum;
+}
+
+
+static __attribute__((noinline)) uint64_t bench_read_cpp(fdt::node root)
+{
+    uint64_t sum = 0;
+
+    for(fdt::node top : root.children()) {
+        for(fdt::node child : top.children()) {
+            std::optional<std::string_view> compatible = child.read<std::string_view>("compatible");
+
+            sum += child.read<uint32_t>("reg").value_or(0);
+            sum += compatible ? compatible->front() : 0;
+        }
+    }
+
+    return sum;
+}
+
+
+static __attribute__((noinline)) uint64_t bench_cells_c(fdt_node_t *node)
+{
+    fdt_prop_t *prop = fdt_find_prop_by_name(node, "table");
+    const uint8_t *cells = NULL;
+    uint8_t cell_size = 0;
+    uint32_t count = 0;
+    uint64_t sum = 0;
+
+    if(prop == NULL || fdt_get_prop_cells(prop, (const void**)&cells, &cell_size, &count) || cell_size != 4) {
+        return 0;
+    }
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t cell = 0;
+        memcpy(&cell, cells + i * 4, 4);
+        sum += cell;
+    }
+
+    return sum;
+}
+
+
+static __attribute__((noinline)) uint64_t bench_cells_index(fdt_node_t *node)
+{
+    uint64_t sum = 0;
+    size_t cell = 0;
+
+    for(uint32_t i = 0; fdt_read_prop_int_index(node, "table", i, &cell) == 0; i++) {
+        sum += cell;
+    }
+
+    return sum;
+}
+
+
+static __attribute__((noinline)) uint64_t bench_cells_cpp(fdt::node node)
+{
+    std::optional<fdt::cells> cells = node.read_cells("table");
+    std::optional<fdt::cell_span<uint32_t>> span = cells ? cells->as<uint32_t>() : std::nullopt;
+    uint64_t sum = 0;
+
+    if(!span) {
+        return 0;
+    }
+    for(uint32_t cell : *span) {
+        sum += cell;
+    }
+
+    return sum;
+}
+
+
+static __attribute__((noinline)) uint64_t bench_cells_any_cpp(fdt::node node)
+{
+    std::optional<fdt::cells> cells = node.read_cells("table");
+    uint64_t sum = 0;
+
+    if(!cells) {
+        return 0;
+    }
+    for(uint64_t cell : *cells) {
+        sum += cell;
+    }
+
+    return sum;
+}
+
+
+template<typename C, typename CPP>
+static void bench_run(const char *name, C c_fn, CPP cpp_fn)
+{
+    bench_result_t result = {UINT64_MAX, UINT64_MAX, 0, 0};
+
+    for(int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t begin = bench_now_ns();
+        result.c_sum = c_fn();
+        uint64_t middle = bench_now_ns();
+        result.cpp_sum = cpp_fn();
+        uint64_t end = bench_now_ns();
+
+        result.c_ns = middle - begin < result.c_ns ? middle - begin : result.c_ns;
+        result.cpp_ns = end - middle < result.cpp_ns ? end - middle : result.cpp_ns;
+    }
+
+    printf("  %-24s c %9.3f us, c++ %9.3f us, %s\n", name, result.c_ns / 1e3, result.cpp_ns / 1e3,
+           result.c_sum == result.cpp_sum ? "same result" : "MISMATCH");
+}
+
+
+int main(void)
+{
+    bench_dt_t dt = {.top = 64, .children = 64, .props = 8, .flags = FDT_FLAG_NAME_HASH};
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t size = 0;
+    static uint64_t table[BENCH_CELLS];
+
+    // the shape of bench_dt_build() with an array property under /node0
+    for(uint32_t i = 0; i < BENCH_CELLS; i++) {
+        table[i] = 0x80000000u + i * 7;
+    }
+    fdt_writer_init(&writer, NULL, 0, 0x260101, dt.flags);
+    for(uint32_t top = 0; top < dt.top; top++) {
+        char name[16];
+        snprintf(name, sizeof(name), "node%" PRIu32, top);
+        fdt_writer_begin_node(&writer, name);
+        if(top == 0) {
+            fdt_writer_prop_array(&writer, "table", table, BENCH_CELLS);
+        }
+        for(uint32_t child = 0; child < dt.children; child++) {
+            snprintf(name, sizeof(name), "child%" PRIu32, child);
+            fdt_writer_begin_node(&writer, name);
+            fdt_writer_prop_string(&writer, "compatible", "bench,device");
+            fdt_writer_prop_int(&writer, "reg", 0x10000000u + top * 0x10000u + child * 0x100u);
+            for(uint32_t k = 0; k < dt.props; k++) {
+                snprintf(name, sizeof(name), "prop%" PRIu32, k);
+                fdt_writer_prop_int(&writer, name, k);
+            }
+            fdt_writer_end_node(&writer);
+        }
+        fdt_writer_end_node(&writer);
+    }
+
+    if(fdt_writer_finish(&writer, &blob, &size) || fdt_load(blob, size)) {
+        FDT_LOG_ERROR("load blob failed\n");
+        fdt_writer_release(&writer);
+        return -1;
+    }
+
+    fdt_node_t *root = fdt_get_root_node();
+    fdt_node_t *node0 = fdt_find_node_by_path("/node0");
+
+    printf("================== C++ WRAPPER ================\n");
+    printf("blob: %" PRIu32 " bytes, %" PRIu32 " nodes\n", size, 1 + dt.top * (dt.children + 1));
+    bench_run("walk nodes and props", [&] { return bench_walk_c(root); }, [&] { return bench_walk_cpp(root); });
+    bench_run("read reg and compatible", [&] { return bench_read_c(root); }, [&] { return bench_read_cpp(root); });
+    bench_run("sum 4096 cells", [&] { return bench_cells_c(node0); }, [&] { return bench_cells_cpp(node0); });
+    bench_run("sum cells by index", [&] { return bench_cells_index(node0); }, [&] { return bench_cells_any_cpp(node0); });
+
+    fdt_unload();
+    fdt_writer_release(&writer);
+    return 0;
+}
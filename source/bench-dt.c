@@ -0,0 +1,273 @@
+/*
+ * File Name: bench-dt.c
+ *
+ * Copyright 2024-, lishanwen (1477153217@qq.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bench-dt.h"
+#include <time.h>
+
+
+/**
+ * @brief build synthetic blob
+ * 
+ * @param dt: shape of tree
+ * @param writer: writer
+ * @param blob: blob data
+ * @param size: blob size
+ * @return int: 0: success, -1: fail
+ */
+int bench_dt_build(const bench_dt_t *dt, fdt_writer_t *writer, const void **blob, uint32_t *size)
+{
+    char name[32];
+
+    fdt_writer_init(writer, NULL, 0, 0x260101, dt->flags);
+
+    for(uint32_t i = 0; i < dt->top; i++) {
+        snprintf(name, sizeof(name), "node%"PRIu32, i);
+        fdt_writer_begin_node(writer, name);
+        fdt_writer_prop_string(writer, "compatible", "bench,bus");
+
+        for(uint32_t j = 0; j < dt->children; j++) {
+            snprintf(name, sizeof(name), "child%"PRIu32, j);
+            fdt_writer_begin_node(writer, name);
+            fdt_writer_prop_string(writer, "compatible", "bench,device");
+            fdt_writer_prop_int(writer, "reg", 0x10000000u + i * 0x10000u + j * 0x100u);
+
+            for(uint32_t k = 0; k < dt->props; k++) {
+                snprintf(name, sizeof(name), "prop%"PRIu32, k);
+                fdt_writer_prop_int(writer, name, k);
+            }
+            fdt_writer_end_node(writer);
+        }
+        fdt_writer_end_node(writer);
+    }
+
+    return fdt_writer_finish(writer, blob, size);
+}
+
+
+/**
+ * @brief standard dtb under construction
+ * @buf: structure block.
+ * @size: size of structure block.
+ * @cap: capacity of structure block.
+ * @strings: strings block.
+ * @strings_size: size of strings block.
+ * @error: set if the structure block can not grow.
+ */
+typedef struct bench_dtb {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t cap;
+    char strings[512];
+    uint32_t strings_size;
+    int error;
+
+}bench_dtb_t;
+
+
+static void bench_dtb_put(bench_dtb_t *dtb, const void *data, uint32_t len)
+{
+    uint32_t padded = (len + 3) & ~3u;
+
+    if(dtb->error) {
+        return;
+    }
+
+    if(dtb->size + padded > dtb->cap) {
+        uint32_t cap = dtb->cap ? dtb->cap * 2 : 4096;
+        while(dtb->size + padded > cap) {
+            cap *= 2;
+        }
+
+        uint8_t *buf = realloc(dtb->buf, cap);
+        if(buf == NULL) {
+            dtb->error = -1;
+            return;
+        }
+        dtb->buf = buf;
+        dtb->cap = cap;
+    }
+
+    fdt_memcpy(dtb->buf + dtb->size, data, len);
+    fdt_memset(dtb->buf + dtb->size + len, 0, padded - len);
+    dtb->size += padded;
+}
+
+
+static void bench_dtb_put_be32(bench_dtb_t *dtb, uint32_t value)
+{
+    uint8_t be[4] = {value >> 24, value >> 16, value >> 8, value};
+    bench_dtb_put(dtb, be, 4);
+}
+
+
+static void bench_dtb_prop(bench_dtb_t *dtb, const char *name, const void *value, uint32_t len)
+{
+    uint32_t off = 0;
+
+    // names are few, a linear search is enough
+    while(off < dtb->strings_size && strcmp(dtb->strings + off, name)) {
+        off += strlen(dtb->strings + off) + 1;
+    }
+    if(off == dtb->strings_size) {
+        fdt_memcpy(dtb->strings + off, name, strlen(name) + 1);
+        dtb->strings_size += strlen(name) + 1;
+    }
+
+    bench_dtb_put_be32(dtb, 0x3);
+    bench_dtb_put_be32(dtb, len);
+    bench_dtb_put_be32(dtb, off);
+    if(len) {
+        bench_dtb_put(dtb, value, len);
+    }
+}
+
+
+static void bench_dtb_prop_cells(bench_dtb_t *dtb, const char *name, const uint32_t *cells, uint32_t count)
+{
+    uint8_t be[16];
+
+    for(uint32_t i = 0; i < count; i++) {
+        be[i * 4 + 0] = cells[i] >> 24;
+        be[i * 4 + 1] = cells[i] >> 16;
+        be[i * 4 + 2] = cells[i] >> 8;
+        be[i * 4 + 3] = cells[i];
+    }
+    bench_dtb_prop(dtb, name, be, count * 4);
+}
+
+
+static void bench_dtb_begin_node(bench_dtb_t *dtb, const char *name)
+{
+    bench_dtb_put_be32(dtb, 0x1);
+    bench_dtb_put(dtb, name, strlen(name) + 1);
+}
+
+
+/**
+ * @brief build standard dtb of synthetic tree, as dtc would emit it
+ * 
+ * @param dt: shape of tree
+ * @param dtb: dtb data, free it with free()
+ * @param size: dtb size
+ * @return int: 0: success, -1: fail
+ */
+int bench_dtb_build(const bench_dt_t *dt, uint8_t **dtb, uint32_t *size)
+{
+    static const char device[] = "vendor,device-v2\0bench,device";
+    bench_dtb_t b = {0};
+    char name[32];
+    uint32_t one = 1;
+
+    bench_dtb_begin_node(&b, "");
+    bench_dtb_prop(&b, "compatible", "bench,board", sizeof("bench,board"));
+    bench_dtb_prop(&b, "model", "bench board", sizeof("bench board"));
+    bench_dtb_prop_cells(&b, "#address-cells", &one, 1);
+    bench_dtb_prop_cells(&b, "#size-cells", &one, 1);
+
+    for(uint32_t i = 0; i < dt->top; i++) {
+        uint32_t base = 0x10000000u + i * 0x10000u;
+
+        snprintf(name, sizeof(name), "bus@%"PRIx32, base);
+        bench_dtb_begin_node(&b, name);
+        bench_dtb_prop(&b, "compatible", "bench,bus", sizeof("bench,bus"));
+        bench_dtb_prop_cells(&b, "#address-cells", &one, 1);
+        bench_dtb_prop_cells(&b, "#size-cells", &one, 1);
+        bench_dtb_prop(&b, "ranges", NULL, 0);
+
+        for(uint32_t j = 0; j < dt->children; j++) {
+            uint32_t reg[2] = {base + j * 0x100u, 0x100};
+            uint32_t irq[3] = {0, i * dt->children + j, 4};
+            uint32_t clk[2] = {1, j};
+
+            snprintf(name, sizeof(name), "device@%"PRIx32, reg[0]);
+            bench_dtb_begin_node(&b, name);
+            bench_dtb_prop(&b, "compatible", device, sizeof(device));
+            bench_dtb_prop_cells(&b, "reg", reg, 2);
+            bench_dtb_prop_cells(&b, "interrupts", irq, 3);
+            bench_dtb_prop_cells(&b, "clocks", clk, 2);
+            bench_dtb_prop(&b, "status", "okay", sizeof("okay"));
+
+            for(uint32_t k = 0; k < dt->props; k++) {
+                snprintf(name, sizeof(name), "prop%"PRIu32, k);
+                bench_dtb_prop_cells(&b, name, &k, 1);
+            }
+            bench_dtb_put_be32(&b, 0x2);
+        }
+        bench_dtb_put_be32(&b, 0x2);
+    }
+    bench_dtb_put_be32(&b, 0x2);
+    bench_dtb_put_be32(&b, 0x9);
+
+    // header, an empty memory reservation block, structure and strings
+    uint32_t off_struct = 40 + 16;
+    uint32_t off_strings = off_struct + b.size;
+    uint32_t total = off_strings + b.strings_size;
+    uint32_t header[10] = {
+        FDT_DTB_MAGIC, total, off_struct, off_strings, 40, 17, 16, 0, b.strings_size, b.size
+    };
+
+    *dtb = calloc(1, total);
+    if(*dtb == NULL || b.error) {
+        free(*dtb);
+        free(b.buf);
+        return -1;
+    }
+
+    for(uint32_t i = 0; i < 10; i++) {
+        (*dtb)[i * 4 + 0] = header[i] >> 24;
+        (*dtb)[i * 4 + 1] = header[i] >> 16;
+        (*dtb)[i * 4 + 2] = header[i] >> 8;
+        (*dtb)[i * 4 + 3] = header[i];
+    }
+    fdt_memcpy(*dtb + off_struct, b.buf, b.size);
+    fdt_memcpy(*dtb + off_strings, b.strings, b.strings_size);
+    *size = total;
+
+    free(b.buf);
+    return 0;
+}
+
+
+/**
+ * @brief format path of a child node of synthetic tree
+ * 
+ * @param buf: output buffer
+ * @param len: output buffer size
+ * @param top: index of top-level node
+ * @param child: index of child node
+ * @return none
+ */
+void bench_dt_path(char *buf, int len, uint32_t top, uint32_t child)
+{
+    snprintf(buf, len, "/node%"PRIu32"/child%"PRIu32, top, child);
+}
+
+
+/**
+ * @brief get monotonic time
+ * 
+ * @param none
+ * @return uint64_t: time in nanoseconds
+ */
+uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
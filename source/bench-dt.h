@@ -0,0 +1,94 @@
+/*
+ * File Name: bench-dt.h
+ *
+ * Copyright 2024-, lishanwen (1477153217@qq.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BENCH_DT_H__
+#define __BENCH_DT_H__
+
+#include "fdt-writer.h"
+
+
+/**
+ * @brief Synthetic device tree for benchmarks.
+ * @top: number of top-level nodes, named node0, node1, ...
+ * @children: number of children of each top-level node, named child0, child1, ...
+ * @props: number of integer properties of each child, named prop0, prop1, ...
+ * @flags: FDT_FLAG_* format flags of blob.
+ */
+typedef struct bench_dt {
+    uint32_t top;
+    uint32_t children;
+    uint32_t props;
+    uint8_t flags;
+
+}bench_dt_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Build synthetic blob.
+ * @param dt: shape of tree.
+ * @param writer: writer, it is initialized by this function.
+ * @param blob: blob data, it is owned by writer.
+ * @param size: blob size.
+ * @return 0 if success, or -1.
+ * @note every child also has "compatible" string and "reg" int property.
+ */
+int bench_dt_build(const bench_dt_t *dt, fdt_writer_t *writer, const void **blob, uint32_t *size);
+
+
+/**
+ * @brief Build a standard dtb (version 17) of the same shape, as dtc would emit it.
+ * @param dt: shape of tree, flags are not used.
+ * @param dtb: dtb data, free it with free().
+ * @param size: dtb size.
+ * @return 0 if success, or -1.
+ * @note top-level nodes are named bus@<addr> and children device@<addr>, every
+ *       child has a string list "compatible", "reg", "interrupts", "clocks" and "status".
+ */
+int bench_dtb_build(const bench_dt_t *dt, uint8_t **dtb, uint32_t *size);
+
+
+/**
+ * @brief Format path of a child node of synthetic tree.
+ * @param buf: output buffer.
+ * @param len: output buffer size.
+ * @param top: index of top-level node.
+ * @param child: index of child node.
+ * @return none
+ */
+void bench_dt_path(char *buf, int len, uint32_t top, uint32_t child);
+
+
+/**
+ * @brief Get monotonic time.
+ * @param none
+ * @return time in nanoseconds.
+ */
+uint64_t bench_now_ns(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif // !__BENCH_DT_H__
@@ -0,0 +1,258 @@
+#include "fdt.h"
+#include "bench-dt.h"
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+
+#define BENCH_PATHS                 4096
+#define BENCH_LOOKUPS               200000
+#define BENCH_LOAD_ROUNDS           5
+
+
+static char bench_paths[BENCH_PATHS][48];
+static pthread_barrier_t bench_barrier;
+
+
+typedef struct bench_worker {
+    pthread_t thread;
+    uint32_t seed;
+    uint64_t sum;
+    int errors;
+
+}bench_worker_t;
+
+
+static void* bench_lookup_worker(void *arg)
+{
+    bench_worker_t *worker = (bench_worker_t*)arg;
+    uint32_t seed = worker->seed;
+
+    pthread_barrier_wait(&bench_barrier);
+
+    for(int i = 0; i < BENCH_LOOKUPS; i++) {
+        size_t reg = 0;
+
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        fdt_node_t *node = fdt_find_node_by_path(bench_paths[seed % BENCH_PATHS]);
+        if(node == NULL || fdt_read_prop_int(node, "reg", &reg)) {
+            worker->errors ++;
+            continue;
+        }
+        worker->sum += reg;
+    }
+
+    pthread_barrier_wait(&bench_barrier);
+    return NULL;
+}
+
+
+static double bench_lookup(int threads)
+{
+    bench_worker_t workers[threads];
+    int errors = 0;
+
+    pthread_barrier_init(&bench_barrier, NULL, threads + 1);
+    for(int i = 0; i < threads; i++) {
+        workers[i].seed = 0x9e3779b9u * (i + 1);
+        workers[i].sum = 0;
+        workers[i].errors = 0;
+        pthread_create(&workers[i].thread, NULL, bench_lookup_worker, &workers[i]);
+    }
+
+    pthread_barrier_wait(&bench_barrier);
+    uint64_t begin = bench_now_ns();
+    pthread_barrier_wait(&bench_barrier);
+    uint64_t end = bench_now_ns();
+
+    for(int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        errors += workers[i].errors;
+    }
+    pthread_barrier_destroy(&bench_barrier);
+
+    if(errors) {
+        printf("[ERROR]%d lookups failed\n", errors);
+    }
+
+    return (double)threads * BENCH_LOOKUPS * 1e9 / (double)(end - begin);
+}
+
+
+static double bench_load_ms(const void *blob, uint32_t size, int threads)
+{
+    uint64_t best = UINT64_MAX;
+
+    for(int round = 0; round < BENCH_LOAD_ROUNDS; round++) {
+        uint64_t begin = bench_now_ns();
+        int ret = threads ? fdt_load_parallel(blob, size, threads) : fdt_load(blob, size);
+        uint64_t end = bench_now_ns();
+
+        if(ret) {
+            FDT_LOG_ERROR("fdt load failed\n");
+            return 0;
+        }
+        if(end - begin < best) {
+            best = end - begin;
+        }
+    }
+
+    return best / 1e6;
+}
+
+
+static void bench_parallel_load(int max_threads)
+{
+    // 1024 * 128 children with 8 properties each, about 1M properties
+    bench_dt_t dt = {.top = 1024, .children = 128, .props = 6, .flags = FDT_FLAG_NAME_HASH | FDT_FLAG_SUBTREE_SIZE};
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t size = 0;
+
+    if(bench_dt_build(&dt, &writer, &blob, &size)) {
+        FDT_LOG_ERROR("build blob failed\n");
+        return;
+    }
+
+    double serial = bench_load_ms(blob, size, 0);
+    printf("blob: %"PRIu32" bytes, %"PRIu32" properties, fdt_load %.2f ms\n",
+           size, dt.top * dt.children * (dt.props + 2), serial);
+
+    double base = 0;
+    for(int threads = 1; ; threads *= 2) {
+        if(threads > max_threads) {
+            threads = max_threads;
+        }
+
+        double ms = bench_load_ms(blob, size, threads);
+        if(threads == 1) {
+            base = ms;
+        }
+        printf("%3d threads: %8.2f ms, speedup %.2fx, %.2fx of fdt_load, %"PRIu64" bytes consumed\n",
+               threads, ms, base / ms, serial / ms, fdt_debug_get_consume_bytes());
+
+        if(threads == max_threads) {
+            break;
+        }
+    }
+
+    fdt_unload();
+    fdt_writer_release(&writer);
+}
+
+
+static void bench_async_load(void)
+{
+    bench_dt_t dt = {.top = 256, .children = 64, .props = 8, .flags = FDT_FLAG_NAME_HASH | FDT_FLAG_SUBTREE_SIZE};
+    uint64_t first = UINT64_MAX, last = UINT64_MAX, done = UINT64_MAX;
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t size = 0;
+    char path[48];
+
+    if(bench_dt_build(&dt, &writer, &blob, &size)) {
+        FDT_LOG_ERROR("build blob failed\n");
+        return;
+    }
+
+    double serial = bench_load_ms(blob, size, 0);
+    bench_dt_path(path, sizeof(path), dt.top - 1, dt.children - 1);
+
+    for(int round = 0; round < BENCH_LOAD_ROUNDS; round++) {
+        // a boot has no tree to free
+        fdt_unload();
+        uint64_t begin = bench_now_ns();
+        if(fdt_load_async(blob, size)) {
+            FDT_LOG_ERROR("fdt load failed\n");
+            break;
+        }
+
+        // early init needs one device of the first bus
+        fdt_node_t *node = fdt_wait_node("/node0/child0", 1000);
+        uint64_t ready = bench_now_ns();
+        fdt_node_t *tail = fdt_wait_node(path, 1000);
+        uint64_t tail_ready = bench_now_ns();
+        int ret = fdt_load_async_join();
+        uint64_t end = bench_now_ns();
+
+        if(node == NULL || tail == NULL || ret) {
+            FDT_LOG_ERROR("fdt wait node failed\n");
+            break;
+        }
+        first = ready - begin < first ? ready - begin : first;
+        last = tail_ready - begin < last ? tail_ready - begin : last;
+        done = end - begin < done ? end - begin : done;
+    }
+
+    printf("blob: %"PRIu32" bytes, %"PRIu32" nodes, fdt_load %.3f ms\n", size, 1 + dt.top * (dt.children + 1), serial);
+    printf("  fdt_load_async: /node0/child0 ready %.3f ms, %s ready %.3f ms, all done %.3f ms\n",
+           first / 1e6, path, last / 1e6, done / 1e6);
+
+    fdt_unload();
+    fdt_writer_release(&writer);
+}
+
+
+int main(int argc, char *argv[])
+{
+    bench_dt_t dt = {.top = 256, .children = 64, .props = 8};
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t size = 0;
+    int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(argc > 1) {
+        max_threads = atoi(argv[1]);
+    }
+    if(max_threads < 1) {
+        max_threads = 1;
+    }
+
+    if(bench_dt_build(&dt, &writer, &blob, &size)) {
+        FDT_LOG_ERROR("build blob failed\n");
+        return -1;
+    }
+
+    uint64_t begin = bench_now_ns();
+    if(fdt_load(blob, size)) {
+        FDT_LOG_ERROR("fdt load failed\n");
+        return -1;
+    }
+    uint64_t end = bench_now_ns();
+
+    printf("blob: %"PRIu32" bytes, %"PRIu32" nodes, load %.2f ms, %"PRIu64" bytes consumed\n",
+           size, dt.top * (dt.children + 1), (end - begin) / 1e6, fdt_debug_get_consume_bytes());
+
+    for(int i = 0; i < BENCH_PATHS; i++) {
+        uint32_t top = (uint32_t)((i * 2654435761u) % dt.top);
+        bench_dt_path(bench_paths[i], sizeof(bench_paths[i]), top, (i * 40503u) % dt.children);
+    }
+
+    printf("================== LOOKUP SCALING ================\n");
+    double base = 0;
+    for(int threads = 1; ; threads *= 2) {
+        if(threads > max_threads) {
+            threads = max_threads;
+        }
+
+        double rate = bench_lookup(threads);
+        if(threads == 1) {
+            base = rate;
+        }
+        printf("%3d threads: %12.0f lookups/s, speedup %.2fx\n", threads, rate, rate / base);
+
+        if(threads == max_threads) {
+            break;
+        }
+    }
+
+    fdt_unload();
+    fdt_writer_release(&writer);
+
+    printf("================== PARALLEL LOAD ================\n");
+    bench_parallel_load(max_threads);
+
+    printf("================== ASYNC LOAD ================\n");
+    bench_async_load();
+    return 0;
+}
@@ -0,0 +1,848 @@
+#include "fdt.h"
+#include "bench-dt.h"
+#include <stdio.h>
+
+
+#define BENCH_ROUNDS                20
+#define BENCH_TOUCH                 64
+
+
+typedef struct bench_load {
+    uint64_t load_ns;
+    uint64_t touch_ns;
+    uint64_t load_bytes;
+    uint64_t touch_bytes;
+
+}bench_load_t;
+
+
+static int bench_load(const void *blob, uint32_t size, const bench_dt_t *dt, uint32_t flags, bench_load_t *result)
+{
+    fdt_load_opts_t opts = {.flags = flags};
+    char path[48];
+
+    result->load_ns = UINT64_MAX;
+    result->touch_ns = UINT64_MAX;
+
+    for(int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t begin = bench_now_ns();
+        if(fdt_load_ex(blob, size, &opts)) {
+            return -1;
+        }
+        uint64_t loaded = bench_now_ns();
+        result->load_bytes = fdt_debug_get_consume_bytes();
+
+        // a boot touches a few devices
+        for(uint32_t i = 0; i < BENCH_TOUCH; i++) {
+            size_t reg = 0;
+
+            bench_dt_path(path, sizeof(path), (i * 2654435761u) % dt->top, (i * 40503u) % dt->children);
+            if(fdt_read_prop_int_by_path(path, "reg", &reg)) {
+                return -1;
+            }
+        }
+        uint64_t touched = bench_now_ns();
+        result->touch_bytes = fdt_debug_get_consume_bytes();
+
+        if(loaded - begin < result->load_ns) {
+            result->load_ns = loaded - begin;
+        }
+        if(touched - loaded < result->touch_ns) {
+            result->touch_ns = touched - loaded;
+        }
+    }
+
+    return 0;
+}
+
+
+static void bench_lazy(uint8_t format_flags)
+{
+    bench_dt_t dt = {.top = 256, .children = 64, .props = 8, .flags = format_flags};
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t size = 0;
+    bench_load_t eager, lazy;
+
+    if(bench_dt_build(&dt, &writer, &blob, &size)) {
+        FDT_LOG_ERROR("build blob failed\n");
+        return;
+    }
+
+    if(bench_load(blob, size, &dt, 0, &eager) || bench_load(blob, size, &dt, FDT_LOAD_LAZY, &lazy)) {
+        FDT_LOG_ERROR("load blob failed\n");
+        fdt_writer_release(&writer);
+        return;
+    }
+
+    printf("blob: %"PRIu32" bytes, flags 0x%x, %d lookups after load\n", size, format_flags, BENCH_TOUCH);
+    printf("  eager: load %8.3f ms, lookups %8.3f ms, %9"PRIu64" bytes\n",
+           eager.load_ns / 1e6, eager.touch_ns / 1e6, eager.touch_bytes);
+    printf("  lazy : load %8.3f ms, lookups %8.3f ms, %9"PRIu64" bytes at load, %9"PRIu64" bytes after lookups\n",
+           lazy.load_ns / 1e6, lazy.touch_ns / 1e6, lazy.load_bytes, lazy.touch_bytes);
+
+    fdt_unload();
+    fdt_writer_release(&writer);
+}
+
+
+static void* bench_malloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    return malloc(size);
+}
+
+
+static void bench_free(void *ctx, void *ptr)
+{
+    (void)ctx;
+    free(ptr);
+}
+
+
+static int bench_alloc_load(const void *blob, uint32_t size, uint64_t *load_ns, uint64_t *unload_ns)
+{
+    *load_ns = UINT64_MAX;
+    *unload_ns = UINT64_MAX;
+
+    for(int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t begin = bench_now_ns();
+        if(fdt_load(blob, size)) {
+            return -1;
+        }
+        uint64_t loaded = bench_now_ns();
+        fdt_unload();
+        uint64_t unloaded = bench_now_ns();
+
+        if(loaded - begin < *load_ns) {
+            *load_ns = loaded - begin;
+        }
+        if(unloaded - loaded < *unload_ns) {
+            *unload_ns = unloaded - loaded;
+        }
+    }
+
+    return 0;
+}
+
+
+static void bench_allocator(void)
+{
+    bench_dt_t dt = {.top = 256, .children = 64, .props = 8, .flags = FDT_FLAG_NAME_HASH};
+    uint32_t node_count = dt.top * (dt.children + 1);
+    uint32_t prop_count = dt.top * dt.children * (dt.props + 2);
+    fdt_allocator_t fallback = {bench_malloc, bench_free, NULL};
+    fdt_pool_allocator_t pool;
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t size = 0;
+    uint64_t malloc_load, malloc_unload, pool_load, pool_unload;
+
+    fdt_node_t *nodes = malloc(sizeof(fdt_node_t) * node_count);
+    fdt_prop_t *props = malloc(sizeof(fdt_prop_t) * prop_count);
+    if(nodes == NULL || props == NULL || bench_dt_build(&dt, &writer, &blob, &size)) {
+        FDT_LOG_ERROR("build blob failed\n");
+        free(nodes);
+        free(props);
+        return;
+    }
+
+    fdt_pool_allocator_init(&pool, nodes, node_count, props, prop_count, &fallback);
+    if(bench_alloc_load(blob, size, &malloc_load, &malloc_unload) ||
+       fdt_set_allocator(&pool.allocator) ||
+       bench_alloc_load(blob, size, &pool_load, &pool_unload)) {
+        FDT_LOG_ERROR("load blob failed\n");
+    }
+    else {
+        printf("blob: %"PRIu32" bytes, %"PRIu32" nodes, %"PRIu32" properties\n", size, node_count, prop_count);
+        printf("  malloc: load %8.3f ms, unload %8.3f ms\n", malloc_load / 1e6, malloc_unload / 1e6);
+        printf("  pool  : load %8.3f ms, unload %8.3f ms, peak %"PRIu32" nodes %"PRIu32" properties\n",
+               pool_load / 1e6, pool_unload / 1e6, pool.node.peak, pool.prop.peak);
+    }
+
+    fdt_set_allocator(NULL);
+    fdt_writer_release(&writer);
+    free(nodes);
+    free(props);
+}
+
+
+#define BENCH_READS                 1000000
+
+
+// fdt_read_prop_int() before width specific loads, it shifts in one byte at a time
+static __attribute__((noinline)) int bench_read_loop(fdt_node_t *node, const char *name, size_t *value)
+{
+    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
+    if(prop == NULL) {
+        return -1;
+    }
+
+    const uint8_t *len = prop->offset;
+    size_t ret = 0;
+
+    if(*len > FDT_PROP_STRING && *len < FDT_PROP_ARRAY) {
+        for(int i = *len; i > 0; i--) {
+            ret = (ret << 8 | (*(len + i)));
+        }
+        *value = ret;
+        return 0;
+    }
+
+    return -1;
+}
+
+
+static uint64_t bench_int_reads(fdt_node_t *node, const char *name, int kind)
+{
+    uint64_t sum = 0;
+    size_t int_val = 0;
+    uint64_t u64_val = 0;
+    uint32_t u32_val = 0;
+
+    for(int n = 0; n < BENCH_READS; n++) {
+        if(kind == 0 && bench_read_loop(node, name, &int_val) == 0) {
+            sum += int_val;
+        }
+        else if(kind == 1 && fdt_read_prop_int(node, name, &int_val) == 0) {
+            sum += int_val;
+        }
+        else if(kind == 2 && fdt_read_prop_u64(node, name, &u64_val) == 0) {
+            sum += u64_val;
+        }
+        else if(kind == 3 && fdt_read_prop_u32(node, name, &u32_val) == 0) {
+            sum += u32_val;
+        }
+    }
+
+    return sum;
+}
+
+
+static void bench_int_read(void)
+{
+    static const char *names[] = {"w1", "w2", "w4", "w8"};
+    static const uint64_t values[] = {0x5a, 0x5a5a, 0x5a5a5a5a, 0x5a5a5a5a5a5a5a5aull};
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t size = 0;
+    volatile uint64_t sink = 0;
+
+    fdt_writer_init(&writer, NULL, 0, 0x260101, FDT_FLAG_NAME_HASH);
+    fdt_writer_begin_node(&writer, "dev");
+    for(int i = 0; i < 4; i++) {
+        fdt_writer_prop_int(&writer, names[i], values[i]);
+    }
+    if(fdt_writer_finish(&writer, &blob, &size) || fdt_load(blob, size)) {
+        FDT_LOG_ERROR("load blob failed\n");
+        fdt_writer_release(&writer);
+        return;
+    }
+
+    fdt_node_t *dev = fdt_find_node_by_path("/dev");
+    for(int i = 0; i < 4; i++) {
+        double ns[4];
+
+        for(int kind = 0; kind < 4; kind++) {
+            uint64_t best = UINT64_MAX;
+
+            for(int round = 0; round < BENCH_ROUNDS; round++) {
+                uint64_t begin = bench_now_ns();
+                sink += bench_int_reads(dev, names[i], kind);
+                uint64_t end = bench_now_ns();
+                if(end - begin < best) {
+                    best = end - begin;
+                }
+            }
+            ns[kind] = (double)best / BENCH_READS;
+        }
+
+        printf("  %d byte: byte loop %6.2f ns, read_int %6.2f ns, read_u64 %6.2f ns, read_u32 %6.2f ns\n",
+               1 << i, ns[0], ns[1], ns[2], ns[3]);
+    }
+
+    (void)sink;
+    fdt_unload();
+    fdt_writer_release(&writer);
+}
+
+
+#define BENCH_QUERY_MAX             (256 * 64)
+
+
+// what callers do without fdt_query(): walk the top level and look up each path
+static uint32_t bench_query_manual(const bench_dt_t *dt, const char *prefix, int child, fdt_node_t **out)
+{
+    fdt_node_t *top = NULL;
+    uint32_t found = 0;
+    char path[48];
+
+    fdt_for_each_node_child(fdt_get_root_node(), top) {
+        uint32_t i = 0;
+
+        if(strncmp(top->name, prefix, strlen(prefix)) || sscanf(top->name, "node%"SCNu32, &i) != 1) {
+            continue;
+        }
+
+        for(uint32_t j = 0; j < dt->children; j++) {
+            if(child >= 0 && j != (uint32_t)child) {
+                continue;
+            }
+            bench_dt_path(path, sizeof(path), i, j);
+            fdt_node_t *node = fdt_find_node_by_path(path);
+            if(node) {
+                out[found ++] = node;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+static void bench_query(void)
+{
+    bench_dt_t dt = {.top = 256, .children = 64, .props = 8, .flags = FDT_FLAG_NAME_HASH};
+    static const struct {
+        const char *pattern;
+        const char *prefix;
+        int child;
+    } cases[] = {
+        {"/node1*/child*", "node1", -1},
+        {"/**/child7", "node", 7},
+        {"/node4?/child1?", NULL, 0},
+    };
+    static fdt_node_t *out[BENCH_QUERY_MAX];
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t size = 0;
+
+    if(bench_dt_build(&dt, &writer, &blob, &size) || fdt_load(blob, size)) {
+        FDT_LOG_ERROR("load blob failed\n");
+        fdt_writer_release(&writer);
+        return;
+    }
+
+    printf("tree: %"PRIu32" nodes\n", 1 + dt.top * (dt.children + 1));
+    for(uint32_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        uint64_t query_ns = UINT64_MAX, manual_ns = UINT64_MAX;
+        int found = 0;
+        uint32_t manual = 0;
+
+        for(int round = 0; round < BENCH_ROUNDS; round++) {
+            uint64_t begin = bench_now_ns();
+            found = fdt_query(cases[c].pattern, out, BENCH_QUERY_MAX);
+            uint64_t end = bench_now_ns();
+            query_ns = end - begin < query_ns ? end - begin : query_ns;
+
+            if(cases[c].prefix) {
+                begin = bench_now_ns();
+                manual = bench_query_manual(&dt, cases[c].prefix, cases[c].child, out);
+                end = bench_now_ns();
+                manual_ns = end - begin < manual_ns ? end - begin : manual_ns;
+            }
+        }
+
+        printf("  %-18s %6d matches: query %8.3f ms", cases[c].pattern, found, query_ns / 1e6);
+        if(cases[c].prefix) {
+            printf(", manual %8.3f ms (%"PRIu32" matches)", manual_ns / 1e6, manual);
+        }
+        printf("\n");
+    }
+
+    fdt_unload();
+    fdt_writer_release(&writer);
+}
+
+
+static inline uint32_t bench_be32(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+
+// what a standard dtb reader does per lookup: scan the structure block from the start
+static const uint8_t* bench_dtb_find_prop(const uint8_t *dtb, const char *path, const char *name, uint32_t *len)
+{
+    const uint8_t *pos = dtb + bench_be32(dtb + 8);
+    const char *strings = (const char*)dtb + bench_be32(dtb + 12);
+    const char *want = path + 1;
+    int depth = 0, matched = 0;
+
+    for(;;) {
+        uint32_t token = bench_be32(pos);
+        pos += 4;
+
+        if(token == 0x1) {
+            const char *node = (const char*)pos;
+            size_t node_len = strlen(node);
+            pos += (node_len + 4) & ~3u;
+
+            if(++ depth == 1) {
+                matched = 1;
+            }
+            else if(depth == matched + 1 && *want) {
+                size_t want_len = strcspn(want, "/");
+                if(want_len == node_len && strncmp(want, node, node_len) == 0) {
+                    matched = depth;
+                    want += want_len + (want[want_len] == '/');
+                }
+            }
+        }
+        else if(token == 0x2) {
+            if(depth -- == matched) {
+                return NULL;
+            }
+        }
+        else if(token == 0x3) {
+            uint32_t size = bench_be32(pos);
+            const char *prop = strings + bench_be32(pos + 4);
+            pos += 8;
+            if(depth == matched && *want == '\0' && strcmp(prop, name) == 0) {
+                *len = size;
+                return pos;
+            }
+            pos += (size + 3) & ~3u;
+        }
+        else if(token != 0x4) {
+            return NULL;
+        }
+    }
+}
+
+
+static void bench_dtb_import(void)
+{
+    static const uint8_t formats[] = {0, FDT_FLAG_NAME_HASH | FDT_FLAG_SUBTREE_SIZE};
+    bench_dt_t dt = {.top = 16, .children = 24, .props = 4};
+    char paths[BENCH_TOUCH][48];
+    uint8_t *dtb = NULL;
+    uint32_t dtb_size = 0;
+    uint64_t sink = 0;
+
+    if(bench_dtb_build(&dt, &dtb, &dtb_size)) {
+        FDT_LOG_ERROR("build dtb failed\n");
+        return;
+    }
+
+    for(uint32_t i = 0; i < BENCH_TOUCH; i++) {
+        uint32_t top = (i * 2654435761u) % dt.top, child = (i * 40503u) % dt.children;
+        snprintf(paths[i], sizeof(paths[i]), "/bus@%"PRIx32"/device@%"PRIx32,
+                 0x10000000u + top * 0x10000u, 0x10000000u + top * 0x10000u + child * 0x100u);
+    }
+
+    uint64_t scan_ns = UINT64_MAX;
+    for(int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t begin = bench_now_ns();
+        for(uint32_t i = 0; i < BENCH_TOUCH; i++) {
+            uint32_t len = 0;
+            const uint8_t *reg = bench_dtb_find_prop(dtb, paths[i], "reg", &len);
+            sink += reg ? bench_be32(reg) : 0;
+        }
+        uint64_t end = bench_now_ns();
+        if(end - begin < scan_ns) {
+            scan_ns = end - begin;
+        }
+    }
+
+    printf("dtb: %"PRIu32" bytes, %"PRIu32" nodes, %d lookups by scan %8.3f ms\n",
+           dtb_size, 1 + dt.top * (dt.children + 1), BENCH_TOUCH, scan_ns / 1e6);
+
+    for(uint32_t f = 0; f < sizeof(formats); f++) {
+        uint64_t import_ns = UINT64_MAX, load_ns = UINT64_MAX, touch_ns = UINT64_MAX, blob_ns = UINT64_MAX;
+        fdt_writer_t writer;
+        const void *blob = NULL;
+        uint32_t size = 0;
+
+        for(int round = 0; round < BENCH_ROUNDS; round++) {
+            uint64_t begin = bench_now_ns();
+            fdt_writer_init(&writer, NULL, 0, 0x260101, formats[f]);
+            if(fdt_writer_import_dtb(&writer, dtb, dtb_size) || fdt_writer_finish(&writer, &blob, &size)) {
+                FDT_LOG_ERROR("import dtb failed\n");
+                fdt_writer_release(&writer);
+                free(dtb);
+                return;
+            }
+            uint64_t imported = bench_now_ns();
+            if(fdt_load(blob, size)) {
+                FDT_LOG_ERROR("load blob failed\n");
+                fdt_writer_release(&writer);
+                free(dtb);
+                return;
+            }
+            uint64_t loaded = bench_now_ns();
+            for(uint32_t i = 0; i < BENCH_TOUCH; i++) {
+                size_t reg = 0;
+                fdt_read_prop_int_index_by_path(paths[i], "reg", 0, &reg);
+                sink += reg;
+            }
+            uint64_t touched = bench_now_ns();
+            for(uint32_t i = 0; i < BENCH_TOUCH; i++) {
+                fdt_walk_prop_t prop;
+                if(fdt_blob_find_prop(blob, size, paths[i], "reg", &prop) == 0) {
+                    sink += prop.count;
+                }
+            }
+            uint64_t found = bench_now_ns();
+
+            import_ns = imported - begin < import_ns ? imported - begin : import_ns;
+            load_ns = loaded - imported < load_ns ? loaded - imported : load_ns;
+            touch_ns = touched - loaded < touch_ns ? touched - loaded : touch_ns;
+            blob_ns = found - touched < blob_ns ? found - touched : blob_ns;
+
+            fdt_unload();
+            if(round + 1 < BENCH_ROUNDS) {
+                fdt_writer_release(&writer);
+            }
+        }
+
+        uint32_t compact = 0;
+        if(size <= UINT16_MAX) {
+            fdt_compact_build(blob, size, NULL, 0, &compact);
+        }
+        printf("  blob flags 0x%x: %7"PRIu32" bytes (%3.0f%%), import %7.3f ms, load %7.3f ms, "
+               "lookups %7.3f ms loaded, %7.3f ms in blob\n",
+               formats[f], size, 100.0 * size / dtb_size, import_ns / 1e6, load_ns / 1e6,
+               touch_ns / 1e6, blob_ns / 1e6);
+        if(compact) {
+            printf("  compact tree of it: %"PRIu32" bytes\n", compact);
+        }
+        fdt_writer_release(&writer);
+    }
+
+    (void)sink;
+    free(dtb);
+}
+
+
+typedef struct bench_edit {
+    const char *name;
+    const char *changed_path;
+    const char *added_path;
+    const char *removed_path;
+    fdt_node_t *changed;
+    fdt_node_t *added;
+    fdt_node_t *removed;
+    uint32_t every;
+    uint32_t seq;
+
+}bench_edit_t;
+
+
+static void bench_patch_emit(fdt_writer_t *writer, fdt_node_t *node, bench_edit_t *edit)
+{
+    fdt_prop_t *prop = NULL;
+    fdt_node_t *child = NULL;
+    size_t value = 0;
+
+    fdt_for_each_node_prop(node, prop) {
+        bool change = (node == edit->changed && strcmp(prop->name, "prop2") == 0) ||
+                      (edit->every && fdt_get_prop_type(node, prop->name) == FDT_PROP_INT && edit->seq++ % edit->every == 0);
+        if(change && fdt_read_prop_int(node, prop->name, &value) == 0) {
+            fdt_writer_prop_int(writer, prop->name, value + 1);
+        }
+        else {
+            fdt_writer_prop_copy(writer, prop);
+        }
+    }
+
+    fdt_for_each_node_child(node, child) {
+        if(child == edit->removed) {
+            continue;
+        }
+        fdt_writer_begin_node(writer, child->name);
+        bench_patch_emit(writer, child, edit);
+        fdt_writer_end_node(writer);
+    }
+
+    if(node == edit->added) {
+        fdt_writer_begin_node(writer, "child-new");
+        fdt_writer_prop_string(writer, "compatible", "vendor,new-device");
+        fdt_writer_prop_int(writer, "reg", 0x12345678);
+        fdt_writer_prop_int(writer, "prop0", 1);
+        fdt_writer_end_node(writer);
+    }
+}
+
+
+static void bench_patch(void)
+{
+    bench_dt_t dt = {.top = 32, .children = 32, .props = 8, .flags = FDT_FLAG_NAME_HASH | FDT_FLAG_SUBTREE_SIZE};
+    fdt_writer_t base_writer;
+    const void *base = NULL;
+    uint32_t base_size = 0;
+
+    if(bench_dt_build(&dt, &base_writer, &base, &base_size) || fdt_load(base, base_size)) {
+        FDT_LOG_ERROR("load blob failed\n");
+        fdt_writer_release(&base_writer);
+        return;
+    }
+
+    bench_edit_t edits[] = {
+        {.name = "one property", .changed_path = "/node3/child5"},
+        {.name = "node added", .added_path = "/node7"},
+        {.name = "subtree removed", .removed_path = "/node20"},
+        {.name = "1% properties", .every = 100},
+    };
+
+    printf("blob: %"PRIu32" bytes, %"PRIu32" nodes\n", base_size, 1 + dt.top * (dt.children + 1));
+    for(uint32_t e = 0; e < sizeof(edits) / sizeof(edits[0]); e++) {
+        uint64_t diff_ns = UINT64_MAX, apply_ns = UINT64_MAX, load_ns = UINT64_MAX;
+        fdt_writer_t writer;
+        const void *target = NULL;
+        uint32_t target_size = 0, patch_size = 0, new_size = 0;
+        void *patch = NULL;
+
+        fdt_load(base, base_size);
+        edits[e].changed = edits[e].changed_path ? fdt_find_node_by_path(edits[e].changed_path) : NULL;
+        edits[e].added = edits[e].added_path ? fdt_find_node_by_path(edits[e].added_path) : NULL;
+        edits[e].removed = edits[e].removed_path ? fdt_find_node_by_path(edits[e].removed_path) : NULL;
+        fdt_writer_init(&writer, NULL, 0, (uint32_t)fdt_get_version(), dt.flags);
+        bench_patch_emit(&writer, fdt_get_root_node(), &edits[e]);
+        uint8_t *buf = NULL;
+        if(fdt_writer_finish(&writer, &target, &target_size) || (buf = malloc(target_size)) == NULL) {
+            FDT_LOG_ERROR("build target failed\n");
+            fdt_writer_release(&writer);
+            break;
+        }
+
+        for(int round = 0; round < BENCH_ROUNDS; round++) {
+            if(patch) {
+                fdt_free(patch);
+            }
+            uint64_t begin = bench_now_ns();
+            int ret = fdt_writer_build_patch(base, base_size, target, target_size, &patch, &patch_size);
+            uint64_t diffed = bench_now_ns();
+            ret |= fdt_load(base, base_size);
+            uint64_t applying = bench_now_ns();
+            ret |= fdt_apply_patch(base, base_size, patch, patch_size, buf, target_size, &new_size);
+            uint64_t applied = bench_now_ns();
+            ret |= fdt_load(target, target_size);
+            uint64_t loaded = bench_now_ns();
+            if(ret) {
+                FDT_LOG_ERROR("patch failed\n");
+                break;
+            }
+
+            diff_ns = diffed - begin < diff_ns ? diffed - begin : diff_ns;
+            apply_ns = applied - applying < apply_ns ? applied - applying : apply_ns;
+            load_ns = loaded - applied < load_ns ? loaded - applied : load_ns;
+        }
+
+        printf("  %-16s blob %7"PRIu32" bytes, patch %6"PRIu32" bytes (%5.2f%%), "
+               "diff %7.3f ms, apply %7.3f ms, load %7.3f ms\n",
+               edits[e].name, target_size, patch_size, 100.0 * patch_size / target_size,
+               diff_ns / 1e6, apply_ns / 1e6, load_ns / 1e6);
+
+        if(patch) {
+            fdt_free(patch);
+        }
+        free(buf);
+        fdt_writer_release(&writer);
+    }
+
+    fdt_unload();
+    fdt_writer_release(&base_writer);
+}
+
+
+static uint64_t bench_layers_load(const fdt_layer_t *layers, uint32_t count)
+{
+    uint64_t best = UINT64_MAX;
+
+    for(int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t begin = bench_now_ns();
+        if(fdt_load_layers(layers, count, NULL)) {
+            return 0;
+        }
+        uint64_t end = bench_now_ns();
+        best = end - begin < best ? end - begin : best;
+    }
+
+    return best;
+}
+
+
+static void bench_layers(void)
+{
+    bench_dt_t dt = {.top = 256, .children = 64, .props = 8, .flags = FDT_FLAG_NAME_HASH | FDT_FLAG_SUBTREE_SIZE};
+    fdt_writer_t soc, board, product, merged;
+    fdt_layer_t layers[3];
+    uint32_t size = 0;
+    char name[16];
+
+    if(bench_dt_build(&dt, &soc, &layers[0].dtb, &size)) {
+        FDT_LOG_ERROR("build blob failed\n");
+        return;
+    }
+    layers[0].dtb_size = size;
+
+    // board overrides reg of every 10th device, product adds a device to every 16th node
+    fdt_writer_init(&board, NULL, 0, 0x260102, dt.flags);
+    fdt_writer_init(&product, NULL, 0, 0x260103, dt.flags);
+    for(uint32_t top = 0; top < dt.top; top++) {
+        snprintf(name, sizeof(name), "node%"PRIu32, top);
+        fdt_writer_begin_node(&board, name);
+        for(uint32_t child = top % 10; child < dt.children; child += 10) {
+            snprintf(name, sizeof(name), "child%"PRIu32, child);
+            fdt_writer_begin_node(&board, name);
+            fdt_writer_prop_int(&board, "reg", 0x80000000u + child);
+            fdt_writer_end_node(&board);
+        }
+        fdt_writer_end_node(&board);
+
+        if(top % 16 == 0) {
+            snprintf(name, sizeof(name), "node%"PRIu32, top);
+            fdt_writer_begin_node(&product, name);
+            fdt_writer_begin_node(&product, "child-new");
+            fdt_writer_prop_string(&product, "compatible", "vendor,new-device");
+            fdt_writer_prop_int(&product, "reg", 0x12345678);
+            fdt_writer_end_node(&product);
+            fdt_writer_end_node(&product);
+        }
+    }
+    fdt_writer_finish(&board, &layers[1].dtb, &size);
+    layers[1].dtb_size = size;
+    fdt_writer_finish(&product, &layers[2].dtb, &size);
+    layers[2].dtb_size = size;
+
+    // the same tree merged at build time
+    bench_edit_t edit = {0};
+    const void *blob = NULL;
+    uint32_t merged_size = 0;
+    fdt_writer_init(&merged, NULL, 0, 0x260103, dt.flags);
+    if(fdt_load_layers(layers, 3, NULL) == 0) {
+        bench_patch_emit(&merged, fdt_get_root_node(), &edit);
+    }
+    fdt_layer_t single = {NULL, 0};
+    if(fdt_writer_finish(&merged, &blob, &merged_size) == 0) {
+        single.dtb = blob;
+        single.dtb_size = merged_size;
+    }
+
+    uint64_t base_ns = bench_layers_load(layers, 1);
+    uint64_t base_bytes = fdt_debug_get_consume_bytes();
+    uint64_t layers_ns = bench_layers_load(layers, 3);
+    uint64_t layers_bytes = fdt_debug_get_consume_bytes();
+    uint64_t merged_ns = bench_layers_load(&single, 1);
+    uint64_t merged_bytes = fdt_debug_get_consume_bytes();
+
+    if(base_ns == 0 || layers_ns == 0 || merged_ns == 0) {
+        FDT_LOG_ERROR("load blob failed\n");
+    }
+    else {
+        printf("layers: soc %"PRIu64" bytes, board %"PRIu64" bytes, product %"PRIu64" bytes\n",
+               layers[0].dtb_size, layers[1].dtb_size, layers[2].dtb_size);
+        printf("  soc only         : load %8.3f ms, %9"PRIu64" bytes\n", base_ns / 1e6, base_bytes);
+        printf("  3 layers         : load %8.3f ms, %9"PRIu64" bytes\n", layers_ns / 1e6, layers_bytes);
+        printf("  merged blob      : load %8.3f ms, %9"PRIu64" bytes, blob %"PRIu32" bytes\n",
+               merged_ns / 1e6, merged_bytes, merged_size);
+    }
+
+    fdt_unload();
+    fdt_writer_release(&merged);
+    fdt_writer_release(&product);
+    fdt_writer_release(&board);
+    fdt_writer_release(&soc);
+}
+
+
+static uint32_t bench_crc32_bitwise(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for(int k = 0; k < 8; k++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+
+static void bench_crc(void)
+{
+    bench_dt_t dt = {.top = 256, .children = 64, .props = 8, .flags = FDT_FLAG_NAME_HASH | FDT_FLAG_CRC32};
+    size_t len = 1 << 20;
+    uint8_t *data = malloc(len);
+    uint64_t bitwise_ns = UINT64_MAX, slice_ns = UINT64_MAX;
+    uint32_t bitwise = 0, slice = 0;
+
+    if(data == NULL) {
+        return;
+    }
+    for(size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)(i * 2654435761u >> 13);
+    }
+
+    for(int round = 0; round < 5; round++) {
+        uint64_t begin = bench_now_ns();
+        bitwise = bench_crc32_bitwise(0, data, len);
+        uint64_t middle = bench_now_ns();
+        slice = fdt_crc32(0, data, len);
+        uint64_t end = bench_now_ns();
+
+        bitwise_ns = middle - begin < bitwise_ns ? middle - begin : bitwise_ns;
+        slice_ns = end - middle < slice_ns ? end - middle : slice_ns;
+    }
+    free(data);
+
+    printf("crc32 of %zu bytes%s\n", len, bitwise == slice ? "" : ", MISMATCH");
+    printf("  bitwise    : %8.3f ms, %8.1f MB/s\n", bitwise_ns / 1e6, len / (bitwise_ns / 1e3));
+    printf("  slice-by-8 : %8.3f ms, %8.1f MB/s\n", slice_ns / 1e6, len / (slice_ns / 1e3));
+
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t size = 0;
+    bench_load_t verify, skip, lazy_verify, lazy_skip;
+
+    if(bench_dt_build(&dt, &writer, &blob, &size)) {
+        FDT_LOG_ERROR("build blob failed\n");
+        return;
+    }
+
+    if(bench_load(blob, size, &dt, 0, &verify) || bench_load(blob, size, &dt, FDT_LOAD_SKIP_CRC, &skip) ||
+       bench_load(blob, size, &dt, FDT_LOAD_LAZY, &lazy_verify) ||
+       bench_load(blob, size, &dt, FDT_LOAD_LAZY | FDT_LOAD_SKIP_CRC, &lazy_skip)) {
+        FDT_LOG_ERROR("load blob failed\n");
+        fdt_writer_release(&writer);
+        return;
+    }
+
+    printf("blob: %"PRIu32" bytes, flags 0x%x\n", size, dt.flags);
+    printf("  eager: load %8.3f ms checked, %8.3f ms with FDT_LOAD_SKIP_CRC\n", verify.load_ns / 1e6, skip.load_ns / 1e6);
+    printf("  lazy : load %8.3f ms checked, %8.3f ms with FDT_LOAD_SKIP_CRC\n", lazy_verify.load_ns / 1e6, lazy_skip.load_ns / 1e6);
+
+    fdt_unload();
+    fdt_writer_release(&writer);
+}
+
+
+int main(void)
+{
+    printf("================== LAZY LOAD ================\n");
+    bench_lazy(FDT_FLAG_NAME_HASH);
+    bench_lazy(FDT_FLAG_NAME_HASH | FDT_FLAG_SUBTREE_SIZE);
+
+    printf("================== ALLOCATOR ================\n");
+    bench_allocator();
+
+    printf("================== INT READ ================\n");
+    bench_int_read();
+
+    printf("================== QUERY ================\n");
+    bench_query();
+
+    printf("================== DTB IMPORT ================\n");
+    bench_dtb_import();
+
+    printf("================== PATCH ================\n");
+    bench_patch();
+
+    printf("================== LAYERS ================\n");
+    bench_layers();
+
+    printf("================== CRC ================\n");
+    bench_crc();
+    return 0;
+}
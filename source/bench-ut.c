@@ -0,0 +1,620 @@
+#include "fdt.h"
+#include "bench-dt.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define BENCH_ROUNDS                5
+#define BENCH_ITERS                 100000
+#define BENCH_LOAD_ITERS            50
+#define BENCH_COLD_SAMPLES          63
+#define BENCH_FLUSH_SIZE            (16u << 20)
+#define BENCH_PATHS                 256
+#define BENCH_MAX_CASES             64
+
+
+typedef void (*bench_fn_t)(uint32_t i);
+
+
+/**
+ * @brief Result of one benchmark case.
+ * @name: case name, it is the key of baseline file.
+ * @warm: ns per call, best of rounds, caches are hot.
+ * @cold: ns per call, median of single calls after caches are flushed.
+ */
+typedef struct bench_result {
+    char name[48];
+    double warm;
+    double cold;
+
+}bench_result_t;
+
+
+static bench_result_t bench_results[BENCH_MAX_CASES];
+static int bench_result_count;
+static bench_result_t bench_baseline[BENCH_MAX_CASES];
+static int bench_baseline_count;
+static double bench_tolerance = 20.0;
+static int bench_regressions;
+static double bench_timer_ns;
+
+static uint8_t *bench_flush_buf;
+static volatile uintptr_t bench_sink;
+
+static const void *bench_blob;
+static uint32_t bench_blob_size;
+static uint8_t *bench_compact;
+static uint32_t bench_compact_size;
+static fdt_writer_t bench_writer;
+static int bench_compact_node;
+static char bench_paths[BENCH_PATHS][48];
+static char bench_prop_paths[BENCH_PATHS][56];
+static fdt_node_t *bench_nodes[BENCH_PATHS];
+
+
+static void bench_flush(void)
+{
+    uintptr_t sum = 0;
+
+    for(uint32_t i = 0; i < BENCH_FLUSH_SIZE; i += 64) {
+        bench_flush_buf[i] ++;
+        sum += bench_flush_buf[i];
+    }
+    bench_sink += sum;
+}
+
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+
+static const bench_result_t* bench_find_baseline(const char *name)
+{
+    for(int i = 0; i < bench_baseline_count; i++) {
+        if(strcmp(bench_baseline[i].name, name) == 0) {
+            return &bench_baseline[i];
+        }
+    }
+    return NULL;
+}
+
+
+static int bench_regressed(double now, double base)
+{
+    return base > 0 && now > base * (1.0 + bench_tolerance / 100.0);
+}
+
+
+void bench_case(const char *name, uint32_t iters, bench_fn_t fn)
+{
+    bench_result_t *result = &bench_results[bench_result_count];
+    double cold[BENCH_COLD_SAMPLES];
+
+    if(bench_result_count >= BENCH_MAX_CASES) {
+        FDT_LOG_ERROR("too many cases\n");
+        return;
+    }
+
+    result->warm = 1e18;
+    for(int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t begin = bench_now_ns();
+        for(uint32_t i = 0; i < iters; i++) {
+            fn(i);
+        }
+        double ns = (double)(bench_now_ns() - begin) / iters;
+        if(ns < result->warm) {
+            result->warm = ns;
+        }
+    }
+
+    for(int i = 0; i < BENCH_COLD_SAMPLES; i++) {
+        bench_flush();
+        uint64_t begin = bench_now_ns();
+        fn(i * 7919u);
+        double ns = (double)(bench_now_ns() - begin) - bench_timer_ns;
+        cold[i] = ns > 0 ? ns : 0;
+    }
+    qsort(cold, BENCH_COLD_SAMPLES, sizeof(cold[0]), bench_cmp_double);
+    result->cold = cold[BENCH_COLD_SAMPLES / 2];
+
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    bench_result_count ++;
+
+    printf("%2d. %-35s: warm %10.1f ns, cold %10.1f ns", bench_result_count, name, result->warm, result->cold);
+
+    const bench_result_t *base = bench_find_baseline(name);
+    if(base) {
+        int fail = bench_regressed(result->warm, base->warm) || bench_regressed(result->cold, base->cold);
+
+        printf(", %+6.1f%% %+6.1f%%: %s", (result->warm / base->warm - 1.0) * 100.0,
+               (result->cold / base->cold - 1.0) * 100.0,
+               fail ? "\033[1;31mFAIL\033[0m" : "\033[1;32mOK\033[0m");
+        bench_regressions += fail;
+    }
+    printf("\n");
+}
+
+
+static int bench_write_csv(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if(file == NULL) {
+        FDT_LOG_ERROR("open %s failed\n", path);
+        return -1;
+    }
+
+    fprintf(file, "name,warm_ns,cold_ns\n");
+    for(int i = 0; i < bench_result_count; i++) {
+        fprintf(file, "%s,%.2f,%.2f\n", bench_results[i].name, bench_results[i].warm, bench_results[i].cold);
+    }
+
+    int ret = ferror(file) ? -1 : 0;
+    fclose(file);
+    return ret;
+}
+
+
+static int bench_write_json(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if(file == NULL) {
+        FDT_LOG_ERROR("open %s failed\n", path);
+        return -1;
+    }
+
+    fprintf(file, "{\n  \"unit\": \"ns\",\n  \"cases\": [\n");
+    for(int i = 0; i < bench_result_count; i++) {
+        fprintf(file, "    {\"name\": \"%s\", \"warm\": %.2f, \"cold\": %.2f}%s\n", bench_results[i].name,
+                bench_results[i].warm, bench_results[i].cold, i + 1 < bench_result_count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    int ret = ferror(file) ? -1 : 0;
+    fclose(file);
+    return ret;
+}
+
+
+static int bench_read_baseline(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    char line[128];
+
+    if(file == NULL) {
+        FDT_LOG_ERROR("open %s failed\n", path);
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), file) && bench_baseline_count < BENCH_MAX_CASES) {
+        bench_result_t *base = &bench_baseline[bench_baseline_count];
+
+        // the header line does not parse
+        if(sscanf(line, "%47[^,],%lf,%lf", base->name, &base->warm, &base->cold) == 3) {
+            bench_baseline_count ++;
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+
+static int bench_setup(void)
+{
+    bench_dt_t dt = {.top = 16, .children = 16, .props = 8, .flags = FDT_FLAG_NAME_HASH | FDT_FLAG_SUBTREE_SIZE};
+
+    bench_flush_buf = fdt_malloc(BENCH_FLUSH_SIZE);
+    if(bench_flush_buf == NULL) {
+        return -1;
+    }
+    fdt_memset(bench_flush_buf, 0, BENCH_FLUSH_SIZE);
+
+    bench_timer_ns = 1e18;
+    for(int i = 0; i < 1000; i++) {
+        uint64_t begin = bench_now_ns();
+        double ns = (double)(bench_now_ns() - begin);
+        if(ns < bench_timer_ns) {
+            bench_timer_ns = ns;
+        }
+    }
+
+    if(bench_dt_build(&dt, &bench_writer, &bench_blob, &bench_blob_size) || fdt_load(bench_blob, bench_blob_size)) {
+        return -1;
+    }
+
+    if(fdt_compact_build(bench_blob, bench_blob_size, NULL, 0, &bench_compact_size) ||
+       (bench_compact = fdt_malloc(bench_compact_size)) == NULL ||
+       fdt_compact_build(bench_blob, bench_blob_size, bench_compact, bench_compact_size, &bench_compact_size)) {
+        return -1;
+    }
+
+    for(uint32_t i = 0; i < BENCH_PATHS; i++) {
+        bench_dt_path(bench_paths[i], sizeof(bench_paths[i]), (i * 2654435761u) % dt.top, (i * 40503u) % dt.children);
+        fdt_memcpy(bench_prop_paths[i], bench_paths[i], sizeof(bench_paths[i]));
+        strcat(bench_prop_paths[i], "/reg");
+        bench_nodes[i] = fdt_find_node_by_path(bench_paths[i]);
+        if(bench_nodes[i] == NULL) {
+            return -1;
+        }
+    }
+
+    bench_compact_node = fdt_compact_find_node((const fdt_compact_t*)bench_compact, bench_blob, bench_paths[0]);
+    printf("blob: %"PRIu32" bytes, %"PRIu32" nodes, compact %"PRIu32" bytes, timer %.1f ns, tolerance %.1f%%\n",
+           bench_blob_size, dt.top * (dt.children + 1), bench_compact_size, bench_timer_ns, bench_tolerance);
+    return bench_compact_node < 0 ? -1 : 0;
+}
+
+
+#define BENCH_NODE(i)               bench_nodes[(i) % BENCH_PATHS]
+#define BENCH_PATH(i)               bench_paths[(i) % BENCH_PATHS]
+
+
+static void bench_hash_name(uint32_t i)
+{
+    bench_sink += fdt_hash_name(BENCH_PATH(i) + 1, 6);
+}
+
+
+static void bench_hash_path(uint32_t i)
+{
+    bench_sink += fdt_hash_path(BENCH_PATH(i));
+}
+
+
+static void bench_hash_prop_path(uint32_t i)
+{
+    bench_sink += fdt_hash_prop_path(bench_prop_paths[i % BENCH_PATHS]);
+}
+
+
+static void bench_get_root_node(uint32_t i)
+{
+    bench_sink += (uintptr_t)fdt_get_root_node() + i;
+}
+
+
+static void bench_get_version(uint32_t i)
+{
+    bench_sink += fdt_get_version() + i;
+}
+
+
+static void bench_read_begin_end(uint32_t i)
+{
+    int epoch = fdt_read_begin();
+    bench_sink += i;
+    fdt_read_end(epoch);
+}
+
+
+static void bench_find_node_by_name(uint32_t i)
+{
+    bench_sink += (uintptr_t)fdt_find_node_by_name(fdt_get_root_node(), BENCH_NODE(i)->name);
+}
+
+
+static void bench_find_node_by_path(uint32_t i)
+{
+    bench_sink += (uintptr_t)fdt_find_node_by_path(BENCH_PATH(i));
+}
+
+
+static void bench_find_prop_by_name(uint32_t i)
+{
+    bench_sink += (uintptr_t)fdt_find_prop_by_name(BENCH_NODE(i), "prop7");
+}
+
+
+static void bench_find_prop_by_path(uint32_t i)
+{
+    bench_sink += (uintptr_t)fdt_find_prop_by_path(bench_prop_paths[i % BENCH_PATHS]);
+}
+
+
+static void bench_read_prop_string(uint32_t i)
+{
+    bench_sink += (uintptr_t)fdt_read_prop_string(BENCH_NODE(i), "compatible");
+}
+
+
+static void bench_read_prop_int(uint32_t i)
+{
+    size_t value = 0;
+    fdt_read_prop_int(BENCH_NODE(i), "reg", &value);
+    bench_sink += value;
+}
+
+
+static void bench_read_prop_int_index(uint32_t i)
+{
+    size_t value = 0;
+    fdt_read_prop_int_index(BENCH_NODE(i), "reg", 0, &value);
+    bench_sink += value;
+}
+
+
+static void bench_read_prop_u32(uint32_t i)
+{
+    uint32_t value = 0;
+    fdt_read_prop_u32(BENCH_NODE(i), "reg", &value);
+    bench_sink += value;
+}
+
+
+static void bench_read_prop_u64(uint32_t i)
+{
+    uint64_t value = 0;
+    fdt_read_prop_u64(BENCH_NODE(i), "reg", &value);
+    bench_sink += value;
+}
+
+
+static void bench_read_prop_s32(uint32_t i)
+{
+    int32_t value = 0;
+    fdt_read_prop_s32(BENCH_NODE(i), "prop3", &value);
+    bench_sink += value;
+}
+
+
+static void bench_read_prop_bytes(uint32_t i)
+{
+    const void *data = NULL;
+    uint32_t len = 0;
+
+    // a string reads as bytes
+    fdt_read_prop_bytes(BENCH_NODE(i), "compatible", &data, &len);
+    bench_sink += len;
+}
+
+
+static void bench_prop_stream(uint32_t i)
+{
+    fdt_prop_stream_t stream;
+    const void *chunk = NULL;
+
+    if(fdt_prop_stream_open(BENCH_NODE(i), "compatible", &stream) == 0) {
+        fdt_prop_stream_seek(&stream, 1);
+        bench_sink += fdt_prop_stream_next(&stream, 4, &chunk);
+    }
+}
+
+
+static void bench_read_prop_string_by_path(uint32_t i)
+{
+    bench_sink += (uintptr_t)fdt_read_prop_string_by_path(BENCH_PATH(i), "compatible");
+}
+
+
+static void bench_read_prop_int_by_path(uint32_t i)
+{
+    size_t value = 0;
+    fdt_read_prop_int_by_path(BENCH_PATH(i), "reg", &value);
+    bench_sink += value;
+}
+
+
+static void bench_read_prop_int_index_by_path(uint32_t i)
+{
+    size_t value = 0;
+    fdt_read_prop_int_index_by_path(BENCH_PATH(i), "reg", 0, &value);
+    bench_sink += value;
+}
+
+
+static void bench_read_prop_bytes_by_path(uint32_t i)
+{
+    const void *data = NULL;
+    uint32_t len = 0;
+
+    fdt_read_prop_bytes_by_path(BENCH_PATH(i), "compatible", &data, &len);
+    bench_sink += len;
+}
+
+
+static void bench_get_prop_value_size(uint32_t i)
+{
+    bench_sink += fdt_get_prop_value_size(fdt_find_prop_by_name(BENCH_NODE(i), "reg"));
+}
+
+
+static void bench_get_prop_int_size(uint32_t i)
+{
+    bench_sink += fdt_get_prop_int_size(BENCH_NODE(i), "reg");
+}
+
+
+static void bench_get_prop_int_size_by_path(uint32_t i)
+{
+    bench_sink += fdt_get_prop_int_size_by_path(BENCH_PATH(i), "reg");
+}
+
+
+static void bench_get_prop_type(uint32_t i)
+{
+    bench_sink += fdt_get_prop_type(BENCH_NODE(i), "reg");
+}
+
+
+static void bench_get_prop_type_by_path(uint32_t i)
+{
+    bench_sink += fdt_get_prop_type_by_path(BENCH_PATH(i), "reg");
+}
+
+
+static void bench_blob_find_prop(uint32_t i)
+{
+    fdt_walk_prop_t prop;
+
+    if(fdt_blob_find_prop(bench_blob, bench_blob_size, BENCH_PATH(i), "reg", &prop) == 0) {
+        bench_sink += prop.integer;
+    }
+}
+
+
+static void bench_compact_find_node(uint32_t i)
+{
+    bench_sink += fdt_compact_find_node((const fdt_compact_t*)bench_compact, bench_blob, BENCH_PATH(i));
+}
+
+
+static void bench_compact_find_prop(uint32_t i)
+{
+    fdt_walk_prop_t prop;
+
+    if(fdt_compact_find_prop((const fdt_compact_t*)bench_compact, bench_blob, bench_compact_node, "reg", &prop) == 0) {
+        bench_sink += prop.integer + i;
+    }
+}
+
+
+static int bench_walk_prop(void *ctx, const fdt_walk_prop_t *prop)
+{
+    (*(uint32_t*)ctx) += prop->size;
+    return FDT_WALK_CONTINUE;
+}
+
+
+static void bench_walk(uint32_t i)
+{
+    fdt_walk_ops_t ops = {.prop = bench_walk_prop};
+    uint32_t size = i;
+
+    fdt_walk(bench_blob, bench_blob_size, &ops, &size);
+    bench_sink += size;
+}
+
+
+static void bench_compact_build(uint32_t i)
+{
+    uint32_t size = 0;
+
+    fdt_compact_build(bench_blob, bench_blob_size, bench_compact, bench_compact_size, &size);
+    bench_sink += size + i;
+}
+
+
+static void bench_load(uint32_t i)
+{
+    bench_sink += fdt_load(bench_blob, bench_blob_size) + i;
+}
+
+
+static void bench_load_lazy(uint32_t i)
+{
+    fdt_load_opts_t opts = {.flags = FDT_LOAD_LAZY};
+    bench_sink += fdt_load_ex(bench_blob, bench_blob_size, &opts) + i;
+}
+
+
+static void bench_load_parallel(uint32_t i)
+{
+    bench_sink += fdt_load_parallel(bench_blob, bench_blob_size, 1) + i;
+}
+
+
+static void bench_usage(const char *prog)
+{
+    printf("usage: %s [-j out.json] [-c out.csv] [-b baseline.csv] [-t tolerance]\n", prog);
+    printf("  -j out.json     write results as json\n");
+    printf("  -c out.csv      write results as csv, it can be used as baseline\n");
+    printf("  -b baseline.csv compare with baseline, fail if any case is slower\n");
+    printf("  -t tolerance    allowed slowdown in percent, default 20\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *json_path = NULL;
+    const char *csv_path = NULL;
+    const char *base_path = NULL;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            csv_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            base_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            bench_tolerance = atof(argv[++i]);
+        }
+        else {
+            bench_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if(base_path && bench_read_baseline(base_path)) {
+        return -1;
+    }
+    if(bench_setup()) {
+        FDT_LOG_ERROR("setup failed\n");
+        return -1;
+    }
+
+    printf("================== BENCHMARK BEGIN ================\n");
+    bench_case("fdt_hash_name", BENCH_ITERS, bench_hash_name);
+    bench_case("fdt_hash_path", BENCH_ITERS, bench_hash_path);
+    bench_case("fdt_hash_prop_path", BENCH_ITERS, bench_hash_prop_path);
+    bench_case("fdt_get_root_node", BENCH_ITERS, bench_get_root_node);
+    bench_case("fdt_get_version", BENCH_ITERS, bench_get_version);
+    bench_case("fdt_read_begin/fdt_read_end", BENCH_ITERS, bench_read_begin_end);
+    bench_case("fdt_find_node_by_name", BENCH_ITERS, bench_find_node_by_name);
+    bench_case("fdt_find_node_by_path", BENCH_ITERS, bench_find_node_by_path);
+    bench_case("fdt_find_prop_by_name", BENCH_ITERS, bench_find_prop_by_name);
+    bench_case("fdt_find_prop_by_path", BENCH_ITERS, bench_find_prop_by_path);
+    bench_case("fdt_read_prop_string", BENCH_ITERS, bench_read_prop_string);
+    bench_case("fdt_read_prop_int", BENCH_ITERS, bench_read_prop_int);
+    bench_case("fdt_read_prop_int_index", BENCH_ITERS, bench_read_prop_int_index);
+    bench_case("fdt_read_prop_u32", BENCH_ITERS, bench_read_prop_u32);
+    bench_case("fdt_read_prop_u64", BENCH_ITERS, bench_read_prop_u64);
+    bench_case("fdt_read_prop_s32", BENCH_ITERS, bench_read_prop_s32);
+    bench_case("fdt_read_prop_bytes", BENCH_ITERS, bench_read_prop_bytes);
+    bench_case("fdt_prop_stream", BENCH_ITERS, bench_prop_stream);
+    bench_case("fdt_read_prop_string_by_path", BENCH_ITERS, bench_read_prop_string_by_path);
+    bench_case("fdt_read_prop_int_by_path", BENCH_ITERS, bench_read_prop_int_by_path);
+    bench_case("fdt_read_prop_int_index_by_path", BENCH_ITERS, bench_read_prop_int_index_by_path);
+    bench_case("fdt_read_prop_bytes_by_path", BENCH_ITERS, bench_read_prop_bytes_by_path);
+    bench_case("fdt_get_prop_value_size", BENCH_ITERS, bench_get_prop_value_size);
+    bench_case("fdt_get_prop_int_size", BENCH_ITERS, bench_get_prop_int_size);
+    bench_case("fdt_get_prop_int_size_by_path", BENCH_ITERS, bench_get_prop_int_size_by_path);
+    bench_case("fdt_get_prop_type", BENCH_ITERS, bench_get_prop_type);
+    bench_case("fdt_get_prop_type_by_path", BENCH_ITERS, bench_get_prop_type_by_path);
+    bench_case("fdt_blob_find_prop", BENCH_ITERS / 10, bench_blob_find_prop);
+    bench_case("fdt_compact_find_node", BENCH_ITERS, bench_compact_find_node);
+    bench_case("fdt_compact_find_prop", BENCH_ITERS, bench_compact_find_prop);
+    bench_case("fdt_walk", BENCH_LOAD_ITERS, bench_walk);
+    bench_case("fdt_compact_build", BENCH_LOAD_ITERS, bench_compact_build);
+
+    // every load replaces the tree, so they run last
+    bench_case("fdt_load", BENCH_LOAD_ITERS, bench_load);
+    bench_case("fdt_load_ex lazy", BENCH_LOAD_ITERS, bench_load_lazy);
+    bench_case("fdt_load_parallel", BENCH_LOAD_ITERS, bench_load_parallel);
+    printf("================== BENCHMARK END ================\n");
+
+    int ret = 0;
+    if(json_path) {
+        ret |= bench_write_json(json_path);
+    }
+    if(csv_path) {
+        ret |= bench_write_csv(csv_path);
+    }
+    if(base_path) {
+        printf("%d of %d cases slower than baseline by more than %.1f%%\n",
+               bench_regressions, bench_result_count, bench_tolerance);
+        ret |= bench_regressions ? -1 : 0;
+    }
+
+    fdt_unload();
+    fdt_writer_release(&bench_writer);
+    fdt_free(bench_compact);
+    fdt_free(bench_flush_buf);
+    return ret;
+}
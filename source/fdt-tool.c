@@ -0,0 +1,361 @@
+/*
+ * File Name: fdt-tool.c
+ *
+ * Copyright 2024-, lishanwen (1477153217@qq.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdt-writer.h"
+
+
+/**
+ * @brief print usage
+ *
+ * @param prog: program name
+ * @return none
+ */
+static void fdt_tool_usage(const char *prog)
+{
+    printf("usage: %s [-x] [-s] [-k] [-p] [-m] [-d base.dtb] [-o out.dtb] [-c out.c] in.dtb\n", prog);
+    printf("  -x         emit names with length and hash\n");
+    printf("  -s         emit subtree sizes of nodes\n");
+    printf("  -k         emit crc32 checksum of blob, fdt_load() verifies it\n");
+    printf("  -p         emit perfect hash tables of paths into out.c\n");
+    printf("  -m         print memory footprint of the loaded tree by top-level node\n");
+    printf("  -d base.dtb write patch from base.dtb, the blob on device, into out.dtb instead of blob\n");
+    printf("  -o out.dtb write binary blob\n");
+    printf("  -c out.c   write blob as c source\n");
+    printf("  in.dtb     fdt blob, or standard dtb made by dtc\n");
+}
+
+
+/**
+ * @brief read whole file
+ *
+ * @param path: file path
+ * @param size: output file size
+ * @return uint8_t*: file data, free it with fdt_free
+ */
+static uint8_t* fdt_tool_read_file(const char *path, uint32_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if(file == NULL) {
+        FDT_LOG_ERROR("open %s failed\n", path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t *data = len > 0 ? fdt_malloc(len) : NULL;
+    if(data == NULL || fread(data, 1, len, file) != (size_t)len) {
+        FDT_LOG_ERROR("read %s failed\n", path);
+        if(data) {
+            fdt_free(data);
+        }
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *size = (uint32_t)len;
+    return data;
+}
+
+
+/**
+ * @brief emit node and its descendants in document order
+ *
+ * @param writer: writer
+ * @param node: node
+ * @return none
+ */
+static void fdt_tool_emit_node(fdt_writer_t *writer, fdt_node_t *node)
+{
+    fdt_prop_t *prop = NULL;
+    fdt_node_t *child = NULL;
+
+    fdt_for_each_node_prop(node, prop) {
+        fdt_writer_prop_copy(writer, prop);
+    }
+
+    fdt_for_each_node_child(node, child) {
+        fdt_writer_begin_node(writer, child->name);
+        fdt_tool_emit_node(writer, child);
+        fdt_writer_end_node(writer);
+    }
+}
+
+
+/**
+ * @brief write perfect hash table as c source
+ *
+ * @param file: output file
+ * @param prefix: name prefix
+ * @param table: table
+ * @return none
+ */
+static void fdt_tool_put_table(FILE *file, const char *prefix, const fdt_phash_table_t *table)
+{
+    uint32_t n = table->count ? table->count : 1;
+
+    fprintf(file, "// negative displacement is -(slot + 1)\n");
+    fprintf(file, "static const int32_t fdt_blob_%s_disp[%u] = {", prefix, n);
+    for(uint32_t i = 0; i < n; i++) {
+        fprintf(file, "%s%d,", (i % 8) ? " " : "\n    ", table->disp[i]);
+    }
+    fprintf(file, "\n};\n\n");
+
+    // hash, ordinal, owner
+    fprintf(file, "static const fdt_phash_entry_t fdt_blob_%s_entry[%u] = {", prefix, n);
+    for(uint32_t i = 0; i < n; i++) {
+        const fdt_phash_entry_t *entry = &table->entry[i];
+        fprintf(file, "%s{0x%08x, %u, %u},", (i % 4) ? " " : "\n    ", entry->hash, entry->ordinal, entry->owner);
+    }
+    fprintf(file, "\n};\n\n");
+}
+
+
+/**
+ * @brief write blob as c source, it has the same symbols as fdtc
+ *
+ * @param path: output file path
+ * @param blob: blob data
+ * @param size: blob size
+ * @param phash: perfect hash tables, or NULL
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_tool_write_c(const char *path, const uint8_t *blob, uint32_t size, const fdt_phash_t *phash)
+{
+    FILE *file = fopen(path, "w");
+    if(file == NULL) {
+        FDT_LOG_ERROR("open %s failed\n", path);
+        return -1;
+    }
+
+    fprintf(file, "// Do not edit this file, as it is automatically generated\n");
+    fprintf(file, "// fdt-tool\n\n");
+    if(phash) {
+        fprintf(file, "#include \"fdt.h\"\n\n");
+    }
+
+    fprintf(file, "const char fdt_blob[%u] = {", size);
+    for(uint32_t i = 0; i < size; i++) {
+        fprintf(file, "%s0x%02x,", (i % 16) ? " " : "\n    ", blob[i]);
+    }
+    fprintf(file, "\n};\n\n");
+    fprintf(file, "const void *fdt_dts_blob = (void*)fdt_blob;\n");
+    fprintf(file, "const unsigned long long fdt_dts_size = %u;\n", size);
+
+    if(phash) {
+        fprintf(file, "\n");
+        fdt_tool_put_table(file, "node", &phash->node);
+        fdt_tool_put_table(file, "prop", &phash->prop);
+
+        fprintf(file, "// pass it to fdt_load_ex() with fdt_blob\n");
+        fprintf(file, "const fdt_phash_t fdt_blob_phash = {\n");
+        fprintf(file, "    .node = {%u, %u, fdt_blob_node_disp, fdt_blob_node_entry},\n",
+                phash->node.count, phash->node.total);
+        fprintf(file, "    .prop = {%u, %u, fdt_blob_prop_disp, fdt_blob_prop_entry},\n",
+                phash->prop.count, phash->prop.total);
+        fprintf(file, "};\n");
+    }
+
+    int ret = ferror(file) ? -1 : 0;
+    fclose(file);
+    return ret;
+}
+
+
+/**
+ * @brief write binary file
+ *
+ * @param path: output file path
+ * @param blob: blob data
+ * @param size: blob size
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_tool_write_bin(const char *path, const uint8_t *blob, uint32_t size)
+{
+    FILE *file = fopen(path, "wb");
+    if(file == NULL) {
+        FDT_LOG_ERROR("open %s failed\n", path);
+        return -1;
+    }
+
+    int ret = fwrite(blob, 1, size, file) == size ? 0 : -1;
+    fclose(file);
+    return ret;
+}
+
+
+/**
+ * @brief write patch from base blob to blob, it is checked by applying it to base
+ *
+ * @param base_path: base blob path
+ * @param path: output file path
+ * @param blob: blob data
+ * @param size: blob size
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_tool_write_patch(const char *base_path, const char *path, const uint8_t *blob, uint32_t size)
+{
+    uint32_t base_size = 0;
+    uint8_t *base = fdt_tool_read_file(base_path, &base_size);
+    if(base == NULL) {
+        return -1;
+    }
+
+    void *patch = NULL;
+    uint32_t patch_size = 0;
+    uint32_t check_size = 0;
+    uint8_t *check = fdt_malloc(size);
+    int ret = -1;
+
+    if(check == NULL || fdt_writer_build_patch(base, base_size, blob, size, &patch, &patch_size)) {
+        FDT_LOG_ERROR("build patch failed\n");
+    }
+    else if(fdt_load(base, base_size) || fdt_apply_patch(base, base_size, patch, patch_size, check, size, &check_size)) {
+        FDT_LOG_ERROR("patch does not apply to %s\n", base_path);
+    }
+    else {
+        printf("patch %u bytes, blob %u bytes\n", patch_size, size);
+        ret = fdt_tool_write_bin(path, patch, patch_size);
+    }
+
+    fdt_load(blob, size);
+    if(patch) {
+        fdt_free(patch);
+    }
+    if(check) {
+        fdt_free(check);
+    }
+    fdt_free(base);
+    return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+    const char *in_path = NULL;
+    const char *bin_path = NULL;
+    const char *c_path = NULL;
+    const char *base_path = NULL;
+    uint8_t flags = 0;
+    bool phash_enable = false;
+    bool mem_report = false;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-x") == 0) {
+            flags |= FDT_FLAG_NAME_HASH;
+        }
+        else if(strcmp(argv[i], "-s") == 0) {
+            flags |= FDT_FLAG_SUBTREE_SIZE;
+        }
+        else if(strcmp(argv[i], "-k") == 0) {
+            flags |= FDT_FLAG_CRC32;
+        }
+        else if(strcmp(argv[i], "-p") == 0) {
+            phash_enable = true;
+        }
+        else if(strcmp(argv[i], "-m") == 0) {
+            mem_report = true;
+        }
+        else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            base_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            bin_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            c_path = argv[++i];
+        }
+        else if(argv[i][0] != '-' && in_path == NULL) {
+            in_path = argv[i];
+        }
+        else {
+            fdt_tool_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if(in_path == NULL || (bin_path == NULL && c_path == NULL && !mem_report) || (base_path && bin_path == NULL)) {
+        fdt_tool_usage(argv[0]);
+        return -1;
+    }
+
+    uint32_t in_size = 0;
+    uint8_t *in = fdt_tool_read_file(in_path, &in_size);
+    if(in == NULL) {
+        return -1;
+    }
+
+    // a standard dtb is imported into a blob first
+    fdt_writer_t import;
+    const void *src = in;
+    uint32_t src_size = in_size;
+    fdt_writer_init(&import, NULL, 0, 0, 0);
+    if(in_size >= 4 && ((uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 8 | in[3]) == FDT_DTB_MAGIC) {
+        if(fdt_writer_import_dtb(&import, in, in_size) || fdt_writer_finish(&import, &src, &src_size)) {
+            FDT_LOG_ERROR("import %s failed\n", in_path);
+            return -1;
+        }
+    }
+
+    if(fdt_load(src, src_size)) {
+        FDT_LOG_ERROR("load %s failed\n", in_path);
+        return -1;
+    }
+
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t size = 0;
+    fdt_writer_init(&writer, NULL, 0, fdt_get_version(), flags);
+    fdt_tool_emit_node(&writer, fdt_get_root_node());
+    if(fdt_writer_finish(&writer, &blob, &size) || fdt_load(blob, size)) {
+        FDT_LOG_ERROR("emit blob failed\n");
+        return -1;
+    }
+
+    if(mem_report) {
+        fdt_debug_put_mem_report();
+    }
+
+    fdt_phash_t phash;
+    if(phash_enable && fdt_writer_build_phash(fdt_get_root_node(), &phash)) {
+        FDT_LOG_ERROR("build perfect hash failed\n");
+        return -1;
+    }
+
+    int ret = 0;
+    if(base_path) {
+        ret |= fdt_tool_write_patch(base_path, bin_path, blob, size);
+    }
+    else if(bin_path) {
+        ret |= fdt_tool_write_bin(bin_path, blob, size);
+    }
+    if(c_path) {
+        ret |= fdt_tool_write_c(c_path, blob, size, phash_enable ? &phash : NULL);
+    }
+
+    if(phash_enable) {
+        fdt_writer_free_phash(&phash);
+    }
+    fdt_unload();
+    fdt_writer_release(&writer);
+    fdt_writer_release(&import);
+    fdt_free(in);
+    return ret;
+}
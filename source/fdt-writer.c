@@ -0,0 +1,1701 @@
+/*
+ * File Name: fdt-writer.c
+ *
+ * Copyright 2024-, lishanwen (1477153217@qq.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdt-writer.h"
+
+
+/**
+ * @brief reserve space at the end of blob
+ * 
+ * @param writer: writer
+ * @param len: number of bytes
+ * @return uint8_t*: reserved space, NULL if buffer is full
+ */
+static uint8_t* fdt_writer_reserve(fdt_writer_t *writer, uint32_t len)
+{
+    if(writer->error) {
+        return NULL;
+    }
+
+    if(len > UINT32_MAX - writer->size) {
+        writer->error = -1;
+        return NULL;
+    }
+
+    if(writer->size + len > writer->cap) {
+        if(!writer->dynamic) {
+            FDT_LOG_ERROR("writer buffer is full\n");
+            writer->error = -1;
+            return NULL;
+        }
+
+        uint64_t cap = writer->cap ? writer->cap : 256;
+        while(cap < (uint64_t)writer->size + len) {
+            cap <<= 1;
+        }
+        if(cap > UINT32_MAX) {
+            cap = UINT32_MAX;
+        }
+
+        uint8_t *buf = fdt_malloc(cap);
+        if(buf == NULL) {
+            FDT_LOG_ERROR("writer malloc failed\n");
+            writer->error = -1;
+            return NULL;
+        }
+
+        if(writer->buf) {
+            fdt_memcpy(buf, writer->buf, writer->size);
+            fdt_free(writer->buf);
+        }
+        writer->buf = buf;
+        writer->cap = (uint32_t)cap;
+    }
+
+    uint8_t *space = writer->buf + writer->size;
+    writer->size += len;
+    return space;
+}
+
+
+/**
+ * @brief put bytes at the end of blob
+ * 
+ * @param writer: writer
+ * @param data: data
+ * @param len: number of bytes
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_writer_put(fdt_writer_t *writer, const void *data, uint32_t len)
+{
+    uint8_t *space = fdt_writer_reserve(writer, len);
+    if(space == NULL) {
+        return -1;
+    }
+
+    fdt_memcpy(space, data, len);
+    return 0;
+}
+
+
+/**
+ * @brief put little endian value at the end of blob
+ * 
+ * @param writer: writer
+ * @param value: value
+ * @param bytes: number of bytes
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_writer_put_le(fdt_writer_t *writer, uint64_t value, uint8_t bytes)
+{
+    uint8_t *space = fdt_writer_reserve(writer, bytes);
+    if(space == NULL) {
+        return -1;
+    }
+
+    for(uint8_t i = 0; i < bytes; i++) {
+        space[i] = (uint8_t)(value >> (i * 8));
+    }
+    return 0;
+}
+
+
+/**
+ * @brief put string with its terminating zero
+ * 
+ * @param writer: writer
+ * @param str: string
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_writer_put_string(fdt_writer_t *writer, const char *str)
+{
+    return fdt_writer_put(writer, str, fdt_strlen(str) + 1);
+}
+
+
+/**
+ * @brief put node or property name, with length and hash if the format has them
+ * 
+ * @param writer: writer
+ * @param name: name
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_writer_put_name(fdt_writer_t *writer, const char *name)
+{
+    if(writer->flags & FDT_FLAG_NAME_HASH) {
+        size_t len = fdt_strlen(name);
+        if(len > 0xff) {
+            FDT_LOG_ERROR("writer name is too long: %s\n", name);
+            writer->error = -1;
+            return -1;
+        }
+
+        fdt_writer_put_le(writer, len, 1);
+        fdt_writer_put_le(writer, fdt_hash_name(name, len), 2);
+    }
+
+    return fdt_writer_put_string(writer, name);
+}
+
+
+/**
+ * @brief put subtree size fields of a node, they are filled when it ends
+ * 
+ * @param writer: writer
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_writer_put_subtree_size(fdt_writer_t *writer)
+{
+    if(!(writer->flags & FDT_FLAG_SUBTREE_SIZE)) {
+        return 0;
+    }
+
+    writer->size_pos[writer->level] = writer->size;
+    fdt_writer_put_le(writer, 0, 4);
+    return fdt_writer_put_le(writer, UINT32_MAX, 4);
+}
+
+
+/**
+ * @brief fill property size of a node if its properties have ended
+ * 
+ * @param writer: writer
+ * @param level: level of node
+ * @return none
+ */
+static void fdt_writer_end_props(fdt_writer_t *writer, uint8_t level)
+{
+    if(!(writer->flags & FDT_FLAG_SUBTREE_SIZE) || writer->error) {
+        return;
+    }
+
+    uint8_t *field = writer->buf + writer->size_pos[level];
+    uint32_t size = writer->size - writer->size_pos[level] - 8;
+
+    if(field[4] == 0xff && field[5] == 0xff && field[6] == 0xff && field[7] == 0xff) {
+        for(uint8_t i = 0; i < 4; i++) {
+            field[4 + i] = (uint8_t)(size >> (i * 8));
+        }
+    }
+}
+
+
+/**
+ * @brief fill subtree size of a node when it ends
+ * 
+ * @param writer: writer
+ * @param level: level of node
+ * @return none
+ */
+static void fdt_writer_end_subtree(fdt_writer_t *writer, uint8_t level)
+{
+    if(!(writer->flags & FDT_FLAG_SUBTREE_SIZE) || writer->error) {
+        return;
+    }
+
+    uint8_t *field = writer->buf + writer->size_pos[level];
+    uint32_t size = writer->size - writer->size_pos[level] - 8;
+
+    fdt_writer_end_props(writer, level);
+    for(uint8_t i = 0; i < 4; i++) {
+        field[i] = (uint8_t)(size >> (i * 8));
+    }
+}
+
+
+/**
+ * @brief begin a property of current node
+ * 
+ * @param writer: writer
+ * @param name: property name
+ * @param type: type byte of property value
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_writer_begin_prop(fdt_writer_t *writer, const char *name, uint8_t type)
+{
+    uint8_t token = 0xff;
+
+    fdt_writer_put(writer, &token, 1);
+    fdt_writer_put_name(writer, name);
+    return fdt_writer_put(writer, &type, 1);
+}
+
+
+/**
+ * @brief get the fewest bytes to hold a value
+ * 
+ * @param value: value
+ * @return uint8_t: number of bytes, at least 1
+ */
+static uint8_t fdt_writer_value_bytes(uint64_t value)
+{
+    uint8_t bytes = 1;
+
+    while(bytes < 8 && (value >> (bytes * 8))) {
+        bytes ++;
+    }
+
+    return bytes;
+}
+
+
+/**
+ * @brief initialize writer and emit blob header and root node
+ * 
+ * @param writer: writer
+ * @param buf: output buffer, NULL to let writer allocate it
+ * @param cap: output buffer size
+ * @param version: blob version
+ * @param flags: format flags
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_init(fdt_writer_t *writer, void *buf, uint32_t cap, uint32_t version, uint8_t flags)
+{
+    fdt_memset(writer, 0, sizeof(fdt_writer_t));
+    writer->buf = buf;
+    writer->cap = buf ? cap : 0;
+    writer->dynamic = (buf == NULL);
+    writer->flags = flags;
+
+    if(flags) {
+        fdt_writer_put_le(writer, FDT_MAGIC_EXT, 3);
+        fdt_writer_put_le(writer, version, 3);
+        fdt_writer_put_le(writer, flags, 1);
+        if(flags & FDT_FLAG_CRC32) {
+            // blob size and checksum, filled by fdt_writer_finish()
+            fdt_writer_put_le(writer, 0, 8);
+        }
+    }
+    else {
+        fdt_writer_put_le(writer, FDT_MAGIC, 3);
+        fdt_writer_put_le(writer, version, 3);
+    }
+    fdt_writer_put_le(writer, 0, 1);
+    fdt_writer_put_name(writer, "/");
+    fdt_writer_put_subtree_size(writer);
+
+    return writer->error;
+}
+
+
+/**
+ * @brief begin a child node of current node
+ * 
+ * @param writer: writer
+ * @param name: node name
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_begin_node(fdt_writer_t *writer, const char *name)
+{
+    if(writer->level == 0xfe) {
+        FDT_LOG_ERROR("writer node is too deep\n");
+        writer->error = -1;
+        return -1;
+    }
+
+    fdt_writer_end_props(writer, writer->level);
+    writer->level ++;
+    fdt_writer_put(writer, &writer->level, 1);
+    fdt_writer_put_name(writer, name);
+    return fdt_writer_put_subtree_size(writer);
+}
+
+
+/**
+ * @brief end current node
+ * 
+ * @param writer: writer
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_end_node(fdt_writer_t *writer)
+{
+    if(writer->level == 0) {
+        writer->error = -1;
+        return -1;
+    }
+
+    fdt_writer_end_subtree(writer, writer->level);
+    writer->level --;
+    return writer->error;
+}
+
+
+/**
+ * @brief add string property to current node
+ * 
+ * @param writer: writer
+ * @param name: property name
+ * @param value: string value
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_prop_string(fdt_writer_t *writer, const char *name, const char *value)
+{
+    fdt_writer_begin_prop(writer, name, FDT_PROP_STRING);
+    return fdt_writer_put_string(writer, value);
+}
+
+
+/**
+ * @brief add integer property to current node
+ * 
+ * @param writer: writer
+ * @param name: property name
+ * @param value: integer value
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_prop_int(fdt_writer_t *writer, const char *name, uint64_t value)
+{
+    uint8_t bytes = fdt_writer_value_bytes(value);
+
+    fdt_writer_begin_prop(writer, name, FDT_PROP_INT + bytes - 1);
+    return fdt_writer_put_le(writer, value, bytes);
+}
+
+
+/**
+ * @brief add array property to current node
+ * 
+ * @param writer: writer
+ * @param name: property name
+ * @param cells: array values
+ * @param count: number of values
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_prop_array(fdt_writer_t *writer, const char *name, const uint64_t *cells, uint32_t count)
+{
+    uint8_t cell_size = 1;
+
+    for(uint32_t i = 0; i < count; i++) {
+        uint8_t bytes = fdt_writer_value_bytes(cells[i]);
+        if(bytes > cell_size) {
+            cell_size = bytes;
+        }
+    }
+
+    if(count <= 0xff) {
+        fdt_writer_begin_prop(writer, name, FDT_PROP_ARRAY + cell_size);
+        fdt_writer_put_le(writer, count, 1);
+    }
+    else {
+        fdt_writer_begin_prop(writer, name, FDT_PROP_LONG_ARRAY + cell_size);
+        fdt_writer_put_le(writer, count, 4);
+    }
+
+    for(uint32_t i = 0; i < count; i++) {
+        fdt_writer_put_le(writer, cells[i], cell_size);
+    }
+
+    return writer->error;
+}
+
+
+/**
+ * @brief add bytes property to current node
+ * 
+ * @param writer: writer
+ * @param name: property name
+ * @param data: raw bytes
+ * @param len: number of bytes
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_prop_bytes(fdt_writer_t *writer, const char *name, const void *data, uint32_t len)
+{
+    fdt_writer_begin_prop(writer, name, FDT_PROP_BYTES);
+    fdt_writer_put_le(writer, len, 4);
+    return fdt_writer_put(writer, data, len);
+}
+
+
+/**
+ * @brief add reference property to current node
+ * 
+ * @param writer: writer
+ * @param name: property name
+ * @param paths: paths of referenced nodes
+ * @param count: number of references, at most 255
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_prop_ref(fdt_writer_t *writer, const char *name, const char *const *paths, uint32_t count)
+{
+    if(count > 0xff) {
+        writer->error = -1;
+        return -1;
+    }
+
+    fdt_writer_begin_prop(writer, name, FDT_PROP_REF);
+    fdt_writer_put_le(writer, count, 1);
+    for(uint32_t i = 0; i < count; i++) {
+        fdt_writer_put_string(writer, paths[i]);
+    }
+
+    return writer->error;
+}
+
+
+/**
+ * @brief finish the blob
+ * 
+ * @param writer: writer
+ * @param blob: blob data
+ * @param size: blob size
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_finish(fdt_writer_t *writer, const void **blob, uint32_t *size)
+{
+    while(writer->level > 0) {
+        fdt_writer_end_node(writer);
+    }
+    fdt_writer_end_subtree(writer, 0);
+
+    if(writer->error) {
+        return -1;
+    }
+
+    if(writer->flags & FDT_FLAG_CRC32) {
+        uint32_t crc = fdt_crc32(0, writer->buf + 15, writer->size - 15);
+        for(uint8_t i = 0; i < 4; i++) {
+            writer->buf[7 + i] = (uint8_t)(writer->size >> (i * 8));
+            writer->buf[11 + i] = (uint8_t)(crc >> (i * 8));
+        }
+    }
+
+    *blob = writer->buf;
+    *size = writer->size;
+    return 0;
+}
+
+
+/**
+ * @brief release the buffer allocated by writer
+ * 
+ * @param writer: writer
+ * @return none
+ */
+void fdt_writer_release(fdt_writer_t *writer)
+{
+    if(writer->dynamic && writer->buf) {
+        fdt_free(writer->buf);
+    }
+
+    writer->buf = NULL;
+    writer->size = 0;
+    writer->cap = 0;
+}
+
+
+/**
+ * @brief add property with raw value to current node
+ * 
+ * @param writer: writer
+ * @param name: property name
+ * @param value: raw value starting with type byte
+ * @param size: size of value
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_writer_prop_raw(fdt_writer_t *writer, const char *name, const void *value, uint32_t size)
+{
+    uint8_t token = 0xff;
+
+    fdt_writer_put(writer, &token, 1);
+    fdt_writer_put_name(writer, name);
+    return fdt_writer_put(writer, value, size);
+}
+
+
+/**
+ * @brief copy a loaded property to current node
+ * 
+ * @param writer: writer
+ * @param prop: property
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_prop_copy(fdt_writer_t *writer, const fdt_prop_t *prop)
+{
+    return fdt_writer_prop_raw(writer, prop->name, prop->offset, fdt_get_prop_value_size(prop));
+}
+
+
+#define FDT_DTB_BEGIN_NODE          0x1
+#define FDT_DTB_END_NODE            0x2
+#define FDT_DTB_PROP                0x3
+#define FDT_DTB_NOP                 0x4
+#define FDT_DTB_END                 0x9
+#define FDT_DTB_HEADER_SIZE         40
+
+
+/**
+ * @brief get big endian 32-bit value of standard dtb
+ * 
+ * @param data: data
+ * @return uint32_t: value
+ */
+static inline uint32_t fdt_dtb_get_be32(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+
+/**
+ * @brief check if a dtb property value is one printable string
+ * 
+ * @param value: property value
+ * @param len: value length
+ * @return bool: true if it is one string with its terminating zero
+ */
+static bool fdt_dtb_is_string(const uint8_t *value, uint32_t len)
+{
+    if(len < 2 || value[len - 1] != '\0') {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < len - 1; i++) {
+        if(value[i] < 0x20 || value[i] > 0x7e) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief add a dtb property to current node, the type is guessed from its value
+ * 
+ * @param writer: writer
+ * @param name: property name
+ * @param value: property value, big endian cells
+ * @param len: value length
+ * @return int: 0: success, -1: fail
+ * @note one string becomes string, one cell becomes int, several cells become
+ *       array, others (empty, string lists, odd sizes) are kept as bytes.
+ */
+static int fdt_writer_import_prop(fdt_writer_t *writer, const char *name, const uint8_t *value, uint32_t len)
+{
+    if(fdt_dtb_is_string(value, len)) {
+        return fdt_writer_prop_string(writer, name, (const char*)value);
+    }
+
+    if(len == 0 || len % 4) {
+        return fdt_writer_prop_bytes(writer, name, value, len);
+    }
+
+    if(len == 4) {
+        return fdt_writer_prop_int(writer, name, fdt_dtb_get_be32(value));
+    }
+
+    uint32_t count = len / 4;
+    uint64_t *cells = fdt_malloc(count * sizeof(uint64_t));
+    if(cells == NULL) {
+        FDT_LOG_ERROR("import malloc failed\n");
+        writer->error = -1;
+        return -1;
+    }
+
+    for(uint32_t i = 0; i < count; i++) {
+        cells[i] = fdt_dtb_get_be32(value + i * 4);
+    }
+
+    int ret = fdt_writer_prop_array(writer, name, cells, count);
+    fdt_free(cells);
+    return ret;
+}
+
+
+/**
+ * @brief import a standard flattened device tree produced by dtc
+ * 
+ * @param writer: writer, its current node is the root node of dtb
+ * @param dtb: standard dtb, version 16 or 17
+ * @param dtb_size: dtb size
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_import_dtb(fdt_writer_t *writer, const void *dtb, uint32_t dtb_size)
+{
+    const uint8_t *data = dtb;
+
+    if(dtb_size < FDT_DTB_HEADER_SIZE || fdt_dtb_get_be32(data) != FDT_DTB_MAGIC) {
+        FDT_LOG_ERROR("dtb magic error\n");
+        return -1;
+    }
+
+    uint32_t total = fdt_dtb_get_be32(data + 4);
+    uint32_t off_struct = fdt_dtb_get_be32(data + 8);
+    uint32_t off_strings = fdt_dtb_get_be32(data + 12);
+    uint32_t version = fdt_dtb_get_be32(data + 20);
+    uint32_t last_comp = fdt_dtb_get_be32(data + 24);
+    uint32_t size_strings = fdt_dtb_get_be32(data + 32);
+    uint32_t size_struct = fdt_dtb_get_be32(data + 36);
+
+    if(version < 16 || last_comp > 17) {
+        FDT_LOG_ERROR("dtb version %u is not supported\n", version);
+        return -1;
+    }
+    if(version < 17) {
+        size_struct = total > off_struct ? total - off_struct : 0;
+    }
+    if(total > dtb_size || off_struct > total || size_struct > total - off_struct ||
+       off_strings > total || size_strings > total - off_strings) {
+        FDT_LOG_ERROR("dtb header error\n");
+        return -1;
+    }
+
+    const uint8_t *pos = data + off_struct;
+    const uint8_t *end = pos + size_struct;
+    const char *strings = (const char*)data + off_strings;
+    uint32_t level = 0;
+
+    while(pos + 4 <= end && writer->error == 0) {
+        uint32_t token = fdt_dtb_get_be32(pos);
+        pos += 4;
+
+        if(token == FDT_DTB_BEGIN_NODE) {
+            const uint8_t *name = pos;
+            while(pos < end && *pos) {
+                pos ++;
+            }
+            if(pos >= end) {
+                break;
+            }
+            // the root node of dtb is current node of writer
+            if(level ++ > 0) {
+                fdt_writer_begin_node(writer, (const char*)name);
+            }
+            pos = name + ((pos - name + 1 + 3) & ~3u);
+            pos = pos < end ? pos : end;
+        }
+        else if(token == FDT_DTB_END_NODE) {
+            if(level == 0) {
+                break;
+            }
+            if(-- level > 0) {
+                fdt_writer_end_node(writer);
+            }
+        }
+        else if(token == FDT_DTB_PROP) {
+            if(end - pos < 8 || level == 0) {
+                break;
+            }
+            uint32_t len = fdt_dtb_get_be32(pos);
+            uint32_t name_off = fdt_dtb_get_be32(pos + 4);
+            pos += 8;
+            if(len > (uint32_t)(end - pos) || name_off >= size_strings ||
+               memchr(strings + name_off, '\0', size_strings - name_off) == NULL) {
+                break;
+            }
+            fdt_writer_import_prop(writer, strings + name_off, pos, len);
+            pos += len;
+            pos += (uint32_t)(end - pos) < ((4 - len) & 3) ? (uint32_t)(end - pos) : ((4 - len) & 3);
+        }
+        else if(token == FDT_DTB_END) {
+            if(level == 0) {
+                return writer->error;
+            }
+            break;
+        }
+        else if(token != FDT_DTB_NOP) {
+            break;
+        }
+    }
+
+    if(writer->error == 0) {
+        FDT_LOG_ERROR("dtb structure error\n");
+        writer->error = -1;
+    }
+    return -1;
+}
+
+
+/**
+ * @brief path key of perfect hash table
+ * @hash: path hash.
+ * @ordinal: document order index of node or property.
+ * @owner: document order index of the node owning the property.
+ * @bucket: bucket of key in perfect hash table.
+ * @path: full path.
+ */
+typedef struct fdt_phash_key {
+    uint64_t hash;
+    uint32_t ordinal;
+    uint32_t owner;
+    uint32_t bucket;
+    char *path;
+
+}fdt_phash_key_t;
+
+
+/**
+ * @brief keys of a tree collected in document order
+ * @nodes: node keys, the root node is not included.
+ * @props: property keys.
+ * @path: path of current node.
+ * @path_len: length of path.
+ * @path_cap: capacity of path buffer.
+ * @node_total: number of nodes including root node.
+ * @prop_total: number of properties.
+ * @error: sticky error.
+ */
+typedef struct fdt_phash_walk {
+    fdt_phash_key_t *nodes;
+    fdt_phash_key_t *props;
+    uint32_t node_cap;
+    uint32_t prop_cap;
+    char *path;
+    size_t path_len;
+    size_t path_cap;
+    uint32_t node_total;
+    uint32_t prop_total;
+    int error;
+
+}fdt_phash_walk_t;
+
+
+/**
+ * @brief append a key to key array
+ * 
+ * @param keys: key array
+ * @param count: number of keys, it is increased
+ * @param cap: capacity of key array
+ * @param key: key
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_phash_push_key(fdt_phash_key_t **keys, uint32_t count, uint32_t *cap, const fdt_phash_key_t *key)
+{
+    if(count == *cap) {
+        uint32_t new_cap = *cap ? *cap * 2 : 64;
+        fdt_phash_key_t *new_keys = fdt_malloc(sizeof(fdt_phash_key_t) * new_cap);
+        if(new_keys == NULL) {
+            return -1;
+        }
+
+        if(*keys) {
+            fdt_memcpy(new_keys, *keys, sizeof(fdt_phash_key_t) * count);
+            fdt_free(*keys);
+        }
+        *keys = new_keys;
+        *cap = new_cap;
+    }
+
+    (*keys)[count] = *key;
+    return 0;
+}
+
+
+/**
+ * @brief append a name to path of current node
+ * 
+ * @param walk: walk state
+ * @param name: name
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_phash_path_push(fdt_phash_walk_t *walk, const char *name)
+{
+    size_t len = fdt_strlen(name);
+
+    if(walk->path_len + len + 2 > walk->path_cap) {
+        size_t cap = walk->path_cap ? walk->path_cap : 256;
+        while(cap < walk->path_len + len + 2) {
+            cap <<= 1;
+        }
+
+        char *path = fdt_malloc(cap);
+        if(path == NULL) {
+            return -1;
+        }
+        if(walk->path) {
+            fdt_memcpy(path, walk->path, walk->path_len);
+            fdt_free(walk->path);
+        }
+        walk->path = path;
+        walk->path_cap = cap;
+    }
+
+    walk->path[walk->path_len] = '/';
+    fdt_memcpy(walk->path + walk->path_len + 1, name, len + 1);
+    walk->path_len += len + 1;
+    return 0;
+}
+
+
+/**
+ * @brief make key of current path
+ * 
+ * @param walk: walk state
+ * @param key: key, path is copied
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_phash_path_key(fdt_phash_walk_t *walk, fdt_phash_key_t *key)
+{
+    key->path = fdt_malloc(walk->path_len + 1);
+    if(key->path == NULL) {
+        return -1;
+    }
+
+    fdt_memcpy(key->path, walk->path, walk->path_len + 1);
+    return 0;
+}
+
+
+/**
+ * @brief collect keys of node and its descendants in document order,
+ *        properties of a node come before its children as in the blob
+ * 
+ * @param walk: walk state
+ * @param node: node
+ * @param ordinal: document order index of node
+ * @return none
+ */
+static void fdt_phash_collect(fdt_phash_walk_t *walk, fdt_node_t *node, uint32_t ordinal)
+{
+    fdt_prop_t *prop = NULL;
+    fdt_node_t *child = NULL;
+    size_t path_len = walk->path_len;
+
+    fdt_for_each_node_prop(node, prop) {
+        fdt_phash_key_t key = {0};
+
+        if(walk->error || fdt_phash_path_push(walk, prop->name) || fdt_phash_path_key(walk, &key)) {
+            walk->error = -1;
+            return;
+        }
+        walk->path_len = path_len;
+
+        key.hash = fdt_hash_prop_path(key.path);
+        key.ordinal = walk->prop_total;
+        key.owner = ordinal;
+        if(fdt_phash_push_key(&walk->props, walk->prop_total, &walk->prop_cap, &key)) {
+            fdt_free(key.path);
+            walk->error = -1;
+            return;
+        }
+        walk->prop_total ++;
+    }
+
+    fdt_for_each_node_child(node, child) {
+        fdt_phash_key_t key = {0};
+        uint32_t child_ordinal = walk->node_total;
+
+        if(walk->error || fdt_phash_path_push(walk, child->name) || fdt_phash_path_key(walk, &key)) {
+            walk->error = -1;
+            return;
+        }
+
+        key.hash = fdt_hash_path(key.path);
+        key.ordinal = child_ordinal;
+        if(fdt_phash_push_key(&walk->nodes, walk->node_total - 1, &walk->node_cap, &key)) {
+            fdt_free(key.path);
+            walk->error = -1;
+            return;
+        }
+        walk->node_total ++;
+
+        fdt_phash_collect(walk, child, child_ordinal);
+        walk->path_len = path_len;
+    }
+}
+
+
+/**
+ * @brief compare keys by hash, then by document order
+ * 
+ * @param a: key
+ * @param b: key
+ * @return int: compare result
+ */
+static int fdt_phash_key_compare(const void *a, const void *b)
+{
+    const fdt_phash_key_t *ka = a;
+    const fdt_phash_key_t *kb = b;
+
+    if(ka->hash != kb->hash) {
+        return ka->hash < kb->hash ? -1 : 1;
+    }
+    if(ka->ordinal != kb->ordinal) {
+        return ka->ordinal < kb->ordinal ? -1 : 1;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief drop duplicate paths, the first one in document order is kept as
+ *        the tree lookup returns it
+ * 
+ * @param keys: keys sorted by fdt_phash_key_compare()
+ * @param count: number of keys
+ * @return int: number of distinct keys, -1 if two paths have the same hash
+ * @note the key array is compacted, paths of dropped keys are freed and
+ *       the unused tail has NULL paths
+ */
+static int fdt_phash_unique(fdt_phash_key_t *keys, uint32_t count)
+{
+    uint32_t unique = 0;
+
+    for(uint32_t i = 0; i < count; i++) {
+        if(unique > 0 && keys[unique - 1].hash == keys[i].hash) {
+            if(fdt_strcmp(keys[unique - 1].path, keys[i].path) != 0) {
+                FDT_LOG_ERROR("path hash collision: %s, %s\n", keys[unique - 1].path, keys[i].path);
+                return -1;
+            }
+            fdt_free(keys[i].path);
+            keys[i].path = NULL;
+            continue;
+        }
+
+        keys[unique] = keys[i];
+        if(unique != i) {
+            keys[i].path = NULL;
+        }
+        unique ++;
+    }
+
+    return (int)unique;
+}
+
+
+/**
+ * @brief bucket of keys while searching displacements
+ * @first: first key in bucket.
+ * @size: number of keys in bucket.
+ * @index: bucket index.
+ */
+typedef struct fdt_phash_bucket {
+    uint32_t first;
+    uint32_t size;
+    uint32_t index;
+
+}fdt_phash_bucket_t;
+
+
+/**
+ * @brief compare buckets, larger bucket first
+ * 
+ * @param a: bucket
+ * @param b: bucket
+ * @return int: compare result
+ */
+static int fdt_phash_bucket_compare(const void *a, const void *b)
+{
+    const fdt_phash_bucket_t *ba = a;
+    const fdt_phash_bucket_t *bb = b;
+
+    if(ba->size != bb->size) {
+        return ba->size > bb->size ? -1 : 1;
+    }
+    return ba->index < bb->index ? -1 : (ba->index > bb->index);
+}
+
+
+/**
+ * @brief compare keys by bucket
+ * 
+ * @param a: key
+ * @param b: key
+ * @return int: compare result
+ */
+static int fdt_phash_key_bucket_compare(const void *a, const void *b)
+{
+    uint32_t ba = ((const fdt_phash_key_t*)a)->bucket;
+    uint32_t bb = ((const fdt_phash_key_t*)b)->bucket;
+
+    return ba < bb ? -1 : (ba > bb);
+}
+
+
+/**
+ * @brief build one perfect hash table with hash and displace, buckets with
+ *        more keys search a displacement which moves every key to a free
+ *        slot, single key buckets take the remaining free slots directly
+ * 
+ * @param table: output table
+ * @param keys: distinct keys
+ * @param count: number of keys
+ * @param total: number of nodes or properties in document order
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_phash_build_table(fdt_phash_table_t *table, fdt_phash_key_t *keys, uint32_t count, uint32_t total)
+{
+    uint32_t n = count ? count : 1;
+    int32_t *disp = fdt_malloc(sizeof(int32_t) * n);
+    fdt_phash_entry_t *entry = fdt_malloc(sizeof(fdt_phash_entry_t) * n);
+    uint32_t *slots = fdt_malloc(sizeof(uint32_t) * n);
+    bool *used = fdt_malloc(sizeof(bool) * n);
+    fdt_phash_bucket_t *buckets = fdt_malloc(sizeof(fdt_phash_bucket_t) * n);
+    int ret = -1;
+
+    table->count = count;
+    table->total = total;
+    table->disp = disp;
+    table->entry = entry;
+
+    if(disp == NULL || entry == NULL || slots == NULL || used == NULL || buckets == NULL) {
+        FDT_LOG_ERROR("malloc perfect hash table failed\n");
+        goto out;
+    }
+
+    fdt_memset(disp, 0, sizeof(int32_t) * n);
+    fdt_memset(entry, 0, sizeof(fdt_phash_entry_t) * n);
+    fdt_memset(used, 0, sizeof(bool) * n);
+
+    for(uint32_t i = 0; i < count; i++) {
+        keys[i].bucket = (uint32_t)keys[i].hash % n;
+    }
+    qsort(keys, count, sizeof(fdt_phash_key_t), fdt_phash_key_bucket_compare);
+
+    uint32_t bucket_count = 0;
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t index = keys[i].bucket;
+        if(bucket_count == 0 || buckets[bucket_count - 1].index != index) {
+            buckets[bucket_count].first = i;
+            buckets[bucket_count].size = 0;
+            buckets[bucket_count].index = index;
+            bucket_count ++;
+        }
+        buckets[bucket_count - 1].size ++;
+    }
+    qsort(buckets, bucket_count, sizeof(fdt_phash_bucket_t), fdt_phash_bucket_compare);
+
+    uint32_t free_slot = 0;
+    for(uint32_t b = 0; b < bucket_count; b++) {
+        fdt_phash_bucket_t *bucket = &buckets[b];
+        fdt_phash_key_t *bucket_keys = &keys[bucket->first];
+
+        if(bucket->size == 1) {
+            while(used[free_slot]) {
+                free_slot ++;
+            }
+            slots[0] = free_slot;
+            disp[bucket->index] = -(int32_t)free_slot - 1;
+        }
+        else {
+            int32_t d = 0;
+            for(; d < INT32_MAX; d++) {
+                uint32_t placed = 0;
+
+                disp[bucket->index] = d;
+                for(; placed < bucket->size; placed++) {
+                    uint32_t slot = fdt_phash_slot(disp, n, bucket_keys[placed].hash);
+                    if(used[slot]) {
+                        break;
+                    }
+                    used[slot] = true;
+                    slots[placed] = slot;
+                }
+
+                for(uint32_t i = 0; i < placed; i++) {
+                    used[slots[i]] = false;
+                }
+                if(placed == bucket->size) {
+                    break;
+                }
+            }
+
+            if(d == INT32_MAX) {
+                FDT_LOG_ERROR("perfect hash displacement not found\n");
+                goto out;
+            }
+        }
+
+        for(uint32_t i = 0; i < bucket->size; i++) {
+            used[slots[i]] = true;
+            entry[slots[i]].hash = (uint32_t)bucket_keys[i].hash;
+            entry[slots[i]].ordinal = bucket_keys[i].ordinal;
+            entry[slots[i]].owner = bucket_keys[i].owner;
+        }
+    }
+
+    ret = 0;
+
+out:
+    if(slots) {
+        fdt_free(slots);
+    }
+    if(used) {
+        fdt_free(used);
+    }
+    if(buckets) {
+        fdt_free(buckets);
+    }
+    return ret;
+}
+
+
+/**
+ * @brief free keys and their paths
+ * 
+ * @param keys: keys
+ * @param count: number of keys
+ * @return none
+ */
+static void fdt_phash_free_keys(fdt_phash_key_t *keys, uint32_t count)
+{
+    if(keys == NULL) {
+        return;
+    }
+
+    for(uint32_t i = 0; i < count; i++) {
+        if(keys[i].path) {
+            fdt_free(keys[i].path);
+        }
+    }
+    fdt_free(keys);
+}
+
+
+/**
+ * @brief build perfect hash tables of a loaded tree
+ * 
+ * @param root: root node
+ * @param phash: output tables, free them with fdt_writer_free_phash()
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_build_phash(fdt_node_t *root, fdt_phash_t *phash)
+{
+    fdt_phash_walk_t walk = {0};
+    int node_count = -1;
+    int prop_count = -1;
+    int ret = -1;
+
+    fdt_memset(phash, 0, sizeof(fdt_phash_t));
+
+    walk.node_total = 1;
+    fdt_phash_collect(&walk, root, 0);
+    if(walk.error) {
+        FDT_LOG_ERROR("collect perfect hash keys failed\n");
+        goto out;
+    }
+
+    qsort(walk.nodes, walk.node_total - 1, sizeof(fdt_phash_key_t), fdt_phash_key_compare);
+    qsort(walk.props, walk.prop_total, sizeof(fdt_phash_key_t), fdt_phash_key_compare);
+
+    node_count = fdt_phash_unique(walk.nodes, walk.node_total - 1);
+    prop_count = fdt_phash_unique(walk.props, walk.prop_total);
+    if(node_count < 0 || prop_count < 0) {
+        goto out;
+    }
+
+    if(fdt_phash_build_table(&phash->node, walk.nodes, node_count, walk.node_total) ||
+       fdt_phash_build_table(&phash->prop, walk.props, prop_count, walk.prop_total)) {
+        fdt_writer_free_phash(phash);
+        goto out;
+    }
+
+    ret = 0;
+
+out:
+    fdt_phash_free_keys(walk.nodes, walk.node_total - 1);
+    fdt_phash_free_keys(walk.props, walk.prop_total);
+    if(walk.path) {
+        fdt_free(walk.path);
+    }
+    return ret;
+}
+
+
+/**
+ * @brief free perfect hash tables built by fdt_writer_build_phash()
+ * 
+ * @param phash: tables
+ * @return none
+ */
+void fdt_writer_free_phash(fdt_phash_t *phash)
+{
+    fdt_phash_table_t *tables[2] = {&phash->node, &phash->prop};
+
+    for(int i = 0; i < 2; i++) {
+        if(tables[i]->disp) {
+            fdt_free((void*)tables[i]->disp);
+        }
+        if(tables[i]->entry) {
+            fdt_free((void*)tables[i]->entry);
+        }
+    }
+
+    fdt_memset(phash, 0, sizeof(fdt_phash_t));
+}
+
+
+#define FDT_DIFF_NONE               UINT32_MAX
+
+
+/**
+ * @brief node or property of a blob being diffed, in document order
+ * @name: name, it points into the blob.
+ * @value: raw value of property, NULL for node.
+ * @size: size of property value, or index after the last descendant of node.
+ */
+typedef struct fdt_diff_entry {
+    const char *name;
+    const uint8_t *value;
+    uint32_t size;
+
+}fdt_diff_entry_t;
+
+
+/**
+ * @brief blob being diffed
+ * @entry: nodes and properties in document order, the root node is the first.
+ * @count: number of entries.
+ * @cap: capacity of entries.
+ * @open: index of open node of each level while the blob is walked.
+ */
+typedef struct fdt_diff_tree {
+    fdt_diff_entry_t *entry;
+    uint32_t count;
+    uint32_t cap;
+    uint32_t open[256];
+
+}fdt_diff_tree_t;
+
+
+/**
+ * @brief diff of two blobs
+ * @base: base blob.
+ * @target: target blob.
+ * @patch: patch being written.
+ * @op: pending count op.
+ * @count: count of pending op, 0 if none.
+ */
+typedef struct fdt_diff {
+    fdt_diff_tree_t base;
+    fdt_diff_tree_t target;
+    fdt_writer_t patch;
+    uint8_t op;
+    uint32_t count;
+
+}fdt_diff_t;
+
+
+/**
+ * @brief get little endian value
+ * 
+ * @param data: data
+ * @param bytes: number of bytes
+ * @return uint32_t: value
+ */
+static inline uint32_t fdt_patch_get_le(const uint8_t *data, uint8_t bytes)
+{
+    uint32_t value = 0;
+
+    for(uint8_t i = bytes; i > 0; i--) {
+        value = value << 8 | data[i - 1];
+    }
+
+    return value;
+}
+
+
+/**
+ * @brief put varint at the end of blob
+ * 
+ * @param writer: writer
+ * @param value: value
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_writer_put_uint(fdt_writer_t *writer, uint32_t value)
+{
+    while(value >= 0x80) {
+        fdt_writer_put_le(writer, (value & 0x7f) | 0x80, 1);
+        value >>= 7;
+    }
+
+    return fdt_writer_put_le(writer, value, 1);
+}
+
+
+/**
+ * @brief append an entry to diffed blob
+ * 
+ * @param tree: diffed blob
+ * @param name: name
+ * @param value: raw value, NULL for node
+ * @param size: size of value
+ * @return int: index of entry, -1 if fail
+ */
+static int fdt_diff_push(fdt_diff_tree_t *tree, const char *name, const uint8_t *value, uint32_t size)
+{
+    if(tree->count == tree->cap) {
+        uint32_t cap = tree->cap ? tree->cap * 2 : 256;
+        fdt_diff_entry_t *entry = fdt_malloc(sizeof(fdt_diff_entry_t) * cap);
+        if(entry == NULL) {
+            FDT_LOG_ERROR("diff malloc failed\n");
+            return -1;
+        }
+
+        if(tree->entry) {
+            fdt_memcpy(entry, tree->entry, sizeof(fdt_diff_entry_t) * tree->count);
+            fdt_free(tree->entry);
+        }
+        tree->entry = entry;
+        tree->cap = cap;
+    }
+
+    tree->entry[tree->count].name = name;
+    tree->entry[tree->count].value = value;
+    tree->entry[tree->count].size = size;
+    return (int)tree->count ++;
+}
+
+
+/**
+ * @brief fdt_walk() callback, collect a node
+ * 
+ * @param ctx: diffed blob
+ * @param node: node
+ * @return int: FDT_WALK_CONTINUE, -1 if fail
+ */
+static int fdt_diff_begin_node(void *ctx, const fdt_walk_node_t *node)
+{
+    fdt_diff_tree_t *tree = ctx;
+    int index = fdt_diff_push(tree, node->name, NULL, 0);
+
+    if(index < 0) {
+        return -1;
+    }
+
+    tree->open[node->level] = (uint32_t)index;
+    return FDT_WALK_CONTINUE;
+}
+
+
+/**
+ * @brief fdt_walk() callback, collect a property
+ * 
+ * @param ctx: diffed blob
+ * @param prop: property
+ * @return int: FDT_WALK_CONTINUE, -1 if fail
+ */
+static int fdt_diff_prop(void *ctx, const fdt_walk_prop_t *prop)
+{
+    return fdt_diff_push(ctx, prop->name, prop->value, prop->size) < 0 ? -1 : FDT_WALK_CONTINUE;
+}
+
+
+/**
+ * @brief fdt_walk() callback, close a node
+ * 
+ * @param ctx: diffed blob
+ * @param level: level of node
+ * @return int: FDT_WALK_CONTINUE
+ */
+static int fdt_diff_end_node(void *ctx, uint8_t level)
+{
+    fdt_diff_tree_t *tree = ctx;
+
+    tree->entry[tree->open[level]].size = tree->count;
+    return FDT_WALK_CONTINUE;
+}
+
+
+/**
+ * @brief find entry by name among siblings
+ * 
+ * @param tree: diffed blob
+ * @param pos: first sibling
+ * @param end: index after the last sibling
+ * @param name: name
+ * @return bool: true if found
+ */
+static bool fdt_diff_find(const fdt_diff_tree_t *tree, uint32_t pos, uint32_t end, const char *name)
+{
+    while(pos < end) {
+        const fdt_diff_entry_t *entry = &tree->entry[pos];
+        if(fdt_strcmp(entry->name, name) == 0) {
+            return true;
+        }
+        pos = entry->value ? pos + 1 : entry->size;
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief check whether two properties have the same value
+ * 
+ * @param a: property
+ * @param b: property
+ * @return bool: true if the same
+ */
+static inline bool fdt_diff_value_equal(const fdt_diff_entry_t *a, const fdt_diff_entry_t *b)
+{
+    return a->size == b->size && fdt_memcmp(a->value, b->value, a->size) == 0;
+}
+
+
+/**
+ * @brief check whether two nodes have the same properties and descendants
+ * 
+ * @param diff: diff
+ * @param base: node of base blob
+ * @param target: node of target blob
+ * @return bool: true if the same
+ */
+static bool fdt_diff_node_equal(const fdt_diff_t *diff, uint32_t base, uint32_t target)
+{
+    uint32_t count = diff->base.entry[base].size - base;
+
+    if(diff->target.entry[target].size - target != count) {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < count; i++) {
+        const fdt_diff_entry_t *a = &diff->base.entry[base + i];
+        const fdt_diff_entry_t *b = &diff->target.entry[target + i];
+
+        if(fdt_strcmp(a->name, b->name) || (a->value == NULL) != (b->value == NULL)) {
+            return false;
+        }
+        if(a->value ? !fdt_diff_value_equal(a, b) : a->size - base != b->size - target) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief write pending count op
+ * 
+ * @param diff: diff
+ * @return none
+ */
+static void fdt_diff_flush(fdt_diff_t *diff)
+{
+    if(diff->count) {
+        fdt_writer_put_uint(&diff->patch, diff->op);
+        fdt_writer_put_uint(&diff->patch, diff->count);
+        diff->count = 0;
+    }
+}
+
+
+/**
+ * @brief add count op, it is merged with pending op of the same kind
+ * 
+ * @param diff: diff
+ * @param op: count op
+ * @param count: count
+ * @return none
+ */
+static void fdt_diff_pend(fdt_diff_t *diff, uint8_t op, uint32_t count)
+{
+    if(diff->count && diff->op != op) {
+        fdt_diff_flush(diff);
+    }
+
+    diff->op = op;
+    diff->count += count;
+}
+
+
+/**
+ * @brief write op, pending op is written before it
+ * 
+ * @param diff: diff
+ * @param op: op
+ * @return none
+ */
+static void fdt_diff_put(fdt_diff_t *diff, uint8_t op)
+{
+    fdt_diff_flush(diff);
+    fdt_writer_put_uint(&diff->patch, op);
+}
+
+
+/**
+ * @brief drop pending keep op, what is not covered by ops is kept anyway
+ * 
+ * @param diff: diff
+ * @return none
+ */
+static inline void fdt_diff_drop_keep(fdt_diff_t *diff)
+{
+    if(diff->op == FDT_PATCH_KEEP_PROP || diff->op == FDT_PATCH_KEEP_NODE) {
+        diff->count = 0;
+    }
+}
+
+
+/**
+ * @brief write raw value of property
+ * 
+ * @param diff: diff
+ * @param entry: property
+ * @return none
+ */
+static void fdt_diff_put_value(fdt_diff_t *diff, const fdt_diff_entry_t *entry)
+{
+    fdt_writer_put_uint(&diff->patch, entry->size);
+    fdt_writer_put(&diff->patch, entry->value, entry->size);
+}
+
+
+/**
+ * @brief write ops which turn node of base blob into node of target blob
+ * 
+ * @param diff: diff
+ * @param base: node of base blob, FDT_DIFF_NONE for a node being added
+ * @param target: node of target blob
+ * @return none
+ */
+static void fdt_diff_node(fdt_diff_t *diff, uint32_t base, uint32_t target)
+{
+    const fdt_diff_tree_t *a = &diff->base;
+    const fdt_diff_tree_t *b = &diff->target;
+    uint32_t i = 0, a_props = 0, a_end = 0;
+    uint32_t j = target + 1, b_props = target + 1, b_end = b->entry[target].size;
+
+    if(base != FDT_DIFF_NONE) {
+        i = a_props = base + 1;
+        a_end = a->entry[base].size;
+        while(a_props < a_end && a->entry[a_props].value) {
+            a_props ++;
+        }
+    }
+    while(b_props < b_end && b->entry[b_props].value) {
+        b_props ++;
+    }
+
+    // a property of base which is found later is dropped, the others are added
+    while(j < b_props) {
+        const fdt_diff_entry_t *entry = &b->entry[j];
+
+        if(i < a_props && fdt_strcmp(a->entry[i].name, entry->name) == 0) {
+            if(fdt_diff_value_equal(&a->entry[i], entry)) {
+                fdt_diff_pend(diff, FDT_PATCH_KEEP_PROP, 1);
+            }
+            else {
+                fdt_diff_put(diff, FDT_PATCH_SET_PROP);
+                fdt_diff_put_value(diff, entry);
+            }
+            i ++;
+            j ++;
+        }
+        else if(i < a_props && fdt_diff_find(a, i + 1, a_props, entry->name)) {
+            fdt_diff_pend(diff, FDT_PATCH_DROP_PROP, 1);
+            i ++;
+        }
+        else {
+            fdt_diff_put(diff, FDT_PATCH_ADD_PROP);
+            fdt_writer_put_string(&diff->patch, entry->name);
+            fdt_diff_put_value(diff, entry);
+            j ++;
+        }
+    }
+    if(i < a_props) {
+        fdt_diff_pend(diff, FDT_PATCH_DROP_PROP, a_props - i);
+    }
+    fdt_diff_drop_keep(diff);
+
+    // children are matched the same way
+    i = a_props;
+    while(j < b_end) {
+        const fdt_diff_entry_t *entry = &b->entry[j];
+
+        if(i < a_end && fdt_strcmp(a->entry[i].name, entry->name) == 0) {
+            if(fdt_diff_node_equal(diff, i, j)) {
+                fdt_diff_pend(diff, FDT_PATCH_KEEP_NODE, 1);
+            }
+            else {
+                fdt_diff_put(diff, FDT_PATCH_EDIT_NODE);
+                fdt_diff_node(diff, i, j);
+            }
+            i = a->entry[i].size;
+            j = entry->size;
+        }
+        else if(i < a_end && fdt_diff_find(a, a->entry[i].size, a_end, entry->name)) {
+            fdt_diff_pend(diff, FDT_PATCH_DROP_NODE, 1);
+            i = a->entry[i].size;
+        }
+        else {
+            fdt_diff_put(diff, FDT_PATCH_ADD_NODE);
+            fdt_writer_put_string(&diff->patch, entry->name);
+            fdt_diff_node(diff, FDT_DIFF_NONE, j);
+            j = entry->size;
+        }
+    }
+    while(i < a_end) {
+        fdt_diff_pend(diff, FDT_PATCH_DROP_NODE, 1);
+        i = a->entry[i].size;
+    }
+    fdt_diff_drop_keep(diff);
+    fdt_diff_put(diff, FDT_PATCH_END);
+}
+
+
+/**
+ * @brief build a patch which turns base blob into target blob
+ * 
+ * @param base: base blob
+ * @param base_size: base blob size
+ * @param target: target blob
+ * @param target_size: target blob size
+ * @param patch: output patch, free it with fdt_free()
+ * @param patch_size: output patch size
+ * @return int: 0: success, -1: fail
+ */
+int fdt_writer_build_patch(const void *base, uint32_t base_size, const void *target, uint32_t target_size,
+                           void **patch, uint32_t *patch_size)
+{
+    static const fdt_walk_ops_t ops = {
+        .begin_node = fdt_diff_begin_node,
+        .prop = fdt_diff_prop,
+        .end_node = fdt_diff_end_node,
+    };
+    const uint8_t *data = target;
+    fdt_diff_t diff;
+    int ret = -1;
+
+    fdt_memset(&diff, 0, sizeof(fdt_diff_t));
+    diff.patch.dynamic = true;
+
+    if(fdt_walk(base, base_size, &ops, &diff.base) || diff.base.count == 0 ||
+       fdt_walk(target, target_size, &ops, &diff.target) || diff.target.count == 0) {
+        FDT_LOG_ERROR("diff blob error\n");
+        goto out;
+    }
+
+    uint32_t magic = fdt_patch_get_le(data, 3);
+    fdt_writer_put_le(&diff.patch, FDT_PATCH_MAGIC, 3);
+    fdt_writer_put_le(&diff.patch, base_size, 4);
+    fdt_writer_put_le(&diff.patch, fdt_patch_hash(base, base_size), 4);
+    fdt_writer_put_le(&diff.patch, target_size, 4);
+    fdt_writer_put_le(&diff.patch, fdt_patch_hash(target, target_size), 4);
+    fdt_writer_put_le(&diff.patch, fdt_patch_get_le(data + 3, 3), 3);
+    fdt_writer_put_le(&diff.patch, magic == FDT_MAGIC_EXT ? data[6] : 0, 1);
+
+    fdt_diff_node(&diff, 0, 0);
+    if(diff.patch.error) {
+        goto out;
+    }
+
+    *patch = diff.patch.buf;
+    *patch_size = diff.patch.size;
+    diff.patch.buf = NULL;
+    ret = 0;
+
+out:
+    fdt_writer_release(&diff.patch);
+    if(diff.base.entry) {
+        fdt_free(diff.base.entry);
+    }
+    if(diff.target.entry) {
+        fdt_free(diff.target.entry);
+    }
+    return ret;
+}
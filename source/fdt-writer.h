@@ -0,0 +1,220 @@
+/*
+ * File Name: fdt-writer.h
+ *
+ * Copyright 2024-, lishanwen (1477153217@qq.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FDT_WRITER_H__
+#define __FDT_WRITER_H__
+
+#include "fdt.h"
+
+
+#define FDT_DTB_MAGIC               0xd00dfeed
+
+
+/**
+ * @brief fdt blob writer, it emits the same format as fdtc.
+ * @buf: blob buffer.
+ * @size: bytes written.
+ * @cap: buffer capacity.
+ * @dynamic: buffer is allocated by writer and grows on demand.
+ * @level: level of current node, root node is 0.
+ * @flags: FDT_FLAG_* format flags, 0 emits the plain fdtc format.
+ * @error: sticky error, set by the first failed call.
+ * @size_pos: position of subtree size fields of each open node, by level.
+ */
+typedef struct fdt_writer {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t cap;
+    bool dynamic;
+    uint8_t level;
+    uint8_t flags;
+    int error;
+    uint32_t size_pos[256];
+
+}fdt_writer_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Initialize writer and emit blob header and root node.
+ * @param writer: writer.
+ * @param buf: output buffer, if the value is NULL, writer allocates it with fdt_malloc.
+ * @param cap: output buffer size.
+ * @param version: blob version, year-month-day.
+ * @param flags: FDT_FLAG_* format flags, non-zero emits the FDT_MAGIC_EXT header.
+ * @return 0 if success, or -1.
+ */
+int fdt_writer_init(fdt_writer_t *writer, void *buf, uint32_t cap, uint32_t version, uint8_t flags);
+
+
+/**
+ * @brief Begin a child node of current node.
+ * @param writer: writer.
+ * @param name: node name.
+ * @return 0 if success, or -1.
+ */
+int fdt_writer_begin_node(fdt_writer_t *writer, const char *name);
+
+
+/**
+ * @brief End current node.
+ * @param writer: writer.
+ * @return 0 if success, or -1.
+ */
+int fdt_writer_end_node(fdt_writer_t *writer);
+
+
+/**
+ * @brief Add string property to current node.
+ * @param writer: writer.
+ * @param name: property name.
+ * @param value: string value.
+ * @return 0 if success, or -1.
+ */
+int fdt_writer_prop_string(fdt_writer_t *writer, const char *name, const char *value);
+
+
+/**
+ * @brief Add integer property to current node, it uses the fewest bytes.
+ * @param writer: writer.
+ * @param name: property name.
+ * @param value: integer value.
+ * @return 0 if success, or -1.
+ */
+int fdt_writer_prop_int(fdt_writer_t *writer, const char *name, uint64_t value);
+
+
+/**
+ * @brief Add array property to current node.
+ * @param writer: writer.
+ * @param name: property name.
+ * @param cells: array values.
+ * @param count: number of values, more than 255 makes a long array.
+ * @return 0 if success, or -1.
+ */
+int fdt_writer_prop_array(fdt_writer_t *writer, const char *name, const uint64_t *cells, uint32_t count);
+
+
+/**
+ * @brief Add bytes property to current node.
+ * @param writer: writer.
+ * @param name: property name.
+ * @param data: raw bytes.
+ * @param len: number of bytes.
+ * @return 0 if success, or -1.
+ */
+int fdt_writer_prop_bytes(fdt_writer_t *writer, const char *name, const void *data, uint32_t len);
+
+
+/**
+ * @brief Add reference property to current node, it is resolved at load.
+ * @param writer: writer.
+ * @param name: property name.
+ * @param paths: paths of referenced nodes, a label is given as its node path.
+ * @param count: number of references, at most 255.
+ * @return 0 if success, or -1.
+ */
+int fdt_writer_prop_ref(fdt_writer_t *writer, const char *name, const char *const *paths, uint32_t count);
+
+
+/**
+ * @brief Copy a loaded property to current node, the value is kept as is.
+ * @param writer: writer.
+ * @param prop: property.
+ * @return 0 if success, or -1.
+ */
+int fdt_writer_prop_copy(fdt_writer_t *writer, const fdt_prop_t *prop);
+
+
+/**
+ * @brief Import a standard flattened device tree (dtb version 16 or 17) produced by dtc.
+ * @param writer: writer, properties and children of the dtb root node are added to current node.
+ * @param dtb: standard dtb, it is big endian.
+ * @param dtb_size: dtb size.
+ * @return 0 if success, or -1.
+ * @note the type of a property is guessed from its value: one string is a string,
+ *       one cell is an int, several cells are an array, others are kept as bytes,
+ *       so a string list or an empty property reads with fdt_read_prop_bytes().
+ *       The memory reservation block is dropped.
+ */
+int fdt_writer_import_dtb(fdt_writer_t *writer, const void *dtb, uint32_t dtb_size);
+
+
+/**
+ * @brief Finish the blob, nodes still open are ended.
+ * @param writer: writer.
+ * @param blob: blob data, it is owned by writer.
+ * @param size: blob size.
+ * @return 0 if success, or -1 if any previous call failed.
+ */
+int fdt_writer_finish(fdt_writer_t *writer, const void **blob, uint32_t *size);
+
+
+/**
+ * @brief Release the buffer allocated by writer.
+ * @param writer: writer.
+ * @return none
+ */
+void fdt_writer_release(fdt_writer_t *writer);
+
+
+/**
+ * @brief Build perfect hash tables of a loaded tree, pass them to fdt_load_ex()
+ *        with the same blob. Ordinals follow the document order of the blob.
+ * @param root: root node.
+ * @param phash: output tables.
+ * @return 0 if success, or -1.
+ */
+int fdt_writer_build_phash(fdt_node_t *root, fdt_phash_t *phash);
+
+
+/**
+ * @brief Free perfect hash tables built by fdt_writer_build_phash().
+ * @param phash: tables.
+ * @return none
+ */
+void fdt_writer_free_phash(fdt_phash_t *phash);
+
+
+/**
+ * @brief Build a patch which turns base blob into target blob, for updates over slow links.
+ * @param base: base blob, as it is on the device.
+ * @param base_size: base blob size.
+ * @param target: target blob, it should be emitted by fdt_writer so that the
+ *        result of fdt_apply_patch() matches it byte for byte.
+ * @param target_size: target blob size.
+ * @param patch: output patch, free it with fdt_free().
+ * @param patch_size: output patch size.
+ * @return 0 if success, or -1.
+ * @note added, removed and changed properties and nodes are recorded, unchanged
+ *       ones cost a few bytes for each run of them.
+ */
+int fdt_writer_build_patch(const void *base, uint32_t base_size, const void *target, uint32_t target_size,
+                           void **patch, uint32_t *patch_size);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif // !__FDT_WRITER_H__
@@ -19,18 +19,6 @@
 #include "fdt.h"
 
 
-/**
- * fdt version, it is format of year-month-day
- */
-static uint64_t fdt_version = 0;
-
-
-/**
- * fdt consume memory size, it is bytes
- */
-static uint64_t fdt_consume = 0;
-
-
 /**
  * @brief inititialize a list.
  *
@@ -129,6 +117,23 @@ static inline void fdt_list_del_node(fdt_list_node_t *node)
 }
 
 
+/**
+ * @brief  Replace a node of the list by another node.
+ *
+ * @old: the node of the list.
+ * @node: the node put at its place.
+ * 
+ * @return none
+ */
+static inline void fdt_list_replace_node(fdt_list_node_t *old, fdt_list_node_t *node)
+{
+    node->prev = old->prev;
+    node->next = old->next;
+    old->prev->next = node;
+    old->next->prev = node;
+}
+
+
 /**
  * @brief Determine whether the list is empty.
  *
@@ -169,25 +174,262 @@ static inline fdt_list_node_t* fdt_list_prev_node(fdt_list_node_t *node)
 
 
 /**
- * fdt root node instance
- * name: '/'
+ * @brief property of reference type, it is allocated in place of fdt_prop_t.
+ * @prop: property.
+ * @next: next reference property of tree, they are resolved after load.
+ * @count: number of references.
+ * @target: referenced nodes, NULL until resolved.
+ */
+typedef struct fdt_ref_prop {
+    fdt_prop_t prop;
+    struct fdt_ref_prop *next;
+    uint32_t count;
+    fdt_node_t *target[];
+
+}fdt_ref_prop_t;
+
+
+/**
+ * @brief arena block, nodes and properties are carved from data following it.
+ * @next: next block.
+ * @used: bytes used in data.
+ * @size: bytes of data.
+ */
+typedef struct fdt_arena {
+    struct fdt_arena *next;
+    uint32_t used;
+    uint32_t size;
+
+}fdt_arena_t;
+
+
+/**
+ * @brief alias of /aliases node.
+ * @name: alias name, it is the property name.
+ * @path: node path, it is the property value.
+ * @hash: hash of alias name.
+ * @name_len: length of alias name.
+ * @node: aliased node, NULL until it is resolved in a lazy tree.
+ */
+typedef struct fdt_alias {
+    const char *name;
+    const char *path;
+    uint16_t hash;
+    uint16_t name_len;
+    fdt_node_t *node;
+
+}fdt_alias_t;
+
+
+/**
+ * @brief memory types of tree, for fdt_get_mem_stats().
+ */
+typedef enum fdt_mem_type {
+    FDT_MEM_NODE,
+    FDT_MEM_PROP,
+    FDT_MEM_INDEX,
+    FDT_MEM_TABLE,
+    FDT_MEM_TYPE_MAX,
+
+}fdt_mem_type_t;
+
+
+/**
+ * @brief fdt tree instance.
+ * @root: root node, name: '/'.
+ * @version: fdt version, it is format of year-month-day.
+ * @consume: fdt consume memory size, it is bytes.
+ * @mem: bytes of each fdt_mem_type_t, arena slack is consume minus their sum.
+ * @phash: perfect hash table of blob, NULL if not used.
+ * @phash_nodes: nodes in document order, indexed by phash ordinal.
+ * @phash_props: properties in document order, indexed by phash ordinal.
+ * @node_count: number of nodes created by loader.
+ * @prop_count: number of properties created by loader.
+ * @blob: dtb file of lazy tree, NULL if the tree is loaded at once.
+ * @blob_size: dtb file size of lazy tree.
+ * @flags: format flags of dtb file.
+ * @expand_lock: serializes fdt_node_expand() of lazy tree.
+ * @arena: arena blocks of tree built by fdt_load_parallel(), NULL if nodes
+ *         and properties are allocated one by one.
+ * @refs: reference properties created by loader and not resolved yet.
+ * @aliases: open addressing hash table of properties of /aliases, NULL if none.
+ * @alias_mask: size of alias table minus one, the size is a power of two.
+ */
+typedef struct fdt_tree {
+    fdt_node_t root;
+    uint64_t version;
+    uint64_t consume;
+    uint64_t mem[FDT_MEM_TYPE_MAX];
+    const fdt_phash_t *phash;
+    fdt_node_t **phash_nodes;
+    fdt_prop_t **phash_props;
+    uint32_t node_count;
+    uint32_t prop_count;
+    const uint8_t *blob;
+    uint64_t blob_size;
+    uint8_t flags;
+    uint32_t expand_lock;
+    fdt_arena_t *arena;
+    fdt_ref_prop_t *refs;
+    fdt_alias_t *aliases;
+    uint32_t alias_mask;
+
+}fdt_tree_t;
+
+
+#define FDT_TREE_INIT(tree) { \
+    .root = { \
+        .name = "/", \
+        .parent = &(tree).root, \
+        .child = {.prev = &(tree).root.child, .next = &(tree).root.child}, \
+        .prop = {.prev = &(tree).root.prop, .next = &(tree).root.prop}, \
+    }, \
+}
+
+
+/**
+ * fdt tree instances, one is published to readers and the other is
+ * used to build the next tree by fdt_load(), then they are swapped.
+ */
+static fdt_tree_t fdt_trees[2] = {
+    FDT_TREE_INIT(fdt_trees[0]),
+    FDT_TREE_INIT(fdt_trees[1]),
+};
+
+
+/**
+ * published tree, readers always go through this pointer
+ */
+static fdt_tree_t *fdt_tree = &fdt_trees[0];
+
+
+/**
+ * reader epoch and number of readers entered in each epoch parity
+ */
+static uint32_t fdt_epoch = 0;
+static uint32_t fdt_readers[2] = {0};
+
+
+/**
+ * set while fdt_load() or fdt_unload() is running
+ */
+static uint32_t fdt_loading = 0;
+
+
+/**
+ * bytes a tree may consume, 0 is unlimited, see fdt_set_mem_budget()
+ */
+static uint64_t fdt_mem_budget = 0;
+
+
+/**
+ * bytes held by both tree instances and the high-water mark of it
+ */
+static size_t fdt_mem_held = 0;
+static size_t fdt_mem_peak = 0;
+
+
+/**
+ * @brief default allocator backend
+ * 
+ * @param ctx: unused
+ * @param size: bytes
+ * @return void*: memory, NULL if fail
+ */
+static void* fdt_default_alloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    return fdt_malloc(size);
+}
+
+
+/**
+ * @brief default allocator backend
+ * 
+ * @param ctx: unused
+ * @param ptr: memory
+ * @return none
+ */
+static void fdt_default_free(void *ctx, void *ptr)
+{
+    (void)ctx;
+    fdt_free(ptr);
+}
+
+
+/**
+ * allocator of nodes, properties and tables, see fdt_set_allocator()
  */
-struct fdt_node fdt_root = {
-    .name = "/",
-    .parent = &fdt_root,
+static fdt_allocator_t fdt_allocator = {
+    .alloc = fdt_default_alloc,
+    .free = fdt_default_free,
+    .ctx = NULL,
 };
 
 
+/**
+ * @brief allocate memory with current allocator
+ * 
+ * @param size: bytes
+ * @return void*: memory, NULL if fail
+ */
+static inline void* fdt_mem_alloc(size_t size)
+{
+    return fdt_allocator.alloc(fdt_allocator.ctx, size);
+}
+
+
+/**
+ * @brief free memory with current allocator
+ * 
+ * @param ptr: memory
+ * @return none
+ */
+static inline void fdt_mem_free(void *ptr)
+{
+    fdt_allocator.free(fdt_allocator.ctx, ptr);
+}
+
+
 /**
  * @brief init root node
  * 
- * @param none
+ * @param tree: tree
  * @return none
  */
-static void fdt_root_init(void)
+static void fdt_root_init(fdt_tree_t *tree)
+{
+    fdt_list_init(&tree->root.child);
+    fdt_list_init(&tree->root.prop);
+    tree->root.parent = &tree->root;
+    tree->version = 0;
+    tree->consume = 0;
+    fdt_memset(tree->mem, 0, sizeof(tree->mem));
+    tree->phash = NULL;
+    tree->phash_nodes = NULL;
+    tree->phash_props = NULL;
+    tree->node_count = 0;
+    tree->prop_count = 0;
+    tree->root.lazy = NULL;
+    tree->blob = NULL;
+    tree->blob_size = 0;
+    tree->flags = 0;
+    tree->arena = NULL;
+    tree->refs = NULL;
+    tree->aliases = NULL;
+    tree->alias_mask = 0;
+}
+
+
+/**
+ * @brief get published tree
+ * 
+ * @param none
+ * @return fdt_tree_t*: tree
+ */
+static inline fdt_tree_t* fdt_get_tree(void)
 {
-    fdt_list_init(&fdt_root.child);
-    fdt_list_init(&fdt_root.prop);
+    return fdt_atomic_load(&fdt_tree);
 }
 
 
@@ -199,7 +441,7 @@ static void fdt_root_init(void)
  */
 fdt_node_t* fdt_get_root_node(void)
 {
-    return &fdt_root;
+    return &fdt_get_tree()->root;
 }
 
 
@@ -211,760 +453,5400 @@ fdt_node_t* fdt_get_root_node(void)
  */
 uint64_t fdt_get_version(void)
 {
-    return fdt_version;
+    return fdt_get_tree()->version;
 }
 
 
 /**
- * @brief check whether the node have child node
+ * @brief enter a read-side critical section
  * 
- * @param node: node
- * @return bool: true or false, have child node return true
+ * @param none
+ * @return int: epoch token, pass it to fdt_read_end()
  */
-static bool fdt_node_have_child(fdt_node_t *node)
+int fdt_read_begin(void)
 {
-    return !fdt_list_is_empty(&node->child);
+    uint32_t epoch = fdt_atomic_load(&fdt_epoch) & 1;
+
+    fdt_atomic_add(&fdt_readers[epoch], 1);
+    return (int)epoch;
 }
 
 
 /**
- * @brief find node by name
+ * @brief leave a read-side critical section
  * 
- * @param parent: node parent, it should not be NULL
- * @param name: node name
- * @return fdt_node_t*: node
+ * @param epoch: token returned by fdt_read_begin()
+ * @return none
  */
-static fdt_node_t* find_node_by_name(fdt_node_t *parent, const char *name)
+void fdt_read_end(int epoch)
 {
-    fdt_node_t *child = NULL;
-    if(parent == NULL) {
-        return NULL;
-    }
+    fdt_atomic_sub(&fdt_readers[epoch & 1], 1);
+}
 
-    fdt_list_for_each_entry(child, &parent->child, fdt_node_t, entry) {
-        if(child == NULL) {
-            continue;
-        }
 
-        if(fdt_strcmp(child->name, name) == 0) {
-            return child;
+/**
+ * @brief wait until every reader which may see the previous tree has left
+ * 
+ * @param none
+ * @return none
+ * @note the epoch is flipped twice, so a reader which sampled the epoch
+ *       before the tree was published is waited for as well.
+ */
+static void fdt_synchronize(void)
+{
+    for(int i = 0; i < 2; i++) {
+        uint32_t epoch = fdt_atomic_add(&fdt_epoch, 1) - 1;
+
+        while(fdt_atomic_load(&fdt_readers[epoch & 1]) != 0) {
+            fdt_cpu_relax();
         }
     }
-
-    return NULL;
 }
 
 
 /**
- * @brief recursion find node by name
+ * @brief check whether the node have child node
+ * 
  * @param node: node
- * @param name: node name
- * @return fdt_node_t*: node, NULL: not find
+ * @return bool: true or false, have child node return true
  */
-static inline fdt_node_t* __fdt_find_node_by_name(fdt_node_t *node, const char *name) 
+static bool fdt_node_have_child(fdt_node_t *node)
 {
-    if(fdt_strcmp(node->name, name) == 0) {
-        return node;
-    }
-
-    if(fdt_node_have_child(node)) {
-        fdt_node_t *child = NULL;
-        fdt_list_for_each_entry(child, &node->child, fdt_node_t, entry) {
-            if(child == NULL) {
-                continue;
-            }
-
-            if(__fdt_find_node_by_name(child, name)) {
-                return child;
-            }
-        }
-    }
-
-    return NULL;
+    return !fdt_list_is_empty(&node->child);
 }
 
 
 /**
- * @brief find node by name
+ * @brief create properties and children of lazy node if they are not yet
  * 
- * @param parent: parent node, if the value is NULL, meaning find node from root node
- * @param name: node name
- * @return fdt_node_t*: node
+ * @param node: node
+ * @return int: 0: success, -1: fail
  */
-fdt_node_t* fdt_find_node_by_name(fdt_node_t *parent, const char *name)
+static inline int fdt_node_materialize(fdt_node_t *node)
 {
-    fdt_node_t *child = NULL;
-    if(parent == NULL) {
-        parent = &fdt_root;
-    }
+    return fdt_atomic_load(&node->lazy) ? fdt_node_expand(node) : 0;
+}
 
-    fdt_list_for_each_entry(child, &parent->child, fdt_node_t, entry) {
-        fdt_node_t *find = __fdt_find_node_by_name(child, name);
-        if(find) {
-            return find;
-        }
-    }
 
-    return NULL;
-}
+#ifndef fdt_crc32_hw
+/**
+ * slice-by-8 tables of CRC-32, they are built on first use
+ */
+static uint32_t fdt_crc32_table[8][256];
+static uint32_t fdt_crc32_state = 0;
 
 
 /**
- * @brief find node by path
+ * @brief build slice-by-8 tables once, a concurrent caller waits for them
  * 
- * @param path: node path
- * @return fdt_node_t*: node
+ * @param none
+ * @return none
  */
-fdt_node_t* fdt_find_node_by_path(const char *path)
+static void fdt_crc32_init(void)
 {
-    char node_name[512] = {0};
-    int i = 0;
-    fdt_node_t* parent = &fdt_root;
-    fdt_node_t* node = NULL;
+    uint32_t state = 0;
 
-    while(*path) {
-        if(*path == ' ') {
-            path ++;
-            continue;
-        }
-        else if(*path == '/' && i > 0) {
-            node_name[i] = 0; i = 0;
+    if(fdt_atomic_load(&fdt_crc32_state) == 2) {
+        return;
+    }
 
-            node = find_node_by_name(parent, node_name);
-            if(node == NULL) {
-                return NULL;
-            }
-            
-            parent = node;
-        }
-        else if(*path != '/'){
-            node_name[i++] = *path;
+    if(!fdt_atomic_cas(&fdt_crc32_state, &state, 1)) {
+        while(fdt_atomic_load(&fdt_crc32_state) != 2) {
+            fdt_cpu_relax();
         }
+        return;
+    }
 
-        path ++;
+    for(uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for(int k = 0; k < 8; k++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+        }
+        fdt_crc32_table[0][i] = crc;
     }
 
-    if(i) {
-        node_name[i] = 0;
-        return find_node_by_name(parent, node_name);
+    for(uint32_t i = 0; i < 256; i++) {
+        for(int slice = 1; slice < 8; slice++) {
+            uint32_t crc = fdt_crc32_table[slice - 1][i];
+            fdt_crc32_table[slice][i] = (crc >> 8) ^ fdt_crc32_table[0][crc & 0xff];
+        }
     }
 
-    return node;
+    fdt_atomic_store(&fdt_crc32_state, 2);
 }
+#endif
 
 
 /**
- * @brief find property by name
+ * @brief CRC-32 of IEEE 802.3, 8 bytes are folded at a time
  * 
- * @param node: node
- * @param name: property name
- * @return fdt_prop_t*: property
+ * @param crc: crc of previous data, 0 for the first
+ * @param data: data
+ * @param len: length of data
+ * @return uint32_t: crc
  */
-fdt_prop_t* fdt_find_prop_by_name(fdt_node_t *node, const char *name)
+uint32_t fdt_crc32(uint32_t crc, const void *data, size_t len)
 {
-    fdt_prop_t *child = NULL;
-
-    fdt_list_for_each_entry(child, &node->prop, fdt_prop_t, node) {
-        if(child == NULL) {
-            continue;
-        }
+#ifdef fdt_crc32_hw
+    return fdt_crc32_hw(crc, data, len);
+#else
+    const uint32_t (*table)[256] = fdt_crc32_table;
+    const uint8_t *pos = data;
+
+    fdt_crc32_init();
+    crc = ~crc;
+
+    for(; len >= 8; len -= 8, pos += 8) {
+        uint32_t low = crc ^ ((uint32_t)pos[0] | (uint32_t)pos[1] << 8 | (uint32_t)pos[2] << 16 | (uint32_t)pos[3] << 24);
+        uint32_t high = (uint32_t)pos[4] | (uint32_t)pos[5] << 8 | (uint32_t)pos[6] << 16 | (uint32_t)pos[7] << 24;
+
+        crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^
+              table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+              table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff] ^
+              table[1][(high >> 16) & 0xff] ^ table[0][high >> 24];
+    }
 
-        if(fdt_strcmp(child->name, name) == 0) {
-            return child;
-        }
+    for(; len > 0; len--, pos++) {
+        crc = table[0][(crc ^ *pos) & 0xff] ^ (crc >> 8);
     }
 
-    return NULL;
+    return ~crc;
+#endif
 }
 
 
 /**
- * @brief find property by path
- *
- * @param path: the path of property
- * @return fdt_prop_t*: property
+ * @brief FNV-1a hash of name, folded to 16 bits
+ * 
+ * @param name: name
+ * @param len: length of name
+ * @return uint16_t: hash
  */
-fdt_prop_t* fdt_find_prop_by_path(const char *path)
+uint16_t fdt_hash_name(const char *name, uint32_t len)
 {
-    fdt_node_t* node = NULL;
-    char node_path[512] = {0};
-    fdt_memcpy(node_path, path, fdt_strlen(path));
-
-    char *p = (char*)&node_path[fdt_strlen(node_path) - 1];
-    char *prop_name = NULL;
-
-    while(*p != '/' && *p) {
-        p --;
-    }
-
-    *p = 0;
-    prop_name = (p + 1);
+    uint32_t hash = 2166136261u;
 
-    node = fdt_find_node_by_path(node_path);
-    if(node == NULL) {
-        return NULL;
+    for(uint32_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
     }
 
-    return fdt_find_prop_by_name(node, prop_name);
+    return (uint16_t)((hash >> 16) ^ hash);
 }
 
 
 /**
- * @brief read string property
+ * @brief FNV-1a hash of blob, it identifies base and result of patch
  * 
- * @param node: node
- * @param name: property name
- * @return const char*: property value
+ * @param data: blob
+ * @param size: blob size
+ * @return uint32_t: hash
  */
-const char* fdt_read_prop_string(fdt_node_t *node, const char *name)
+uint32_t fdt_patch_hash(const void *data, uint32_t size)
 {
-    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
-    if(prop == NULL) {
-        return NULL;
+    const uint8_t *bytes = data;
+    uint32_t hash = 2166136261u;
+
+    for(uint32_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
     }
 
-    char *str = (char*)prop->offset;
-    return (str+1);
+    return hash;
 }
 
 
 /**
- * @brief read int property
+ * @brief hash of a string terminated by zero
  * 
- * @param node: node
- * @param name: property name
- * @param value: property value
- * @return int: 0: success, -1: fail
+ * @param name: name
+ * @param len: output length of name
+ * @return uint16_t: hash, same as fdt_hash_name()
  */
-int fdt_read_prop_int(fdt_node_t *node, const char *name, size_t *value)
+static uint16_t fdt_hash_string(const char *name, uint32_t *len)
 {
-    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
-    if(prop == NULL) {
-        return -1;
-    }
+    uint32_t hash = 2166136261u;
+    uint32_t i = 0;
 
-    uint8_t *len = (uint8_t*)prop->offset;
-    uint8_t pos = *len;
-    size_t  ret = 0;
-
-    if(pos > FDT_PROP_STRING && pos < FDT_PROP_ARRAY) {
-        for(int i = *len; i > 0; i--) {
-            ret = (ret << 8  | (*(len + i)));
-        }
-        *value = ret;
-        return 0;
-    }
-    else if(pos > FDT_PROP_ARRAY) {
-        *value = 0;
-        fdt_memcpy(value, len + 2, *len - 32);
-        return 0;
+    for(; name[i]; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
     }
 
-    return -1;
+    *len = i;
+    return (uint16_t)((hash >> 16) ^ hash);
 }
 
 
 /**
- * @brief read int property
+ * @brief hash of a path segment, spaces in it are ignored
  * 
- * @param node: node
- * @param name: property name
- * @param value: property value
- * @return int: 0: success, -1: fail
+ * @param seg: path segment
+ * @param len: length of path segment
+ * @param name_len: output length of name without spaces
+ * @return uint16_t: hash, same as fdt_hash_name()
  */
-int fdt_read_prop_int_index(fdt_node_t *node, const char *name, uint8_t index, size_t *value)
+static uint16_t fdt_hash_segment(const char *seg, size_t len, uint32_t *name_len)
 {
-    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
-    if(prop == NULL) {
-        return -1;
-    }
-
-    uint8_t *len = (uint8_t*)prop->offset;
-    uint8_t pos = *len;
-    size_t  ret = 0;
+    uint32_t hash = 2166136261u;
+    uint32_t n = 0;
 
-    if(pos > FDT_PROP_STRING && pos < FDT_PROP_ARRAY) {
-        if(index > 0) {
-            return -1;
+    for(size_t i = 0; i < len; i++) {
+        if(seg[i] == ' ') {
+            continue;
         }
 
-        for(int i = *len; i > 0; i--) {
-            ret = (ret << 8  | (*(len + i)));
-        }
-        *value = ret;
-        return 0;
+        hash = (hash ^ (uint8_t)seg[i]) * 16777619u;
+        n ++;
     }
-    else if(pos > FDT_PROP_ARRAY) {
-        uint8_t cell_size = *len - 32;
-        len ++;
-        uint8_t cell_max = *len;
 
-        if(index >= cell_max) {
-            return -1;
-        }
+    *name_len = n;
+    return (uint16_t)((hash >> 16) ^ hash);
+}
 
-        *value = 0;
-        uint8_t *offset = (len + index * cell_size + 1);
-        fdt_memcpy(value, offset, cell_size);
-        return 0;
-    }
 
-    return -1;
-}
+/**
+ * @brief sorted index of a node, entries are sorted by name hash and length,
+ *        entries with the same key keep document order.
+ * @children: children of node, NULL if node has few children.
+ * @props: properties of node, NULL if node has few properties.
+ * @child_count: number of entries in children.
+ * @prop_count: number of entries in props.
+ */
+typedef struct fdt_index {
+    void **children;
+    void **props;
+    uint32_t child_count;
+    uint32_t prop_count;
+
+}fdt_index_t;
 
 
 /**
- * @brief read string property by node path
+ * @brief get sort key of node or property
  * 
- * @param node_path: node path
- * @param name: property name
- * @return const char*: property value
+ * @param entry: node or property
+ * @param hash_offset: offset of hash member, it is followed by name_len
+ * @return uint32_t: sort key
  */
-const char* fdt_read_prop_string_by_path(const char *node_path, const char *name)
+static inline uint32_t fdt_index_key(const void *entry, size_t hash_offset)
 {
-    fdt_node_t* node = fdt_find_node_by_path(node_path);
-    if(node == NULL) {
-        return NULL;
-    }
+    const uint16_t *key = (const uint16_t*)((const char*)entry + hash_offset);
 
-    return fdt_read_prop_string(node, name);
+    return ((uint32_t)key[0] << 16) | key[1];
 }
 
 
 /**
- * @brief read int property by node path
+ * @brief find the first entry whose key is not less than key
  * 
- * @param node_path: node path
- * @param name: property name
- * @param value: property value
- * @return int: 0: success, -1: fail
+ * @param entries: sorted entries
+ * @param count: number of entries
+ * @param key: sort key
+ * @param hash_offset: offset of hash member
+ * @return uint32_t: position of entry, count if not found
  */
-int fdt_read_prop_int_by_path(const char *node_path, const char *name, size_t *value)
+static uint32_t fdt_index_lower_bound(void *const *entries, uint32_t count, uint32_t key, size_t hash_offset)
 {
-    fdt_node_t* node = fdt_find_node_by_path(node_path);
-    if(node == NULL) {
-        return -1;
+    uint32_t low = 0;
+    uint32_t high = count;
+
+    while(low < high) {
+        uint32_t mid = low + (high - low) / 2;
+
+        if(fdt_index_key(entries[mid], hash_offset) < key) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
     }
 
-    return fdt_read_prop_int(node, name, value);
+    return low;
 }
 
 
 /**
- * @brief read int property by node path
+ * @brief compare node name with a path segment
  * 
- * @param node_path: node path
- * @param name: property name
- * @param value: property value
- * @return int: 0: success, -1: fail
+ * @param name: node name
+ * @param seg: path segment, it is not terminated by zero
+ * @param len: length of path segment
+ * @return bool: true if equal, spaces in path segment are ignored
  */
-int fdt_read_prop_int_index_by_path(const char *node_path, const char *name, uint8_t index, size_t *value)
+static bool fdt_name_equal_segment(const char *name, const char *seg, size_t len)
 {
-    fdt_node_t* node = fdt_find_node_by_path(node_path);
-    if(node == NULL) {
-        return -1;
+    for(size_t i = 0; i < len; i++) {
+        if(seg[i] == ' ') {
+            continue;
+        }
+
+        if(*name != seg[i]) {
+            return false;
+        }
+        name ++;
     }
 
-    return fdt_read_prop_int_index(node, name, index, value);
+    return *name == 0;
 }
 
 
 /**
- * @brief get int property size
- * @param node: node
- * @param name: property name
- * @return int: property size, -1: fail
+ * @brief find child node by path segment
+ * 
+ * @param parent: node parent, it should not be NULL
+ * @param seg: path segment, it is not terminated by zero
+ * @param len: length of path segment
+ * @return fdt_node_t*: node
  */
-int fdt_get_prop_int_size(fdt_node_t *node, const char *name)
+static fdt_node_t* find_node_by_segment(fdt_node_t *parent, const char *seg, size_t len)
 {
-    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
-    if(prop == NULL) {
-        return -1;
+    fdt_node_t *child = NULL;
+    uint32_t name_len = 0;
+    uint16_t hash = 0;
+
+    if(parent == NULL || fdt_node_materialize(parent)) {
+        return NULL;
     }
 
-    uint8_t *pos = (uint8_t*)prop->offset;
-    if(*pos > FDT_PROP_STRING && *pos < FDT_PROP_ARRAY) {
-        return 1;
+    hash = fdt_hash_segment(seg, len, &name_len);
+
+    if(parent->index && parent->index->children) {
+        fdt_index_t *index = parent->index;
+        uint32_t key = ((uint32_t)hash << 16) | name_len;
+        uint32_t i = fdt_index_lower_bound(index->children, index->child_count, key, fdt_offsetof(fdt_node_t, hash));
+
+        for(; i < index->child_count; i++) {
+            child = (fdt_node_t*)index->children[i];
+            if(child->hash != hash || child->name_len != name_len) {
+                break;
+            }
+
+            if(fdt_name_equal_segment(child->name, seg, len)) {
+                return child;
+            }
+        }
+
+        return NULL;
     }
-    else if(*pos > FDT_PROP_ARRAY) {
-        return *(pos + 1);
+
+    fdt_list_for_each_entry(child, &parent->child, fdt_node_t, entry) {
+        if(child == NULL) {
+            continue;
+        }
+
+        if(child->hash != hash || child->name_len != name_len) {
+            continue;
+        }
+
+        if(fdt_name_equal_segment(child->name, seg, len)) {
+            return child;
+        }
     }
 
-    return -1;
+    return NULL;
 }
 
 
 /**
- * @brief get int property size by path
- * @param node_path: node path
- * @param name: property name
- * @return int: property size, -1: fail
+ * @brief walk path from node, segments are compared in place
+ * 
+ * @param node: start node
+ * @param path: node path
+ * @param len: max length of path, it also stops at the terminating zero
+ * @return fdt_node_t*: node, start node if path has no segment
  */
-int fdt_get_prop_int_size_by_path(const char *node_path, const char *name)
+static fdt_node_t* __fdt_find_node_by_path(fdt_node_t *node, const char *path, size_t len)
 {
-    fdt_node_t* node = fdt_find_node_by_path(node_path);
-    if(node == NULL) {
-        return -1;
+    size_t pos = 0;
+
+    while(pos < len && path[pos]) {
+        if(path[pos] == '/' || path[pos] == ' ') {
+            pos ++;
+            continue;
+        }
+
+        size_t seg = pos;
+        while(pos < len && path[pos] && path[pos] != '/') {
+            pos ++;
+        }
+
+        node = find_node_by_segment(node, path + seg, pos - seg);
+        if(node == NULL) {
+            return NULL;
+        }
     }
 
-    return fdt_get_prop_int_size(node, name);
+    return node;
 }
 
 
 /**
- * @brief get property type
+ * @brief recursion find node by name
  * @param node: node
- * @param name: property name
- * @return fdt_prop_type_t: property type, -1 if node not found
+ * @param name: node name
+ * @param len: length of node name
+ * @param hash: hash of node name
+ * @return fdt_node_t*: node, NULL: not find
  */
-fdt_prop_type_t fdt_get_prop_type(fdt_node_t *node, const char *name)
+static inline fdt_node_t* __fdt_find_node_by_name(fdt_node_t *node, const char *name, uint32_t len, uint16_t hash) 
 {
-    fdt_prop_type_t type = FDT_PROP_INVALID;
+    if(node->hash == hash && node->name_len == len && fdt_memcmp(node->name, name, len) == 0) {
+        return node;
+    }
 
-    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
-    if(prop == NULL) {
-        return -1;
+    if(fdt_node_materialize(node)) {
+        return NULL;
     }
 
-    uint8_t pos = *(uint8_t*)(prop->offset);
+    if(fdt_node_have_child(node)) {
+        fdt_node_t *child = NULL;
+        fdt_list_for_each_entry(child, &node->child, fdt_node_t, entry) {
+            if(child == NULL) {
+                continue;
+            }
 
-    if(pos == FDT_PROP_STRING) {
-        type = FDT_PROP_STRING;
-    }
-    else if(pos > FDT_PROP_STRING && pos < FDT_PROP_ARRAY) {
-        type = FDT_PROP_INT;
-    }
-    else if(pos > FDT_PROP_ARRAY) {
-        type = FDT_PROP_ARRAY;
+            fdt_node_t *find = __fdt_find_node_by_name(child, name, len, hash);
+            if(find) {
+                return find;
+            }
+        }
     }
 
-    return type;
+    return NULL;
 }
 
 
 /**
- * @brief get property type by node path
- * @param node_path: node path
- * @param name: property name
- * @return fdt_prop_type_t: property type, -1 if node not found
+ * @brief find node by name
+ * 
+ * @param parent: parent node, if the value is NULL, meaning find node from root node
+ * @param name: node name
+ * @return fdt_node_t*: node
  */
-fdt_prop_type_t fdt_get_prop_type_by_path(const char *node_path, const char *name)
+fdt_node_t* fdt_find_node_by_name(fdt_node_t *parent, const char *name)
 {
-    fdt_node_t* node = fdt_find_node_by_path(node_path);
-    if(node == NULL) {
-        return -1;
+    fdt_node_t *child = NULL;
+    uint32_t len = 0;
+    uint16_t hash = fdt_hash_string(name, &len);
+
+    if(parent == NULL) {
+        parent = fdt_get_root_node();
     }
 
-    return fdt_get_prop_type(node, name);
+    if(fdt_node_materialize(parent)) {
+        return NULL;
+    }
+
+    fdt_list_for_each_entry(child, &parent->child, fdt_node_t, entry) {
+        fdt_node_t *find = __fdt_find_node_by_name(child, name, len, hash);
+        if(find) {
+            return find;
+        }
+    }
+
+    return NULL;
 }
 
 
 /**
- * @brief create a property
+ * @brief one step of 64-bit FNV-1a hash
  * 
- * @param name: property name
- * @param value: data value
- * @return fdt_prop_t*: property
+ * @param hash: hash
+ * @param c: input byte
+ * @return uint64_t: hash
  */
-static fdt_prop_t* fdt_prop_create(const char *name, const void *value)
+static inline uint64_t fdt_hash64_step(uint64_t hash, uint8_t c)
 {
-    fdt_prop_t *prop = fdt_malloc(sizeof(fdt_prop_t));
-    if(prop == NULL) {
-        return NULL;
-    }
-
-    prop->name = name;
-    prop->offset = value;
-
-    fdt_consume += sizeof(fdt_prop_t);
-
-    return prop;
+    return (hash ^ c) * 1099511628211ull;
 }
 
 
 /**
- * @brief create a node
+ * @brief hash of normalized node path, it is the hash of "/seg1/seg2"
+ *        with spaces removed and empty segments skipped
  * 
- * @param name: node name
- * @return fdt_node_t*: node
+ * @param path: node path
+ * @param len: max length of path, it also stops at the terminating zero
+ * @param end: output length of path which is hashed
+ * @param segments: output number of segments
+ * @return uint64_t: hash
  */
-static fdt_node_t* fdt_node_create(const char *name)
+static uint64_t __fdt_hash_path(const char *path, size_t len, size_t *end, uint32_t *segments)
 {
-    fdt_node_t *node = fdt_malloc(sizeof(fdt_node_t));
-    if(node == NULL) {
-        return NULL;
-    }
-
-    node->name = name;
-    node->parent = NULL;
+    uint64_t hash = 14695981039346656037ull;
+    size_t pos = 0;
+    uint32_t count = 0;
 
-    fdt_list_init(&node->prop);
-    fdt_list_init(&node->child);
+    while(pos < len && path[pos]) {
+        if(path[pos] == '/' || path[pos] == ' ') {
+            pos ++;
+            continue;
+        }
 
-    fdt_consume += sizeof(fdt_node_t);
+        hash = fdt_hash64_step(hash, '/');
+        count ++;
+        while(pos < len && path[pos] && path[pos] != '/') {
+            if(path[pos] != ' ') {
+                hash = fdt_hash64_step(hash, path[pos]);
+            }
+            pos ++;
+        }
+    }
 
-    return node;
+    *end = pos;
+    *segments = count;
+    return hash;
 }
 
 
 /**
- * @brief add property to node
+ * @brief hash of node path
  * 
- * @param node: node
- * @param prop: property
- * @return none
+ * @param path: node path
+ * @return uint64_t: hash
  */
-static void fdt_node_append_prop(fdt_node_t *node, fdt_prop_t *prop)
+uint64_t fdt_hash_path(const char *path)
 {
-    fdt_list_add_node_at_tail(&node->prop, &prop->node);
+    size_t end = 0;
+    uint32_t segments = 0;
+
+    return __fdt_hash_path(path, (size_t)-1, &end, &segments);
 }
 
 
 /**
- * @brief add child node to node
+ * @brief hash of property path
  * 
- * @param node: node
- * @param child: child node
- * @return none
+ * @param path: property path
+ * @return uint64_t: hash
  */
-static void fdt_node_add_child(fdt_node_t *node, fdt_node_t *child)
+uint64_t fdt_hash_prop_path(const char *path)
 {
-    child->parent = node;
-    fdt_list_add_node_at_tail(&node->child, &child->entry);
+    const char *prop_name = path;
+    size_t end = 0;
+    uint32_t segments = 0;
+
+    for(const char *p = path; *p; p++) {
+        if(*p == '/') {
+            prop_name = p + 1;
+        }
+    }
+
+    uint64_t hash = fdt_hash64_step(__fdt_hash_path(path, prop_name - path, &end, &segments), '/');
+    for(const char *p = prop_name; *p; p++) {
+        hash = fdt_hash64_step(hash, *p);
+    }
+
+    return hash;
 }
 
 
 /**
- * @brief debug print all node and property
+ * @brief check whether node is at path, segments are compared from the end
  * 
  * @param node: node
- * @level: level of node, for example, the root node is 0, the '/uart' node is 1, etc.
- * @return none
- * @note only used for debug
+ * @param root: root node
+ * @param path: node path
+ * @param len: length of path
+ * @return bool: true if path names the node
  */
-static void fdt_debug_put_node_prop(fdt_node_t *node, int level)
+static bool fdt_node_match_path(fdt_node_t *node, fdt_node_t *root, const char *path, size_t len)
 {
-    fdt_prop_t *prop = NULL;
-    char _level[1024] = {0};
-    fdt_memset(_level, ' ', level *4);
-    uint8_t *type = NULL;
-
-    FDT_LOG("%snode = %s\n", _level, node->name);
-
-    fdt_list_for_each_entry(prop, &node->prop, fdt_prop_t, node) {
-        if(prop == NULL) {
-            continue;
+    while(1) {
+        while(len > 0 && (path[len - 1] == '/' || path[len - 1] == ' ')) {
+            len --;
         }
 
-        FDT_LOG("%s    prop: %s = ", _level, prop->name);
-        type = (uint8_t*)prop->offset;
+        if(len == 0) {
+            return node == root;
+        }
 
-        if(*type == FDT_PROP_STRING) {
-            FDT_LOG("%s\n", (char*)(type + 1));
+        size_t seg = len;
+        while(seg > 0 && path[seg - 1] != '/') {
+            seg --;
         }
-        else if(*type > FDT_PROP_STRING && *type < FDT_PROP_ARRAY) {
-            uint8_t len = *type;
-            uint64_t value = 0;
-            for(int i = len; i > 0; i--) {
-                value = (value << 8  | (*(type + i)));
-            }
 
-            FDT_LOG("0x%"PRIx64"\n", value);
+        if(node == root || !fdt_name_equal_segment(node->name, path + seg, len - seg)) {
+            return false;
         }
-        else if(*type > FDT_PROP_ARRAY) {
-            uint8_t cell_size = *type - 32;
-            type ++;
-            uint8_t array_len = *((uint8_t*)type);
-            
-            for(int i = 0; i < array_len; i++) {
-                uint64_t value = 0;
-                for(int j = cell_size; j > 0; j--) {
-                    value = (value << 8  | (*(type + j + i * cell_size)));
+
+        node = node->parent;
+        len = seg;
+    }
+}
+
+
+/**
+ * @brief find node by path in perfect hash table
+ * 
+ * @param tree: tree loaded with perfect hash table
+ * @param path: node path
+ * @param len: max length of path, it also stops at the terminating zero
+ * @return fdt_node_t*: node
+ */
+static fdt_node_t* fdt_phash_find_node(fdt_tree_t *tree, const char *path, size_t len)
+{
+    const fdt_phash_table_t *table = &tree->phash->node;
+    size_t end = 0;
+    uint32_t segments = 0;
+    uint64_t hash = __fdt_hash_path(path, len, &end, &segments);
+
+    if(segments == 0) {
+        return &tree->root;
+    }
+
+    if(table->count == 0) {
+        return NULL;
+    }
+
+    const fdt_phash_entry_t *entry = &table->entry[fdt_phash_slot(table->disp, table->count, hash)];
+    if(entry->hash != (uint32_t)hash) {
+        return NULL;
+    }
+
+    fdt_node_t *node = tree->phash_nodes[entry->ordinal];
+    if(!fdt_node_match_path(node, &tree->root, path, end)) {
+        return NULL;
+    }
+
+    return node;
+}
+
+
+/**
+ * @brief find alias by name, in O(1)
+ * 
+ * @param tree: tree
+ * @param seg: alias name, it is not terminated by zero and spaces are ignored
+ * @param len: length of alias name
+ * @return fdt_node_t*: aliased node, NULL if not found
+ */
+static fdt_node_t* fdt_tree_find_alias(fdt_tree_t *tree, const char *seg, size_t len)
+{
+    uint32_t name_len = 0;
+    uint16_t hash = fdt_hash_segment(seg, len, &name_len);
+
+    for(uint32_t slot = hash & tree->alias_mask; tree->aliases[slot].name; slot = (slot + 1) & tree->alias_mask) {
+        fdt_alias_t *alias = &tree->aliases[slot];
+        if(alias->hash != hash || alias->name_len != name_len || !fdt_name_equal_segment(alias->name, seg, len)) {
+            continue;
+        }
+
+        // aliases of lazy tree are resolved on first use
+        fdt_node_t *node = fdt_atomic_load(&alias->node);
+        if(node == NULL && tree->blob) {
+            node = __fdt_find_node_by_path(&tree->root, alias->path, (size_t)-1);
+            if(node) {
+                fdt_atomic_store(&alias->node, node);
+            }
+        }
+        return node;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief resolve the first segment of a relative path as an alias
+ * 
+ * @param tree: tree
+ * @param path: path
+ * @param len: max length of path
+ * @param rest: position of the rest of path after the alias
+ * @return fdt_node_t*: aliased node, NULL if path is absolute or the segment is no alias
+ */
+static fdt_node_t* fdt_tree_find_path_alias(fdt_tree_t *tree, const char *path, size_t len, size_t *rest)
+{
+    size_t pos = 0;
+
+    if(tree->aliases == NULL) {
+        return NULL;
+    }
+
+    while(pos < len && path[pos] == ' ') {
+        pos ++;
+    }
+    if(pos >= len || path[pos] == '/' || path[pos] == 0) {
+        return NULL;
+    }
+
+    size_t seg = pos;
+    while(pos < len && path[pos] && path[pos] != '/') {
+        pos ++;
+    }
+
+    *rest = pos;
+    return fdt_tree_find_alias(tree, path + seg, pos - seg);
+}
+
+
+/**
+ * @brief find node by path
+ * 
+ * @param path: node path
+ * @return fdt_node_t*: node
+ */
+fdt_node_t* fdt_find_node_by_path(const char *path)
+{
+    fdt_tree_t *tree = fdt_get_tree();
+    size_t rest = 0;
+
+    fdt_node_t *alias = fdt_tree_find_path_alias(tree, path, (size_t)-1, &rest);
+    if(alias) {
+        return __fdt_find_node_by_path(alias, path + rest, (size_t)-1);
+    }
+
+    if(tree->phash) {
+        return fdt_phash_find_node(tree, path, (size_t)-1);
+    }
+
+    return __fdt_find_node_by_path(&tree->root, path, (size_t)-1);
+}
+
+
+/**
+ * @brief find node by alias of /aliases node
+ * 
+ * @param alias: alias name
+ * @return fdt_node_t*: node, NULL if not found
+ */
+fdt_node_t* fdt_find_node_by_alias(const char *alias)
+{
+    fdt_tree_t *tree = fdt_get_tree();
+
+    if(tree->aliases == NULL || alias == NULL) {
+        return NULL;
+    }
+
+    return fdt_tree_find_alias(tree, alias, fdt_strlen(alias));
+}
+
+
+/**
+ * @brief compiled pattern of fdt_query()
+ * @seg: start of each segment.
+ * @len: length of each segment.
+ * @hash: hash of each segment without wildcard.
+ * @name_len: name length of each segment without wildcard.
+ * @count: number of segments.
+ * @globstar: bit i is set if segment i is "**".
+ * @literal: bit i is set if segment i has no wildcard.
+ * @out: output buffer.
+ * @max: capacity of output buffer.
+ * @found: number of matched nodes.
+ */
+typedef struct fdt_query {
+    const char *seg[FDT_QUERY_MAX_SEGMENTS];
+    uint16_t len[FDT_QUERY_MAX_SEGMENTS];
+    uint16_t hash[FDT_QUERY_MAX_SEGMENTS];
+    uint32_t name_len[FDT_QUERY_MAX_SEGMENTS];
+    uint8_t count;
+    uint64_t globstar;
+    uint64_t literal;
+    fdt_node_t **out;
+    uint32_t max;
+    uint32_t found;
+
+}fdt_query_t;
+
+
+/**
+ * @brief match node name with a glob segment, spaces of segment are ignored
+ * 
+ * @param pat: segment, it is not terminated by zero
+ * @param len: length of segment
+ * @param name: node name
+ * @return bool: true if matched
+ */
+static bool fdt_glob_match(const char *pat, size_t len, const char *name)
+{
+    size_t star = (size_t)-1;
+    const char *mark = NULL;
+    size_t p = 0;
+
+    while(*name) {
+        while(p < len && pat[p] == ' ') {
+            p ++;
+        }
+
+        if(p < len && (pat[p] == '?' || pat[p] == *name)) {
+            p ++;
+            name ++;
+        }
+        else if(p < len && pat[p] == '*') {
+            star = p ++;
+            mark = name;
+        }
+        else if(star != (size_t)-1) {
+            // let the last star eat one more character
+            p = star + 1;
+            name = ++ mark;
+        }
+        else {
+            return false;
+        }
+    }
+
+    while(p < len && (pat[p] == '*' || pat[p] == ' ')) {
+        p ++;
+    }
+    return p == len;
+}
+
+
+/**
+ * @brief add states reached by letting "**" match zero levels
+ * 
+ * @param query: pattern
+ * @param mask: states, bit i means segment i is the next one to match
+ * @return uint64_t: states
+ */
+static inline uint64_t fdt_query_closure(const fdt_query_t *query, uint64_t mask)
+{
+    uint64_t skip = mask & query->globstar;
+
+    while(skip) {
+        uint8_t i = (uint8_t)__builtin_ctzll(skip);
+        skip &= skip - 1;
+        if(!(mask & (1ull << (i + 1)))) {
+            mask |= 1ull << (i + 1);
+            skip |= (1ull << (i + 1)) & query->globstar;
+        }
+    }
+
+    return mask;
+}
+
+
+/**
+ * @brief match descendants of node, each node is visited at most once
+ * 
+ * @param query: pattern
+ * @param node: node
+ * @param mask: states of node
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_query_node(fdt_query_t *query, fdt_node_t *node, uint64_t mask)
+{
+    uint64_t accept = 1ull << query->count;
+    fdt_node_t *child = NULL;
+
+    if(mask & accept) {
+        if(query->found < query->max) {
+            query->out[query->found] = node;
+        }
+        query->found ++;
+    }
+
+    // nothing is left to match below this node
+    if(!(mask & ~accept) || fdt_node_materialize(node)) {
+        return (mask & ~accept) ? -1 : 0;
+    }
+
+    fdt_list_for_each_entry(child, &node->child, fdt_node_t, entry) {
+        uint64_t next = 0;
+        uint64_t todo = mask & ~accept;
+
+        while(todo) {
+            uint8_t i = (uint8_t)__builtin_ctzll(todo);
+            todo &= todo - 1;
+
+            if(query->globstar & (1ull << i)) {
+                next |= 1ull << i;
+            }
+            else if(query->literal & (1ull << i)) {
+                if(child->hash == query->hash[i] && child->name_len == query->name_len[i] &&
+                   fdt_name_equal_segment(child->name, query->seg[i], query->len[i])) {
+                    next |= 1ull << (i + 1);
                 }
-                FDT_LOG("0x%"PRIx64" ", value);
             }
-            FDT_LOG("\n");
+            else if(fdt_glob_match(query->seg[i], query->len[i], child->name)) {
+                next |= 1ull << (i + 1);
+            }
+        }
+
+        if(next && fdt_query_node(query, child, fdt_query_closure(query, next))) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief find nodes matching a glob pattern in one traversal
+ * 
+ * @param pattern: pattern, "*" and "?" match within a name, "**" matches any levels
+ * @param out: output buffer
+ * @param max: capacity of output buffer
+ * @return int: number of matched nodes, it can be more than max, -1: fail
+ */
+int fdt_query(const char *pattern, fdt_node_t **out, uint32_t max)
+{
+    fdt_query_t query = {.out = out, .max = out ? max : 0};
+    size_t pos = 0;
+
+    if(pattern == NULL) {
+        return -1;
+    }
+
+    while(pattern[pos]) {
+        if(pattern[pos] == '/' || pattern[pos] == ' ') {
+            pos ++;
+            continue;
+        }
+
+        size_t seg = pos;
+        while(pattern[pos] && pattern[pos] != '/') {
+            pos ++;
+        }
+
+        if(query.count >= FDT_QUERY_MAX_SEGMENTS || pos - seg > UINT16_MAX) {
+            FDT_LOG_ERROR("query pattern is too long\n");
+            return -1;
+        }
+
+        uint8_t i = query.count ++;
+        query.seg[i] = pattern + seg;
+        query.len[i] = (uint16_t)(pos - seg);
+
+        size_t chars = 0, stars = 0, wild = 0;
+        for(size_t j = seg; j < pos; j++) {
+            chars += pattern[j] != ' ';
+            stars += pattern[j] == '*';
+            wild += pattern[j] == '*' || pattern[j] == '?';
+        }
+
+        if(chars == 2 && stars == 2) {
+            query.globstar |= 1ull << i;
+        }
+        else if(wild == 0) {
+            query.literal |= 1ull << i;
+            query.hash[i] = fdt_hash_segment(query.seg[i], query.len[i], &query.name_len[i]);
+        }
+    }
+
+    if(fdt_query_node(&query, fdt_get_root_node(), fdt_query_closure(&query, 1))) {
+        return -1;
+    }
+
+    return query.found > INT32_MAX ? INT32_MAX : (int)query.found;
+}
+
+
+/**
+ * @brief find property by name
+ * 
+ * @param node: node
+ * @param name: property name
+ * @return fdt_prop_t*: property
+ */
+fdt_prop_t* fdt_find_prop_by_name(fdt_node_t *node, const char *name)
+{
+    fdt_prop_t *child = NULL;
+    uint32_t len = 0;
+    uint16_t hash = fdt_hash_string(name, &len);
+
+    if(fdt_node_materialize(node)) {
+        return NULL;
+    }
+
+    if(node->index && node->index->props) {
+        fdt_index_t *index = node->index;
+        uint32_t key = ((uint32_t)hash << 16) | len;
+        uint32_t i = fdt_index_lower_bound(index->props, index->prop_count, key, fdt_offsetof(fdt_prop_t, hash));
+
+        for(; i < index->prop_count; i++) {
+            child = (fdt_prop_t*)index->props[i];
+            if(child->hash != hash || child->name_len != len) {
+                break;
+            }
+
+            if(fdt_memcmp(child->name, name, len) == 0) {
+                return child;
+            }
+        }
+
+        return NULL;
+    }
+
+    fdt_list_for_each_entry(child, &node->prop, fdt_prop_t, node) {
+        if(child == NULL) {
+            continue;
+        }
+
+        if(child->hash != hash || child->name_len != len) {
+            continue;
+        }
+
+        if(fdt_memcmp(child->name, name, len) == 0) {
+            return child;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief find property by path
+ *
+ * @param path: the path of property
+ * @return fdt_prop_t*: property
+ */
+fdt_prop_t* fdt_find_prop_by_path(const char *path)
+{
+    fdt_tree_t *tree = fdt_get_tree();
+    fdt_node_t* node = NULL;
+    const char *prop_name = path;
+
+    for(const char *p = path; *p; p++) {
+        if(*p == '/') {
+            prop_name = p + 1;
+        }
+    }
+
+    size_t rest = 0;
+    node = fdt_tree_find_path_alias(tree, path, prop_name - path, &rest);
+    if(node) {
+        node = __fdt_find_node_by_path(node, path + rest, prop_name - path - rest);
+        return node ? fdt_find_prop_by_name(node, prop_name) : NULL;
+    }
+
+    if(tree->phash) {
+        const fdt_phash_table_t *table = &tree->phash->prop;
+        uint64_t hash = fdt_hash_prop_path(path);
+        if(table->count == 0) {
+            return NULL;
+        }
+
+        const fdt_phash_entry_t *entry = &table->entry[fdt_phash_slot(table->disp, table->count, hash)];
+        if(entry->hash != (uint32_t)hash) {
+            return NULL;
+        }
+
+        fdt_prop_t *prop = tree->phash_props[entry->ordinal];
+        node = tree->phash_nodes[entry->owner];
+        if(fdt_strcmp(prop->name, prop_name) != 0 ||
+           !fdt_node_match_path(node, &tree->root, path, prop_name - path)) {
+            return NULL;
+        }
+
+        return prop;
+    }
+
+    node = __fdt_find_node_by_path(&tree->root, path, prop_name - path);
+    if(node == NULL) {
+        return NULL;
+    }
+
+    return fdt_find_prop_by_name(node, prop_name);
+}
+
+
+/**
+ * blob values are little endian, they are swapped after load on big endian cpu
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define  fdt_le16(value)                 __builtin_bswap16(value)
+#define  fdt_le32(value)                 __builtin_bswap32(value)
+#define  fdt_le64(value)                 __builtin_bswap64(value)
+#else
+#define  fdt_le16(value)                 (value)
+#define  fdt_le32(value)                 (value)
+#define  fdt_le64(value)                 (value)
+#endif
+
+
+/**
+ * @brief get 32-bit little endian value of dtb file
+ * 
+ * @param token: input token position of dtb file
+ * @return uint32_t: value
+ */
+static inline uint32_t fdt_get_u32(const uint8_t *token)
+{
+    uint32_t value = 0;
+
+    fdt_memcpy(&value, token, 4);
+    return fdt_le32(value);
+}
+
+
+/**
+ * @brief get little endian cell of int or array property, cells of 1, 2,
+ *        4 and 8 bytes are loaded at once, other sizes byte by byte
+ * 
+ * @param cell: cell, it may be unaligned
+ * @param size: cell size in bytes
+ * @return uint64_t: value, the low 8 bytes if cell is wider
+ */
+static inline uint64_t fdt_get_cell(const uint8_t *cell, uint8_t size)
+{
+    uint16_t u16 = 0;
+    uint32_t u32 = 0;
+    uint64_t u64 = 0;
+
+    switch(size) {
+    case 1:
+        return cell[0];
+    case 2:
+        fdt_memcpy(&u16, cell, 2);
+        return fdt_le16(u16);
+    case 4:
+        fdt_memcpy(&u32, cell, 4);
+        return fdt_le32(u32);
+    case 8:
+        fdt_memcpy(&u64, cell, 8);
+        return fdt_le64(u64);
+    default:
+        for(uint8_t i = (size < 8 ? size : 8); i > 0; i--) {
+            u64 = (u64 << 8) | cell[i - 1];
+        }
+        return u64;
+    }
+}
+
+
+/**
+ * @brief get cells of int or array property value
+ * 
+ * @param value: property value, the first byte is type
+ * @param cell_size: size of one cell in bytes
+ * @param count: number of cells, it is 1 for int property
+ * @return const uint8_t*: first cell, NULL if property is not int or array
+ */
+static const uint8_t* fdt_prop_get_cells(const uint8_t *value, uint8_t *cell_size, uint32_t *count)
+{
+    uint8_t type = *value;
+
+    if(type > FDT_PROP_STRING && type < FDT_PROP_ARRAY) {
+        *cell_size = type;
+        *count = 1;
+        return value + 1;
+    }
+    else if(type > FDT_PROP_ARRAY && type < FDT_PROP_BYTES) {
+        *cell_size = type - FDT_PROP_ARRAY;
+        *count = *(value + 1);
+        return value + 2;
+    }
+    else if(type > FDT_PROP_LONG_ARRAY && type < FDT_PROP_LONG_ARRAY + FDT_PROP_ARRAY) {
+        *cell_size = type - FDT_PROP_LONG_ARRAY;
+        *count = fdt_get_u32(value + 1);
+        return value + 5;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief get payload of bytes or array property value
+ * 
+ * @param value: property value, the first byte is type
+ * @param len: payload size in bytes
+ * @return const uint8_t*: payload, NULL if property is not bytes or array
+ */
+static const uint8_t* fdt_prop_get_payload(const uint8_t *value, uint32_t *len)
+{
+    uint8_t cell_size = 0;
+    uint32_t count = 0;
+    const uint8_t *cells = NULL;
+
+    if(*value == FDT_PROP_BYTES) {
+        *len = fdt_get_u32(value + 1);
+        return value + 5;
+    }
+
+    if(*value < FDT_PROP_ARRAY) {
+        return NULL;
+    }
+
+    cells = fdt_prop_get_cells(value, &cell_size, &count);
+    if(cells == NULL) {
+        return NULL;
+    }
+
+    *len = cell_size * count;
+    return cells;
+}
+
+
+/**
+ * @brief get size of property value whose length is in its header
+ * 
+ * @param value: property value, the first byte is type
+ * @return uint64_t: size of value in bytes including type, 0 if type is
+ *         string, reference or invalid
+ */
+static uint64_t fdt_prop_header_value_size(const uint8_t *value)
+{
+    uint8_t type = *value;
+
+    if(type > FDT_PROP_STRING && type < FDT_PROP_ARRAY) {
+        return type + 1;
+    }
+    else if(type > FDT_PROP_ARRAY && type < FDT_PROP_BYTES) {
+        return (uint64_t)(type - FDT_PROP_ARRAY) * *(value + 1) + 2;
+    }
+    else if(type == FDT_PROP_BYTES) {
+        return (uint64_t)fdt_get_u32(value + 1) + 5;
+    }
+    else if(type > FDT_PROP_LONG_ARRAY && type < FDT_PROP_LONG_ARRAY + FDT_PROP_ARRAY) {
+        return (uint64_t)(type - FDT_PROP_LONG_ARRAY) * fdt_get_u32(value + 1) + 5;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief get size of property value of dtb file which is not checked yet
+ * 
+ * @param value: property value, the first byte is type
+ * @param left: bytes left in dtb file from value
+ * @return uint64_t: size of value in bytes including type, 0 if type is
+ *         invalid or the value crosses the end of dtb file
+ */
+static uint64_t fdt_prop_value_size(const uint8_t *value, uint64_t left)
+{
+    uint64_t size = 0;
+    uint8_t type = 0;
+
+    if(left == 0) {
+        return 0;
+    }
+    type = *value;
+
+    if(type == FDT_PROP_STRING) {
+        const uint8_t *zero = fdt_memchr(value + 1, 0, left - 1);
+        size = zero ? (uint64_t)(zero - value) + 1 : 0;
+    }
+    else if(type == FDT_PROP_REF) {
+        size = left < 2 ? 0 : 2;
+        for(uint8_t i = 0; size && i < *(value + 1); i++) {
+            const uint8_t *zero = fdt_memchr(value + size, 0, left - size);
+            size = zero ? (uint64_t)(zero - value) + 1 : 0;
+        }
+    }
+    else {
+        // count of array and length of bytes take up to 4 bytes after type
+        uint64_t header = (type >= FDT_PROP_BYTES) ? 5 : ((type > FDT_PROP_ARRAY) ? 2 : 1);
+        size = left < header ? 0 : fdt_prop_header_value_size(value);
+    }
+
+    return size > left ? 0 : size;
+}
+
+
+/**
+ * @brief get node path of reference property value
+ * 
+ * @param value: property value, the first byte is FDT_PROP_REF
+ * @param index: index of reference, it is less than count
+ * @return const char*: node path
+ */
+static const char* fdt_prop_get_ref_path(const uint8_t *value, uint32_t index)
+{
+    const char *path = (const char*)(value + 2);
+
+    for(uint32_t i = 0; i < index; i++) {
+        path += fdt_strlen(path) + 1;
+    }
+
+    return path;
+}
+
+
+/**
+ * @brief get size of property value in blob
+ * 
+ * @param prop: property
+ * @return uint32_t: size of value in bytes including type byte
+ * @note the value was checked against the end of its blob when it was loaded
+ */
+uint32_t fdt_get_prop_value_size(const fdt_prop_t *prop)
+{
+    const uint8_t *value = prop->offset;
+
+    if(*value == FDT_PROP_STRING) {
+        return (uint32_t)fdt_strlen((const char*)(value + 1)) + 2;
+    }
+    else if(*value == FDT_PROP_REF) {
+        return (uint32_t)((const uint8_t*)fdt_prop_get_ref_path(value, *(value + 1)) - value);
+    }
+
+    return (uint32_t)fdt_prop_header_value_size(value);
+}
+
+
+/**
+ * @brief get type of property value
+ * 
+ * @param prop: property
+ * @return fdt_prop_type_t: property type
+ */
+fdt_prop_type_t fdt_get_prop_value_type(const fdt_prop_t *prop)
+{
+    fdt_prop_type_t type = FDT_PROP_INVALID;
+    uint8_t pos = *(const uint8_t*)(prop->offset);
+
+    if(pos == FDT_PROP_STRING) {
+        type = FDT_PROP_STRING;
+    }
+    else if(pos > FDT_PROP_STRING && pos < FDT_PROP_ARRAY) {
+        type = FDT_PROP_INT;
+    }
+    else if(pos > FDT_PROP_ARRAY && pos < FDT_PROP_BYTES) {
+        type = FDT_PROP_ARRAY;
+    }
+    else if(pos == FDT_PROP_BYTES) {
+        type = FDT_PROP_BYTES;
+    }
+    else if(pos == FDT_PROP_REF) {
+        type = FDT_PROP_REF;
+    }
+    else if(pos > FDT_PROP_LONG_ARRAY && pos < FDT_PROP_LONG_ARRAY + FDT_PROP_ARRAY) {
+        type = FDT_PROP_ARRAY;
+    }
+
+    return type;
+}
+
+
+/**
+ * @brief get cells of int or array property, without copying
+ * 
+ * @param prop: property
+ * @param cells: pointer to the first cell in the blob
+ * @param cell_size: bytes of each cell
+ * @param count: number of cells
+ * @return int: 0: success, -1: fail
+ */
+int fdt_get_prop_cells(const fdt_prop_t *prop, const void **cells, uint8_t *cell_size, uint32_t *count)
+{
+    const uint8_t *first = fdt_prop_get_cells((const uint8_t*)prop->offset, cell_size, count);
+    if(first == NULL) {
+        return -1;
+    }
+
+    *cells = first;
+    return 0;
+}
+
+
+/**
+ * @brief get payload of bytes or array property, without copying
+ * 
+ * @param prop: property
+ * @param data: pointer to the payload in the blob
+ * @param len: payload size in bytes
+ * @return int: 0: success, -1: fail
+ */
+int fdt_get_prop_payload(const fdt_prop_t *prop, const void **data, uint32_t *len)
+{
+    const uint8_t *payload = fdt_prop_get_payload((const uint8_t*)prop->offset, len);
+    if(payload == NULL) {
+        return -1;
+    }
+
+    *data = payload;
+    return 0;
+}
+
+
+/**
+ * @brief read string property
+ * 
+ * @param node: node
+ * @param name: property name
+ * @return const char*: property value
+ */
+const char* fdt_read_prop_string(fdt_node_t *node, const char *name)
+{
+    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
+    if(prop == NULL) {
+        return NULL;
+    }
+
+    char *str = (char*)prop->offset;
+    return (str+1);
+}
+
+
+/**
+ * @brief get a cell of int or array property
+ * 
+ * @param node: node
+ * @param name: property name
+ * @param index: index of cell
+ * @param value: output value, the low 8 bytes if cell is wider
+ * @param size: output cell size in bytes
+ * @return int: 0: success, -1: fail
+ */
+static inline int fdt_prop_get_int(fdt_node_t *node, const char *name, uint32_t index, uint64_t *value, uint8_t *size)
+{
+    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
+    if(prop == NULL) {
+        return -1;
+    }
+
+    const uint8_t *type = prop->offset;
+    if(*type > FDT_PROP_STRING && *type < FDT_PROP_ARRAY && index == 0) {
+        *size = *type;
+        *value = fdt_get_cell(type + 1, *size);
+        return 0;
+    }
+
+    uint32_t count = 0;
+    const uint8_t *cells = fdt_prop_get_cells(type, size, &count);
+    if(cells == NULL || index >= count) {
+        return -1;
+    }
+
+    *value = fdt_get_cell(cells + (size_t)index * *size, *size);
+    return 0;
+}
+
+
+/**
+ * @brief read int property
+ * 
+ * @param node: node
+ * @param name: property name
+ * @param value: property value
+ * @return int: 0: success, -1: fail, cell is wider than 8 bytes or value
+ *         does not fit in size_t
+ */
+int fdt_read_prop_int(fdt_node_t *node, const char *name, size_t *value)
+{
+    uint64_t cell = 0;
+    uint8_t size = 0;
+
+    if(fdt_prop_get_int(node, name, 0, &cell, &size) || size > 8 || (uint64_t)(size_t)cell != cell) {
+        return -1;
+    }
+
+    *value = (size_t)cell;
+    return 0;
+}
+
+
+/**
+ * @brief read int property
+ * 
+ * @param node: node
+ * @param name: property name
+ * @param index: index of cell
+ * @param value: property value
+ * @return int: 0: success, -1: fail, cell is wider than 8 bytes or value
+ *         does not fit in size_t
+ */
+int fdt_read_prop_int_index(fdt_node_t *node, const char *name, uint32_t index, size_t *value)
+{
+    uint64_t cell = 0;
+    uint8_t size = 0;
+
+    if(fdt_prop_get_int(node, name, index, &cell, &size) || size > 8 || (uint64_t)(size_t)cell != cell) {
+        return -1;
+    }
+
+    *value = (size_t)cell;
+    return 0;
+}
+
+
+/**
+ * @brief read int property as 32-bit unsigned value
+ * 
+ * @param node: node
+ * @param name: property name
+ * @param value: property value
+ * @return int: 0: success, -1: fail or value does not fit
+ */
+int fdt_read_prop_u32(fdt_node_t *node, const char *name, uint32_t *value)
+{
+    uint64_t cell = 0;
+    uint8_t size = 0;
+
+    if(fdt_prop_get_int(node, name, 0, &cell, &size) || size > 8 || cell > UINT32_MAX) {
+        return -1;
+    }
+
+    *value = (uint32_t)cell;
+    return 0;
+}
+
+
+/**
+ * @brief read int property as 64-bit unsigned value
+ * 
+ * @param node: node
+ * @param name: property name
+ * @param value: property value
+ * @return int: 0: success, -1: fail or value does not fit
+ */
+int fdt_read_prop_u64(fdt_node_t *node, const char *name, uint64_t *value)
+{
+    uint64_t cell = 0;
+    uint8_t size = 0;
+
+    if(fdt_prop_get_int(node, name, 0, &cell, &size) || size > 8) {
+        return -1;
+    }
+
+    *value = cell;
+    return 0;
+}
+
+
+/**
+ * @brief read int property as 32-bit signed value, the top bit of the cell
+ *        is the sign bit
+ * 
+ * @param node: node
+ * @param name: property name
+ * @param value: property value
+ * @return int: 0: success, -1: fail or value does not fit
+ */
+int fdt_read_prop_s32(fdt_node_t *node, const char *name, int32_t *value)
+{
+    uint64_t cell = 0;
+    uint8_t size = 0;
+
+    if(fdt_prop_get_int(node, name, 0, &cell, &size) || size > 8) {
+        return -1;
+    }
+
+    uint32_t shift = 64 - size * 8;
+    int64_t sign = (int64_t)(cell << shift) >> shift;
+    if(sign < INT32_MIN || sign > INT32_MAX) {
+        return -1;
+    }
+
+    *value = (int32_t)sign;
+    return 0;
+}
+
+
+/**
+ * @brief read node referenced by reference property
+ * 
+ * @param node: node
+ * @param name: property name
+ * @param index: index of reference
+ * @return fdt_node_t*: referenced node, NULL if not found
+ */
+fdt_node_t* fdt_read_prop_node(fdt_node_t *node, const char *name, uint32_t index)
+{
+    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
+    if(prop == NULL || *(const uint8_t*)prop->offset != FDT_PROP_REF) {
+        return NULL;
+    }
+
+    fdt_ref_prop_t *ref = fdt_container_of(prop, fdt_ref_prop_t, prop);
+    if(index >= ref->count) {
+        return NULL;
+    }
+
+    // nodes of lazy tree are resolved on first read, in the tree owning the
+    // property rather than the published one, and without alias rewriting
+    fdt_node_t *target = fdt_atomic_load(&ref->target[index]);
+    if(target == NULL) {
+        fdt_node_t *root = node;
+        while(root->parent != root) {
+            root = root->parent;
+        }
+        target = __fdt_find_node_by_path(root, fdt_prop_get_ref_path(prop->offset, index), (size_t)-1);
+        if(target) {
+            fdt_atomic_store(&ref->target[index], target);
+        }
+    }
+
+    return target;
+}
+
+
+/**
+ * @brief read bytes or array property payload, without copying
+ * 
+ * @param node: node
+ * @param name: property name
+ * @param data: pointer to the payload in the blob
+ * @param len: payload size in bytes
+ * @return int: 0: success, -1: fail
+ */
+int fdt_read_prop_bytes(fdt_node_t *node, const char *name, const void **data, uint32_t *len)
+{
+    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
+    if(prop == NULL) {
+        return -1;
+    }
+
+    return fdt_get_prop_payload(prop, data, len);
+}
+
+
+/**
+ * @brief open a streaming reader over a bytes or array property
+ * 
+ * @param node: node
+ * @param name: property name
+ * @param stream: reader to initialize
+ * @return int: 0: success, -1: fail
+ */
+int fdt_prop_stream_open(fdt_node_t *node, const char *name, fdt_prop_stream_t *stream)
+{
+    const void *data = NULL;
+    uint32_t len = 0;
+
+    if(fdt_read_prop_bytes(node, name, &data, &len)) {
+        return -1;
+    }
+
+    stream->data = (const uint8_t*)data;
+    stream->size = len;
+    stream->pos = 0;
+    return 0;
+}
+
+
+/**
+ * @brief get the next window of a streaming reader, without copying
+ * 
+ * @param stream: reader
+ * @param window: max number of bytes wanted
+ * @param chunk: pointer to the window in the blob
+ * @return uint32_t: number of bytes in the window, 0 at the end of the payload
+ */
+uint32_t fdt_prop_stream_next(fdt_prop_stream_t *stream, uint32_t window, const void **chunk)
+{
+    uint32_t left = stream->size - stream->pos;
+
+    if(window > left) {
+        window = left;
+    }
+
+    *chunk = stream->data + stream->pos;
+    stream->pos += window;
+    return window;
+}
+
+
+/**
+ * @brief move the read position of a streaming reader
+ * 
+ * @param stream: reader
+ * @param offset: new read position from the start of the payload
+ * @return int: 0: success, -1: offset is beyond the payload
+ */
+int fdt_prop_stream_seek(fdt_prop_stream_t *stream, uint32_t offset)
+{
+    if(offset > stream->size) {
+        return -1;
+    }
+
+    stream->pos = offset;
+    return 0;
+}
+
+
+/**
+ * @brief read string property by node path
+ * 
+ * @param node_path: node path
+ * @param name: property name
+ * @return const char*: property value
+ */
+const char* fdt_read_prop_string_by_path(const char *node_path, const char *name)
+{
+    fdt_node_t* node = fdt_find_node_by_path(node_path);
+    if(node == NULL) {
+        return NULL;
+    }
+
+    return fdt_read_prop_string(node, name);
+}
+
+
+/**
+ * @brief read int property by node path
+ * 
+ * @param node_path: node path
+ * @param name: property name
+ * @param value: property value
+ * @return int: 0: success, -1: fail
+ */
+int fdt_read_prop_int_by_path(const char *node_path, const char *name, size_t *value)
+{
+    fdt_node_t* node = fdt_find_node_by_path(node_path);
+    if(node == NULL) {
+        return -1;
+    }
+
+    return fdt_read_prop_int(node, name, value);
+}
+
+
+/**
+ * @brief read int property by node path
+ * 
+ * @param node_path: node path
+ * @param name: property name
+ * @param value: property value
+ * @return int: 0: success, -1: fail
+ */
+int fdt_read_prop_int_index_by_path(const char *node_path, const char *name, uint32_t index, size_t *value)
+{
+    fdt_node_t* node = fdt_find_node_by_path(node_path);
+    if(node == NULL) {
+        return -1;
+    }
+
+    return fdt_read_prop_int_index(node, name, index, value);
+}
+
+
+/**
+ * @brief read bytes or array property payload by node path
+ * 
+ * @param node_path: node path
+ * @param name: property name
+ * @param data: pointer to the payload in the blob
+ * @param len: payload size in bytes
+ * @return int: 0: success, -1: fail
+ */
+int fdt_read_prop_bytes_by_path(const char *node_path, const char *name, const void **data, uint32_t *len)
+{
+    fdt_node_t* node = fdt_find_node_by_path(node_path);
+    if(node == NULL) {
+        return -1;
+    }
+
+    return fdt_read_prop_bytes(node, name, data, len);
+}
+
+
+/**
+ * @brief get int property size
+ * @param node: node
+ * @param name: property name
+ * @return int: property size, -1: fail
+ */
+int fdt_get_prop_int_size(fdt_node_t *node, const char *name)
+{
+    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
+    if(prop == NULL) {
+        return -1;
+    }
+
+    uint8_t cell_size = 0;
+    uint32_t count = 0;
+    if(fdt_prop_get_cells((const uint8_t*)prop->offset, &cell_size, &count) == NULL) {
+        return -1;
+    }
+
+    return (int)count;
+}
+
+
+/**
+ * @brief get int property size by path
+ * @param node_path: node path
+ * @param name: property name
+ * @return int: property size, -1: fail
+ */
+int fdt_get_prop_int_size_by_path(const char *node_path, const char *name)
+{
+    fdt_node_t* node = fdt_find_node_by_path(node_path);
+    if(node == NULL) {
+        return -1;
+    }
+
+    return fdt_get_prop_int_size(node, name);
+}
+
+
+/**
+ * @brief get property type
+ * @param node: node
+ * @param name: property name
+ * @return fdt_prop_type_t: property type, -1 if node not found
+ */
+fdt_prop_type_t fdt_get_prop_type(fdt_node_t *node, const char *name)
+{
+    fdt_prop_t *prop = fdt_find_prop_by_name(node, name);
+    if(prop == NULL) {
+        return -1;
+    }
+
+    return fdt_get_prop_value_type(prop);
+}
+
+
+/**
+ * @brief get property type by node path
+ * @param node_path: node path
+ * @param name: property name
+ * @return fdt_prop_type_t: property type, -1 if node not found
+ */
+fdt_prop_type_t fdt_get_prop_type_by_path(const char *node_path, const char *name)
+{
+    fdt_node_t* node = fdt_find_node_by_path(node_path);
+    if(node == NULL) {
+        return -1;
+    }
+
+    return fdt_get_prop_type(node, name);
+}
+
+
+/**
+ * @brief check that tree stays in memory budget after allocating more bytes
+ * 
+ * @param tree: tree
+ * @param size: bytes to allocate
+ * @return int: 0: success, -1: budget exceeded
+ */
+static int fdt_mem_check_budget(const fdt_tree_t *tree, uint64_t size)
+{
+    if(fdt_mem_budget == 0 || tree->consume + size <= fdt_mem_budget) {
+        return 0;
+    }
+
+    FDT_LOG_ERROR("memory budget exceeded: %"PRIu64" bytes needed, budget is %"PRIu64" bytes\n",
+                  tree->consume + size, fdt_mem_budget);
+    return -1;
+}
+
+
+/**
+ * @brief account bytes allocated by tree, and the high-water mark if it
+ *        is one of the tree instances
+ * 
+ * @param tree: tree
+ * @param size: bytes
+ * @return none
+ * @note worker trees of fdt_load_parallel() are accounted when they are joined
+ */
+static void fdt_mem_hold(fdt_tree_t *tree, uint64_t size)
+{
+    tree->consume += size;
+    if(tree != &fdt_trees[0] && tree != &fdt_trees[1]) {
+        return;
+    }
+
+    size_t held = fdt_atomic_add(&fdt_mem_held, (size_t)size);
+    size_t peak = fdt_atomic_load(&fdt_mem_peak);
+    while(held > peak) {
+        if(fdt_atomic_cas(&fdt_mem_peak, &peak, held)) {
+            break;
+        }
+    }
+}
+
+
+/**
+ * @brief account bytes freed by tree
+ * 
+ * @param tree: tree
+ * @param size: bytes
+ * @return none
+ */
+static void fdt_mem_release(fdt_tree_t *tree, uint64_t size)
+{
+    tree->consume -= size;
+    if(tree == &fdt_trees[0] || tree == &fdt_trees[1]) {
+        fdt_atomic_sub(&fdt_mem_held, (size_t)size);
+    }
+}
+
+
+/**
+ * @brief add an arena block to tree
+ * 
+ * @param tree: tree
+ * @param size: bytes needed at least
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_arena_grow(fdt_tree_t *tree, size_t size)
+{
+    size_t data_size = size > FDT_ARENA_BLOCK_SIZE ? size : FDT_ARENA_BLOCK_SIZE;
+
+    if(fdt_mem_check_budget(tree, sizeof(fdt_arena_t) + data_size)) {
+        return -1;
+    }
+
+    fdt_arena_t *arena = fdt_mem_alloc(sizeof(fdt_arena_t) + data_size);
+    if(arena == NULL) {
+        return -1;
+    }
+
+    arena->next = tree->arena;
+    arena->used = 0;
+    arena->size = (uint32_t)data_size;
+    tree->arena = arena;
+    fdt_mem_hold(tree, sizeof(fdt_arena_t) + data_size);
+
+    return 0;
+}
+
+
+/**
+ * @brief free all arena blocks of tree
+ * 
+ * @param tree: tree
+ * @return none
+ */
+static void fdt_arena_free(fdt_tree_t *tree)
+{
+    while(tree->arena) {
+        fdt_arena_t *next = tree->arena->next;
+        fdt_mem_free(tree->arena);
+        tree->arena = next;
+    }
+}
+
+
+/**
+ * @brief allocate memory of tree, from its arena if it has one
+ * 
+ * @param tree: tree
+ * @param size: bytes
+ * @param type: memory type
+ * @return void*: memory, NULL if fail
+ */
+static void* fdt_tree_alloc(fdt_tree_t *tree, size_t size, fdt_mem_type_t type)
+{
+    if(tree->arena == NULL) {
+        if(fdt_mem_check_budget(tree, size)) {
+            return NULL;
+        }
+
+        void *ptr = fdt_mem_alloc(size);
+        if(ptr) {
+            fdt_mem_hold(tree, size);
+            tree->mem[type] += size;
+        }
+        return ptr;
+    }
+
+    size = (size + 7) & ~(size_t)7;
+    if(tree->arena->size - tree->arena->used < size && fdt_arena_grow(tree, size)) {
+        return NULL;
+    }
+
+    void *ptr = (uint8_t*)(tree->arena + 1) + tree->arena->used;
+    tree->arena->used += (uint32_t)size;
+    tree->mem[type] += size;
+    return ptr;
+}
+
+
+/**
+ * @brief create a property
+ * 
+ * @param tree: tree which the property belongs to
+ * @param name: property name
+ * @param len: length of property name
+ * @param hash: hash of property name
+ * @param value: data value
+ * @return fdt_prop_t*: property
+ */
+static fdt_prop_t* fdt_prop_create(fdt_tree_t *tree, const char *name, uint16_t len, uint16_t hash, const void *value)
+{
+    fdt_prop_t *prop = NULL;
+
+    if(*(const uint8_t*)value == FDT_PROP_REF) {
+        uint8_t count = *((const uint8_t*)value + 1);
+        fdt_ref_prop_t *ref = fdt_tree_alloc(tree, sizeof(fdt_ref_prop_t) + sizeof(fdt_node_t*) * count, FDT_MEM_PROP);
+        if(ref == NULL) {
+            return NULL;
+        }
+
+        ref->count = count;
+        for(uint8_t i = 0; i < count; i++) {
+            ref->target[i] = NULL;
+        }
+        ref->next = tree->refs;
+        tree->refs = ref;
+        prop = &ref->prop;
+    }
+    else {
+        prop = fdt_tree_alloc(tree, sizeof(fdt_prop_t), FDT_MEM_PROP);
+        if(prop == NULL) {
+            return NULL;
+        }
+    }
+
+    prop->name = name;
+    prop->offset = value;
+    prop->hash = hash;
+    prop->name_len = len;
+
+    return prop;
+}
+
+
+/**
+ * @brief create a node
+ * 
+ * @param tree: tree which the node belongs to
+ * @param name: node name
+ * @param len: length of node name
+ * @param hash: hash of node name
+ * @return fdt_node_t*: node
+ */
+static fdt_node_t* fdt_node_create(fdt_tree_t *tree, const char *name, uint16_t len, uint16_t hash)
+{
+    fdt_node_t *node = fdt_tree_alloc(tree, sizeof(fdt_node_t), FDT_MEM_NODE);
+    if(node == NULL) {
+        return NULL;
+    }
+
+    node->name = name;
+    node->parent = NULL;
+    node->index = NULL;
+    node->lazy = NULL;
+    node->hash = hash;
+    node->name_len = len;
+
+    fdt_list_init(&node->prop);
+    fdt_list_init(&node->child);
+
+    return node;
+}
+
+
+/**
+ * @brief add property to node
+ * 
+ * @param node: node
+ * @param prop: property
+ * @return none
+ */
+static void fdt_node_append_prop(fdt_node_t *node, fdt_prop_t *prop)
+{
+    fdt_list_add_node_at_tail(&node->prop, &prop->node);
+}
+
+
+/**
+ * @brief add child node to node
+ * 
+ * @param node: node
+ * @param child: child node
+ * @return none
+ */
+static void fdt_node_add_child(fdt_node_t *node, fdt_node_t *child)
+{
+    child->parent = node;
+    fdt_list_add_node_at_tail(&node->child, &child->entry);
+}
+
+
+#if FDT_SORTED_INDEX_MIN > 0
+/**
+ * @brief insert entry into sorted entries, after entries with the same key
+ * 
+ * @param entries: sorted entries, it has room for one more entry
+ * @param count: number of entries
+ * @param entry: node or property
+ * @param hash_offset: offset of hash member
+ * @return none
+ */
+static void fdt_index_insert(void **entries, uint32_t count, void *entry, size_t hash_offset)
+{
+    uint32_t key = fdt_index_key(entry, hash_offset);
+    uint32_t low = 0;
+    uint32_t high = count;
+
+    while(low < high) {
+        uint32_t mid = low + (high - low) / 2;
+
+        if(fdt_index_key(entries[mid], hash_offset) <= key) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    for(uint32_t i = count; i > low; i--) {
+        entries[i] = entries[i - 1];
+    }
+    entries[low] = entry;
+}
+
+
+/**
+ * @brief build sorted index of node, its children are not indexed
+ * 
+ * @param tree: tree which the node belongs to
+ * @param node: node
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_node_build_own_index(fdt_tree_t *tree, fdt_node_t *node)
+{
+    fdt_list_node_t *pos = NULL;
+    uint32_t child_count = 0;
+    uint32_t prop_count = 0;
+
+    fdt_list_for_each(pos, &node->child) {
+        child_count ++;
+    }
+
+    fdt_list_for_each(pos, &node->prop) {
+        prop_count ++;
+    }
+
+    if(node->index ||
+       (child_count < FDT_SORTED_INDEX_MIN && prop_count < FDT_SORTED_INDEX_MIN)) {
+        return 0;
+    }
+
+    child_count = (child_count >= FDT_SORTED_INDEX_MIN) ? child_count : 0;
+    prop_count = (prop_count >= FDT_SORTED_INDEX_MIN) ? prop_count : 0;
+
+    size_t size = sizeof(fdt_index_t) + sizeof(void*) * (child_count + prop_count);
+    fdt_index_t *index = fdt_tree_alloc(tree, size, FDT_MEM_INDEX);
+    if(index == NULL) {
+        return -1;
+    }
+
+    void **entries = (void**)(index + 1);
+    index->children = child_count ? entries : NULL;
+    index->props = prop_count ? entries + child_count : NULL;
+    index->child_count = 0;
+    index->prop_count = 0;
+
+    if(child_count) {
+        fdt_list_for_each(pos, &node->child) {
+            fdt_index_insert(index->children, index->child_count ++,
+                             fdt_container_of(pos, fdt_node_t, entry), fdt_offsetof(fdt_node_t, hash));
+        }
+    }
+
+    if(prop_count) {
+        fdt_list_for_each(pos, &node->prop) {
+            fdt_index_insert(index->props, index->prop_count ++,
+                             fdt_container_of(pos, fdt_prop_t, node), fdt_offsetof(fdt_prop_t, hash));
+        }
+    }
+
+    node->index = index;
+    return 0;
+}
+
+
+/**
+ * @brief build sorted index of node and its children
+ * 
+ * @param tree: tree which the node belongs to
+ * @param node: node
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_node_build_index(fdt_tree_t *tree, fdt_node_t *node)
+{
+    fdt_list_node_t *pos = NULL;
+
+    fdt_list_for_each(pos, &node->child) {
+        if(fdt_node_build_index(tree, fdt_container_of(pos, fdt_node_t, entry))) {
+            return -1;
+        }
+    }
+
+    return fdt_node_build_own_index(tree, node);
+}
+#endif
+
+
+/**
+ * @brief free all properties and children of node
+ * 
+ * @param node: node, it is not freed itself
+ * @return none
+ */
+static void fdt_node_free_children(fdt_node_t *node)
+{
+    fdt_list_node_t *pos = node->prop.next;
+
+    if(node->index) {
+        fdt_mem_free(node->index);
+        node->index = NULL;
+    }
+
+    while(pos != &node->prop) {
+        fdt_prop_t *prop = fdt_container_of(pos, fdt_prop_t, node);
+        pos = pos->next;
+        fdt_mem_free(prop);
+    }
+
+    pos = node->child.next;
+    while(pos != &node->child) {
+        fdt_node_t *child = fdt_container_of(pos, fdt_node_t, entry);
+        pos = pos->next;
+        fdt_node_free_children(child);
+        fdt_mem_free(child);
+    }
+}
+
+
+/**
+ * @brief free all nodes and properties of tree and reset it to empty
+ * 
+ * @param tree: tree
+ * @return none
+ */
+static void fdt_tree_clear(fdt_tree_t *tree)
+{
+    if(tree->arena) {
+        fdt_arena_free(tree);
+        tree->root.index = NULL;
+    }
+    else {
+        fdt_node_free_children(&tree->root);
+    }
+
+    if(tree->phash_nodes) {
+        fdt_mem_free(tree->phash_nodes);
+    }
+    if(tree->phash_props) {
+        fdt_mem_free(tree->phash_props);
+    }
+    if(tree->aliases) {
+        fdt_mem_free(tree->aliases);
+    }
+
+    fdt_mem_release(tree, tree->consume);
+    fdt_root_init(tree);
+}
+
+
+/**
+ * @brief prepare perfect hash table for loading
+ * 
+ * @param tree: empty tree
+ * @param phash: perfect hash table, or NULL
+ * @return int: 0: success, -1: fail
+ * @note the root node is ordinal 0 of nodes
+ */
+static int fdt_tree_phash_init(fdt_tree_t *tree, const fdt_phash_t *phash)
+{
+    tree->node_count = 1;
+
+    if(phash == NULL) {
+        return 0;
+    }
+
+    size_t nodes_size = sizeof(fdt_node_t*) * (phash->node.total ? phash->node.total : 1);
+    size_t props_size = sizeof(fdt_prop_t*) * (phash->prop.total ? phash->prop.total : 1);
+
+    if(fdt_mem_check_budget(tree, nodes_size + props_size)) {
+        return -1;
+    }
+
+    tree->phash_nodes = fdt_mem_alloc(nodes_size);
+    tree->phash_props = fdt_mem_alloc(props_size);
+    if(tree->phash_nodes == NULL || tree->phash_props == NULL) {
+        FDT_LOG_ERROR("malloc perfect hash table failed\n");
+        return -1;
+    }
+
+    tree->phash_nodes[0] = &tree->root;
+    tree->phash = phash;
+    fdt_mem_hold(tree, nodes_size + props_size);
+    tree->mem[FDT_MEM_TABLE] += nodes_size + props_size;
+    return 0;
+}
+
+
+/**
+ * @brief drop perfect hash table if it does not match the loaded blob
+ * 
+ * @param tree: loaded tree
+ * @return none
+ */
+static void fdt_tree_phash_check(fdt_tree_t *tree)
+{
+    const fdt_phash_t *phash = tree->phash;
+
+    if(phash == NULL) {
+        return;
+    }
+
+    if(tree->node_count == phash->node.total && tree->prop_count == phash->prop.total) {
+        return;
+    }
+
+    FDT_LOG_ERROR("perfect hash table does not match dtb, it is ignored\n");
+    size_t size = sizeof(fdt_node_t*) * (phash->node.total ? phash->node.total : 1) +
+                  sizeof(fdt_prop_t*) * (phash->prop.total ? phash->prop.total : 1);
+    fdt_mem_release(tree, size);
+    tree->mem[FDT_MEM_TABLE] -= size;
+    fdt_mem_free(tree->phash_nodes);
+    fdt_mem_free(tree->phash_props);
+    tree->phash_nodes = NULL;
+    tree->phash_props = NULL;
+    tree->phash = NULL;
+}
+
+
+/**
+ * @brief publish tree to readers and reclaim the previous one
+ * 
+ * @param tree: tree to publish
+ * @return none
+ */
+static void fdt_tree_publish(fdt_tree_t *tree)
+{
+    fdt_tree_t *old = fdt_tree;
+
+    fdt_atomic_store(&fdt_tree, tree);
+    fdt_synchronize();
+    fdt_tree_clear(old);
+}
+
+
+/**
+ * @brief get the tree which is not published
+ * 
+ * @param none
+ * @return fdt_tree_t*: spare tree, it is empty
+ */
+static fdt_tree_t* fdt_get_spare_tree(void)
+{
+    return (fdt_tree == &fdt_trees[0]) ? &fdt_trees[1] : &fdt_trees[0];
+}
+
+
+/**
+ * @brief debug print all node and property
+ * 
+ * @param node: node
+ * @level: level of node, for example, the root node is 0, the '/uart' node is 1, etc.
+ * @return none
+ * @note only used for debug
+ */
+static void fdt_debug_put_node_prop(fdt_node_t *node, int level)
+{
+    fdt_prop_t *prop = NULL;
+    char _level[1024] = {0};
+    fdt_memset(_level, ' ', level *4);
+    uint8_t *type = NULL;
+
+    FDT_LOG("%snode = %s\n", _level, node->name);
+
+    fdt_list_for_each_entry(prop, &node->prop, fdt_prop_t, node) {
+        if(prop == NULL) {
+            continue;
+        }
+
+        FDT_LOG("%s    prop: %s = ", _level, prop->name);
+        type = (uint8_t*)prop->offset;
+
+        if(*type == FDT_PROP_STRING) {
+            FDT_LOG("%s\n", (char*)(type + 1));
+        }
+        else if(*type > FDT_PROP_STRING && *type < FDT_PROP_ARRAY) {
+            uint8_t len = *type;
+            uint64_t value = 0;
+            for(int i = len; i > 0; i--) {
+                value = (value << 8  | (*(type + i)));
+            }
+
+            FDT_LOG("0x%"PRIx64"\n", value);
+        }
+        else if(*type == FDT_PROP_BYTES) {
+            uint32_t bytes_len = fdt_get_u32(type + 1);
+            
+            for(uint32_t i = 0; i < bytes_len && i < 16; i++) {
+                FDT_LOG("%02x ", *(type + 5 + i));
+            }
+            FDT_LOG("%s(%"PRIu32" bytes)\n", bytes_len > 16 ? "... " : "", bytes_len);
+        }
+        else if(*type == FDT_PROP_REF) {
+            const char *path = (const char*)(type + 2);
+            for(uint8_t i = 0; i < *(type + 1); i++) {
+                FDT_LOG("&%s ", path);
+                path += fdt_strlen(path) + 1;
+            }
+            FDT_LOG("\n");
+        }
+        else if(*type > FDT_PROP_ARRAY) {
+            uint8_t cell_size = 0;
+            uint32_t array_len = 0;
+            const uint8_t *cells = fdt_prop_get_cells(type, &cell_size, &array_len);
+            
+            for(uint32_t i = 0; cells && i < array_len; i++) {
+                uint64_t value = 0;
+                for(int j = cell_size; j > 0; j--) {
+                    value = (value << 8  | (*(cells + j - 1 + i * cell_size)));
+                }
+                FDT_LOG("0x%"PRIx64" ", value);
+            }
+            FDT_LOG("\n");
+        }
+    }
+}
+
+
+/**
+ * @brief debug print node and its children
+ * 
+ * @param node: node
+ * @param level: level of node
+ * @return none
+ * @note only used for debug
+ */
+static void __fdt_debug_put_node_info(fdt_node_t *node, int level)
+{
+    fdt_node_t *child = NULL;
+
+    fdt_node_materialize(node);
+    fdt_debug_put_node_prop(node, level);
+    
+    if(fdt_node_have_child(node)) {
+        fdt_list_for_each_entry(child, &node->child, fdt_node_t, entry) {
+            __fdt_debug_put_node_info(child, level + 1);
+        }
+    }
+}
+
+
+/**
+ * @brief debug print all node and property
+ * 
+ * @param node: node
+ * @return none
+ * @note only used for debug
+ */
+void fdt_debug_put_node_info(fdt_node_t *node)
+{
+    __fdt_debug_put_node_info(node, 0);
+}
+
+
+/**
+ * @brief Debug to get fdt number of bytes consumed
+ * @param none
+ * @return uint64_t number of bytes consumed
+ * @note only used for debug
+ */
+uint64_t fdt_debug_get_consume_bytes(void)
+{
+    return fdt_get_tree()->consume;
+}
+
+
+/**
+ * @brief lock lazy expansion of tree which the node belongs to
+ * 
+ * @param node: node
+ * @return fdt_tree_t*: tree, pass it to fdt_tree_unlock()
+ */
+static fdt_tree_t* fdt_node_lock_tree(fdt_node_t *node)
+{
+    while(node->parent != node) {
+        node = node->parent;
+    }
+
+    fdt_tree_t *tree = fdt_container_of(node, fdt_tree_t, root);
+    while(fdt_atomic_xchg(&tree->expand_lock, 1)) {
+        fdt_cpu_relax();
+    }
+
+    return tree;
+}
+
+
+/**
+ * @brief unlock lazy expansion of tree
+ * 
+ * @param tree: tree locked by fdt_node_lock_tree()
+ * @return none
+ */
+static inline void fdt_tree_unlock(fdt_tree_t *tree)
+{
+    fdt_atomic_store(&tree->expand_lock, 0);
+}
+
+
+/**
+ * @brief get bytes of one allocation of tree, arena allocations are aligned
+ * 
+ * @param tree: tree
+ * @param size: bytes requested
+ * @return uint64_t: bytes allocated
+ */
+static inline uint64_t fdt_tree_alloc_size(const fdt_tree_t *tree, size_t size)
+{
+    return tree->arena ? (size + 7) & ~(size_t)7 : size;
+}
+
+
+/**
+ * @brief get bytes of properties, index and children of node
+ * 
+ * @param tree: tree which the node belongs to, it is locked
+ * @param node: node
+ * @return uint64_t: bytes, the node itself is not included
+ */
+static uint64_t fdt_node_mem_bytes(const fdt_tree_t *tree, fdt_node_t *node)
+{
+    fdt_prop_t *prop = NULL;
+    fdt_node_t *child = NULL;
+    uint64_t bytes = 0;
+
+    if(node->index) {
+        bytes += fdt_tree_alloc_size(tree, sizeof(fdt_index_t) +
+                                     sizeof(void*) * (node->index->child_count + node->index->prop_count));
+    }
+
+    fdt_list_for_each_entry(prop, &node->prop, fdt_prop_t, node) {
+        if(*(const uint8_t*)prop->offset == FDT_PROP_REF) {
+            uint8_t count = *((const uint8_t*)prop->offset + 1);
+            bytes += fdt_tree_alloc_size(tree, sizeof(fdt_ref_prop_t) + sizeof(fdt_node_t*) * count);
+        }
+        else {
+            bytes += fdt_tree_alloc_size(tree, sizeof(fdt_prop_t));
+        }
+    }
+
+    fdt_list_for_each_entry(child, &node->child, fdt_node_t, entry) {
+        bytes += fdt_tree_alloc_size(tree, sizeof(fdt_node_t)) + fdt_node_mem_bytes(tree, child);
+    }
+
+    return bytes;
+}
+
+
+/**
+ * @brief get memory footprint of the loaded tree
+ * 
+ * @param stats: output
+ * @return int: 0: success, -1: fail
+ */
+int fdt_get_mem_stats(fdt_mem_stats_t *stats)
+{
+    if(stats == NULL) {
+        return -1;
+    }
+
+    fdt_tree_t *tree = fdt_node_lock_tree(fdt_get_root_node());
+
+    stats->node = tree->mem[FDT_MEM_NODE];
+    stats->prop = tree->mem[FDT_MEM_PROP];
+    stats->index = tree->mem[FDT_MEM_INDEX];
+    stats->table = tree->mem[FDT_MEM_TABLE];
+    stats->total = tree->consume;
+    stats->slack = stats->total - stats->node - stats->prop - stats->index - stats->table;
+
+    fdt_tree_unlock(tree);
+
+    stats->peak = fdt_atomic_load(&fdt_mem_peak);
+    stats->budget = fdt_mem_budget;
+    return 0;
+}
+
+
+/**
+ * @brief get bytes of node and its subtree
+ * 
+ * @param node: node
+ * @return uint64_t: bytes, 0 if node is NULL
+ * @note children of lazy nodes which are not created yet cost nothing
+ */
+uint64_t fdt_get_node_mem_bytes(fdt_node_t *node)
+{
+    if(node == NULL) {
+        return 0;
+    }
+
+    fdt_tree_t *tree = fdt_node_lock_tree(node);
+    uint64_t bytes = fdt_node_mem_bytes(tree, node);
+    if(node != &tree->root) {
+        bytes += fdt_tree_alloc_size(tree, sizeof(fdt_node_t));
+    }
+    fdt_tree_unlock(tree);
+
+    return bytes;
+}
+
+
+/**
+ * @brief reset high-water mark of memory to bytes held now
+ * 
+ * @param none
+ * @return none
+ */
+void fdt_reset_mem_peak(void)
+{
+    fdt_atomic_store(&fdt_mem_peak, fdt_atomic_load(&fdt_mem_held));
+}
+
+
+/**
+ * @brief debug print memory footprint and bytes of each top-level subtree
+ * 
+ * @param none
+ * @return none
+ * @note only used for debug
+ */
+void fdt_debug_put_mem_report(void)
+{
+    fdt_node_t *root = fdt_get_root_node();
+    fdt_node_t *child = NULL;
+    fdt_mem_stats_t stats;
+
+    fdt_node_materialize(root);
+    fdt_get_mem_stats(&stats);
+
+    FDT_LOG("memory: total %"PRIu64", peak %"PRIu64", budget %"PRIu64" bytes\n",
+            stats.total, stats.peak, stats.budget);
+    FDT_LOG("    node %"PRIu64", prop %"PRIu64", index %"PRIu64", table %"PRIu64", slack %"PRIu64" bytes\n",
+            stats.node, stats.prop, stats.index, stats.table, stats.slack);
+
+    uint64_t bytes = fdt_get_node_mem_bytes(root);
+    fdt_list_for_each_entry(child, &root->child, fdt_node_t, entry) {
+        bytes -= fdt_get_node_mem_bytes(child);
+    }
+    FDT_LOG("    /: %"PRIu64" bytes\n", bytes);
+
+    fdt_list_for_each_entry(child, &root->child, fdt_node_t, entry) {
+        FDT_LOG("    /%s: %"PRIu64" bytes\n", child->name, fdt_get_node_mem_bytes(child));
+    }
+}
+
+
+/**
+ * @brief get magic of dtb file
+ * 
+ * @param token: input token position of dtb file
+ * @return uint64_t: magic
+ */
+static uint64_t get_magic(uint8_t *token)
+{
+    uint64_t magic = 0;
+
+    magic = *(token ++);
+    magic |= (*(token ++) << 8);
+    magic |= (*(token ++) << 16);
+
+    return magic & 0xffffff;
+}
+
+
+/**
+ * @brief get version of dtb file
+ * 
+ * @param token: input token position of dtb file
+ * @return uint64_t: version number
+ */
+static uint64_t get_version(uint8_t *token)
+{
+    uint64_t version = 0;
+
+    version = *(token ++);
+    version |= (*(token ++) << 8);
+    version |= (*(token ++) << 16);
+
+    return version & 0xffffff;
+}
+
+
+/**
+ * @brief get name of node or property record
+ * 
+ * @param token: input token position of name field
+ * @param left: bytes left in dtb file from token
+ * @param flags: format flags of dtb file
+ * @param name: output name
+ * @param len: output length of name
+ * @param hash: output hash of name
+ * @return uint32_t: size of name field in bytes, 0 if name is too long,
+ *         not terminated or crosses the end of dtb file
+ */
+static uint32_t get_name(const uint8_t *token, uint64_t left, uint8_t flags, const char **name, uint16_t *len, uint16_t *hash)
+{
+    uint32_t name_len = 0;
+
+    *name = (const char*)token;
+    *len = 0;
+    *hash = 0;
+
+    if(flags & FDT_FLAG_NAME_HASH) {
+        if(left < 4 || (uint64_t)*token + 4 > left || *(token + 3 + *token) != 0) {
+            return 0;
+        }
+        *len = *token;
+        *hash = (uint16_t)(*(token + 1) | (*(token + 2) << 8));
+        *name = (const char*)(token + 3);
+        return *len + 4;
+    }
+
+    if(fdt_memchr(token, 0, left < 0x10000 ? left : 0x10000) == NULL) {
+        return 0;
+    }
+
+    *hash = fdt_hash_string(*name, &name_len);
+    *len = (uint16_t)name_len;
+    return name_len + 1;
+}
+
+
+/**
+ * @brief decode property value for walk callbacks
+ * 
+ * @param value: property value, the first byte is type
+ * @param prop: output property
+ * @return none
+ */
+static void fdt_walk_decode_prop(const uint8_t *value, fdt_walk_prop_t *prop)
+{
+    uint8_t type = *value;
+
+    prop->value = value;
+    prop->string = NULL;
+    prop->integer = 0;
+    prop->data = NULL;
+    prop->cell_size = 0;
+    prop->count = 0;
+
+    if(type == FDT_PROP_STRING) {
+        prop->type = FDT_PROP_STRING;
+        prop->string = (const char*)(value + 1);
+    }
+    else if(type == FDT_PROP_BYTES) {
+        prop->type = FDT_PROP_BYTES;
+        prop->data = value + 5;
+        prop->cell_size = 1;
+        prop->count = fdt_get_u32(value + 1);
+    }
+    else if(type == FDT_PROP_REF) {
+        prop->type = FDT_PROP_REF;
+        prop->string = (const char*)(value + 2);
+        prop->data = value + 2;
+        prop->count = *(value + 1);
+    }
+    else {
+        prop->data = fdt_prop_get_cells(value, &prop->cell_size, &prop->count);
+        prop->type = (type < FDT_PROP_ARRAY) ? FDT_PROP_INT : FDT_PROP_ARRAY;
+    }
+
+    if(prop->type == FDT_PROP_INT) {
+        for(uint8_t i = 0; i < prop->cell_size && i < 8; i++) {
+            prop->integer |= (uint64_t)prop->data[i] << (i * 8);
+        }
+    }
+}
+
+
+/**
+ * @brief close open nodes down to a level
+ * 
+ * @param ops: callbacks
+ * @param ctx: user context
+ * @param open_level: level of the deepest open node, it is updated
+ * @param level: the lowest level to close
+ * @return int: callback result
+ */
+static int fdt_walk_end_nodes(const fdt_walk_ops_t *ops, void *ctx, int *open_level, int level)
+{
+    int ret = FDT_WALK_CONTINUE;
+
+    for(; *open_level >= level; (*open_level) --) {
+        if(ops->end_node) {
+            ret = ops->end_node(ctx, (uint8_t)*open_level);
+            if(ret < 0 || ret == FDT_WALK_STOP) {
+                return ret;
+            }
+        }
+    }
+
+    return FDT_WALK_CONTINUE;
+}
+
+
+/**
+ * @brief get subtree sizes following node name
+ * 
+ * @param token: input token position after node name
+ * @param flags: format flags of dtb file
+ * @param left: bytes left in dtb file from token
+ * @param node: output node
+ * @return uint32_t: size of the fields in bytes, 0 if they are invalid
+ */
+static uint32_t get_subtree_size(const uint8_t *token, uint8_t flags, uint64_t left, fdt_walk_node_t *node)
+{
+    node->size = 0;
+    node->prop_size = 0;
+
+    if(!(flags & FDT_FLAG_SUBTREE_SIZE)) {
+        return 0;
+    }
+
+    if(left < 8) {
+        return 0;
+    }
+
+    node->size = fdt_get_u32(token);
+    node->prop_size = fdt_get_u32(token + 4);
+    if(node->size > left - 8 || node->prop_size > node->size) {
+        return 0;
+    }
+
+    return 8;
+}
+
+
+/**
+ * @brief check header and root node of dtb file
+ * 
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @param flags: output format flags
+ * @param pos: output position after root node
+ * @param root: output root node
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_blob_root(const void *dtb, const uint64_t dtb_size, uint8_t *flags, uint64_t *pos, fdt_walk_node_t *root)
+{
+    uint8_t *token = (uint8_t*)dtb;
+    uint64_t magic = 0;
+    uint32_t name_size = 0;
+    uint32_t size_size = 0;
+
+    *flags = 0;
+    if(dtb_size >= 7) {
+        magic = get_magic(token);
+        *flags = (magic == FDT_MAGIC_EXT) ? *(token + 6) : 0;
+    }
+
+    size_size = (*flags & FDT_FLAG_SUBTREE_SIZE) ? 8 : 0;
+    *pos = (magic == FDT_MAGIC_EXT) ? 7 : 6;
+    *pos += (*flags & FDT_FLAG_CRC32) ? 8 : 0;
+    if(dtb_size < *pos + ((*flags & FDT_FLAG_NAME_HASH) ? 6 : 3) + size_size ||
+       (magic != FDT_MAGIC && magic != FDT_MAGIC_EXT)) {
+        FDT_LOG_ERROR("magic error: invalid dtb file\n");
+        return -1;
+    }
+
+    if(*flags & ~FDT_FLAG_MASK) {
+        FDT_LOG_ERROR("unsupported dtb flags: 0x%x\n", *flags);
+        return -1;
+    }
+
+    token += *pos;
+
+    name_size = get_name(token + 1, dtb_size - *pos - 1, *flags, &root->name, &root->name_len, &root->hash);
+    if(*token != 0 || name_size == 0 || root->name_len != 1 || *root->name != '/') {
+        FDT_LOG_ERROR("invalid dtb file\n");
+        return -1;
+    }
+
+    token += name_size + 1; *pos += name_size + 1; //skip magic and version and root node name '/'
+
+    if(get_subtree_size(token, *flags, dtb_size - *pos, root) != size_size) {
+        FDT_LOG_ERROR("invalid subtree size\n");
+        return -1;
+    }
+    *pos += size_size;
+    root->level = 0;
+
+    return 0;
+}
+
+
+/**
+ * @brief verify checksum of dtb file, if it has FDT_FLAG_CRC32
+ * 
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @return int: 0: success or no checksum, -1: fail or blob size differs
+ * @note a broken header is left to fdt_blob_root()
+ */
+static int fdt_blob_verify(const void *dtb, const uint64_t dtb_size)
+{
+    uint8_t *data = (uint8_t*)dtb;
+
+    if(dtb_size < 15 || get_magic(data) != FDT_MAGIC_EXT || !(data[6] & FDT_FLAG_CRC32)) {
+        return 0;
+    }
+
+    // blob size and crc follow the flags byte, crc covers the rest of blob,
+    // the tree is built from dtb_size, so a size that differs is rejected
+    uint32_t size = fdt_get_u32(data + 7);
+    uint32_t crc = fdt_get_u32(data + 11);
+    if(size != dtb_size) {
+        FDT_LOG_ERROR("dtb checksum size error: %"PRIu32", expected %"PRIu64"\n", size, dtb_size);
+        return -1;
+    }
+
+    uint32_t actual = fdt_crc32(0, data + 15, size - 15);
+    if(actual != crc) {
+        FDT_LOG_ERROR("dtb checksum error: 0x%08"PRIx32", expected 0x%08"PRIx32"\n", actual, crc);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief walk records of dtb file in a range, it starts after the root node
+ *        or at a top-level node
+ * 
+ * @param dtb: dtb file
+ * @param pos: position of the first record
+ * @param end: end of the range
+ * @param flags: format flags of dtb file
+ * @param node_end: end of the root node, with FDT_FLAG_SUBTREE_SIZE
+ * @param ret: result of begin_node callback of the root node
+ * @param ops: callbacks
+ * @param ctx: user context
+ * @return int: 0: success, FDT_WALK_STOP: stopped by callback, -1: fail
+ */
+static int fdt_walk_records(const void *dtb, uint64_t pos, const uint64_t end, uint8_t flags, uint64_t node_end,
+                            int ret, const fdt_walk_ops_t *ops, void *ctx)
+{
+    uint8_t *token = (uint8_t*)dtb + pos;
+    int level = 0;          // level of last node record
+    int open_level = 0;     // level of the deepest node reported to callbacks
+    int skip_level = -1;    // nodes deeper than it are skipped, -1 if not skipping
+    uint32_t name_size = 0;
+    uint32_t size_size = (flags & FDT_FLAG_SUBTREE_SIZE) ? 8 : 0;
+    fdt_walk_node_t node;
+    fdt_walk_prop_t prop;
+
+    while(pos < end) {
+        if(ret < 0) {
+            return -1;
+        }
+        else if(ret == FDT_WALK_STOP) {
+            return FDT_WALK_STOP;
+        }
+        else if(ret == FDT_WALK_SKIP && skip_level < 0) {
+            // properties only follow the last node begun, it is the one to skip
+            skip_level = open_level;
+            if(size_size) {
+                token += node_end - pos;
+                pos = node_end;
+                continue;
+            }
+        }
+        ret = FDT_WALK_CONTINUE;
+
+        if(*token == 0xff) {
+            // property
+            token ++;
+
+            name_size = get_name(token, end - pos - 1, flags, &prop.name, &prop.name_len, &prop.hash);
+            if(name_size == 0) {
+                FDT_LOG_ERROR("invalid property name\n");
+                return -1;
+            }
+            token += name_size;
+            pos += name_size + 1;
+
+            uint64_t value_size = fdt_prop_value_size(token, end - pos);
+            if(value_size == 0) {
+                FDT_LOG_ERROR("invalid property type: 0x%x\n", *token);
+                return -1;
+            }
+
+            if(skip_level < 0 && ops->prop) {
+                fdt_walk_decode_prop(token, &prop);
+                prop.size = (uint32_t)value_size;
+                ret = ops->prop(ctx, &prop);
+            }
+
+            token += value_size;
+            pos += value_size;
+        }
+        else {
+            // node begin
+            if(*token == 0 || *token > level + 1) {
+                FDT_LOG_ERROR("invalid node level: %d\n", *token);
+                return -1;
+            }
+            level = *token;
+
+            token ++;
+            name_size = get_name(token, end - pos - 1, flags, &node.name, &node.name_len, &node.hash);
+            if(name_size == 0) {
+                FDT_LOG_ERROR("invalid node name\n");
+                return -1;
+            }
+            token += name_size;
+            pos += (name_size + 1);
+
+            if(get_subtree_size(token, flags, end - pos, &node) != size_size) {
+                FDT_LOG_ERROR("invalid subtree size\n");
+                return -1;
+            }
+            token += size_size; pos += size_size;
+            node_end = pos + node.size;
+
+            if(skip_level >= 0) {
+                if(level > skip_level) {
+                    continue;
+                }
+                skip_level = -1;
+            }
+
+            ret = fdt_walk_end_nodes(ops, ctx, &open_level, level);
+            if(ret != FDT_WALK_CONTINUE) {
+                continue;
+            }
+
+            open_level = level;
+            node.level = (uint8_t)level;
+            if(ops->begin_node) {
+                ret = ops->begin_node(ctx, &node);
+            }
+        }
+    }
+
+    if(ret < 0) {
+        return -1;
+    }
+    else if(ret == FDT_WALK_STOP) {
+        return FDT_WALK_STOP;
+    }
+
+    ret = fdt_walk_end_nodes(ops, ctx, &open_level, 0);
+    if(ret < 0) {
+        return -1;
+    }
+
+    return ret == FDT_WALK_STOP ? FDT_WALK_STOP : 0;
+}
+
+
+/**
+ * @brief walk blob data of dtb file
+ * 
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @param ops: callbacks
+ * @param ctx: user context
+ * @return int: 0: success, FDT_WALK_STOP: stopped by callback, -1: fail
+ */
+int fdt_walk(const void *dtb, const uint64_t dtb_size, const fdt_walk_ops_t *ops, void *ctx)
+{
+    uint64_t pos = 0;
+    uint8_t flags = 0;
+    fdt_walk_node_t root;
+    int ret = FDT_WALK_CONTINUE;
+
+    if(fdt_blob_root(dtb, dtb_size, &flags, &pos, &root)) {
+        return -1;
+    }
+
+    if(ops->begin_node) {
+        ret = ops->begin_node(ctx, &root);
+    }
+
+    return fdt_walk_records(dtb, pos, dtb_size, flags, pos + root.size, ret, ops, ctx);
+}
+
+
+/**
+ * @brief state of in-place property lookup
+ * @path: node path.
+ * @pos: position of next segment in path.
+ * @seg: segment expected at the next level, NULL if the node is matched.
+ * @seg_len: length of segment.
+ * @level: level of the deepest matched node.
+ * @name: property name.
+ * @prop: output property.
+ * @found: property is found.
+ */
+typedef struct fdt_blob_find {
+    const char *path;
+    size_t pos;
+    const char *seg;
+    size_t seg_len;
+    int level;
+    const char *name;
+    fdt_walk_prop_t *prop;
+    bool found;
+
+}fdt_blob_find_t;
+
+
+/**
+ * @brief move to next segment of path
+ * 
+ * @param find: lookup state
+ * @return none
+ */
+static void fdt_blob_find_next_segment(fdt_blob_find_t *find)
+{
+    const char *path = find->path;
+    size_t pos = find->pos;
+
+    while(path[pos] == '/' || path[pos] == ' ') {
+        pos ++;
+    }
+
+    find->seg = path[pos] ? path + pos : NULL;
+    while(path[pos] && path[pos] != '/') {
+        pos ++;
+    }
+
+    find->seg_len = find->seg ? (size_t)(path + pos - find->seg) : 0;
+    find->pos = pos;
+}
+
+
+/**
+ * @brief match node against path, other subtrees are skipped
+ * 
+ * @param ctx: lookup state
+ * @param node: node in blob
+ * @return int: walk return code
+ */
+static int fdt_blob_find_begin_node(void *ctx, const fdt_walk_node_t *node)
+{
+    fdt_blob_find_t *find = ctx;
+
+    if(node->level == 0) {
+        find->level = 0;
+        fdt_blob_find_next_segment(find);
+        return FDT_WALK_CONTINUE;
+    }
+
+    // left the matched subtree, or children of the matched node begin
+    if(node->level <= find->level || find->seg == NULL) {
+        return FDT_WALK_STOP;
+    }
+
+    if(!fdt_name_equal_segment(node->name, find->seg, find->seg_len)) {
+        return FDT_WALK_SKIP;
+    }
+
+    find->level = node->level;
+    fdt_blob_find_next_segment(find);
+    return FDT_WALK_CONTINUE;
+}
+
+
+/**
+ * @brief match property of the matched node
+ * 
+ * @param ctx: lookup state
+ * @param prop: property in blob
+ * @return int: walk return code
+ */
+static int fdt_blob_find_prop_cb(void *ctx, const fdt_walk_prop_t *prop)
+{
+    fdt_blob_find_t *find = ctx;
+
+    if(find->seg != NULL || fdt_strcmp(prop->name, find->name) != 0) {
+        return FDT_WALK_CONTINUE;
+    }
+
+    *find->prop = *prop;
+    find->found = true;
+    return FDT_WALK_STOP;
+}
+
+
+/**
+ * @brief find property in blob without loading it
+ * 
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @param node_path: node path
+ * @param name: property name
+ * @param prop: output property
+ * @return int: 0: success, -1: fail
+ */
+int fdt_blob_find_prop(const void *dtb, const uint64_t dtb_size, const char *node_path, const char *name,
+                       fdt_walk_prop_t *prop)
+{
+    static const fdt_walk_ops_t ops = {
+        .begin_node = fdt_blob_find_begin_node,
+        .prop = fdt_blob_find_prop_cb,
+    };
+    fdt_blob_find_t find = {0};
+
+    find.path = node_path;
+    find.name = name;
+    find.prop = prop;
+
+    if(fdt_walk(dtb, dtb_size, &ops, &find) < 0 || !find.found) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief compact tree builder state of fdt_walk() callbacks
+ * @dtb: dtb file.
+ * @node: output nodes, NULL if only counting.
+ * @prop: output properties.
+ * @node_count: number of nodes.
+ * @prop_count: number of properties.
+ * @open: index of open node at each level.
+ * @last: index of the last child of open node at each level, 0 if none.
+ */
+typedef struct fdt_compact_builder {
+    const uint8_t *dtb;
+    fdt_compact_node_t *node;
+    fdt_compact_prop_t *prop;
+    uint32_t node_count;
+    uint32_t prop_count;
+    uint16_t open[256];
+    uint16_t last[256];
+
+}fdt_compact_builder_t;
+
+
+/**
+ * @brief add node to compact tree
+ * 
+ * @param ctx: compact tree builder
+ * @param walk_node: node in blob
+ * @return int: FDT_WALK_CONTINUE, -1 if fail
+ */
+static int fdt_compact_build_begin_node(void *ctx, const fdt_walk_node_t *walk_node)
+{
+    fdt_compact_builder_t *builder = ctx;
+    uint8_t level = walk_node->level;
+    uint16_t index = (uint16_t)builder->node_count;
+
+    if(builder->node_count >= 0xffff) {
+        FDT_LOG_ERROR("too many nodes for compact tree\n");
+        return -1;
+    }
+
+    if(builder->node) {
+        fdt_compact_node_t *node = &builder->node[index];
+        uint16_t parent = level ? builder->open[level - 1] : 0;
+
+        node->name = (uint16_t)((const uint8_t*)walk_node->name - builder->dtb);
+        node->hash = walk_node->hash;
+        node->parent = parent;
+        node->child = 0;
+        node->next = 0;
+        node->prop = (uint16_t)builder->prop_count;
+        node->prop_count = 0;
+
+        if(level) {
+            if(builder->last[level - 1]) {
+                builder->node[builder->last[level - 1]].next = index;
+            }
+            else {
+                builder->node[parent].child = index;
+            }
+            builder->last[level - 1] = index;
+        }
+    }
+
+    builder->open[level] = index;
+    builder->last[level] = 0;
+    builder->node_count ++;
+
+    return FDT_WALK_CONTINUE;
+}
+
+
+/**
+ * @brief add property to compact tree, it belongs to the last node
+ * 
+ * @param ctx: compact tree builder
+ * @param walk_prop: property in blob
+ * @return int: FDT_WALK_CONTINUE, -1 if fail
+ */
+static int fdt_compact_build_prop(void *ctx, const fdt_walk_prop_t *walk_prop)
+{
+    fdt_compact_builder_t *builder = ctx;
+
+    if(builder->prop_count >= 0xffff) {
+        FDT_LOG_ERROR("too many properties for compact tree\n");
+        return -1;
+    }
+
+    if(builder->node) {
+        fdt_compact_prop_t *prop = &builder->prop[builder->prop_count];
+
+        prop->name = (uint16_t)((const uint8_t*)walk_prop->name - builder->dtb);
+        prop->hash = walk_prop->hash;
+        prop->value = (uint16_t)((const uint8_t*)walk_prop->value - builder->dtb);
+        builder->node[builder->node_count - 1].prop_count ++;
+    }
+
+    builder->prop_count ++;
+
+    return FDT_WALK_CONTINUE;
+}
+
+
+/**
+ * @brief build compact tree of dtb file
+ * 
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @param buf: output buffer, NULL if only size is needed
+ * @param cap: output buffer size
+ * @param size: output size of compact tree
+ * @return int: 0: success, -1: fail
+ */
+int fdt_compact_build(const void *dtb, const uint64_t dtb_size, void *buf, uint32_t cap, uint32_t *size)
+{
+    static const fdt_walk_ops_t ops = {
+        .begin_node = fdt_compact_build_begin_node,
+        .prop = fdt_compact_build_prop,
+    };
+    fdt_compact_builder_t builder;
+    fdt_walk_node_t root;
+    uint64_t pos = 0;
+    uint32_t crc = 0;
+    uint8_t flags = 0;
+
+    if(dtb_size > 0xffff) {
+        FDT_LOG_ERROR("dtb file is too large for compact tree\n");
+        return -1;
+    }
+
+    if(fdt_blob_root(dtb, dtb_size, &flags, &pos, &root)) {
+        return -1;
+    }
+
+    // count first, properties follow all nodes
+    fdt_memset(&builder, 0, sizeof(builder));
+    builder.dtb = dtb;
+    if(fdt_walk(dtb, dtb_size, &ops, &builder)) {
+        return -1;
+    }
+
+    *size = sizeof(fdt_compact_t) + sizeof(fdt_compact_node_t) * builder.node_count +
+            sizeof(fdt_compact_prop_t) * builder.prop_count;
+    if(buf == NULL) {
+        return 0;
+    }
+
+    if(cap < *size) {
+        FDT_LOG_ERROR("compact tree needs %u bytes\n", *size);
+        return -1;
+    }
+
+    fdt_compact_t *ct = buf;
+    ct->magic = FDT_COMPACT_MAGIC;
+    ct->flags = flags;
+    ct->blob_size = (uint16_t)dtb_size;
+    ct->node_count = (uint16_t)builder.node_count;
+    ct->prop_count = (uint16_t)builder.prop_count;
+    crc = fdt_crc32(0, dtb, dtb_size);
+    ct->crc[0] = (uint16_t)crc;
+    ct->crc[1] = (uint16_t)(crc >> 16);
+
+    fdt_memset(&builder, 0, sizeof(builder));
+    builder.dtb = dtb;
+    builder.node = (fdt_compact_node_t*)(ct + 1);
+    builder.prop = (fdt_compact_prop_t*)(builder.node + ct->node_count);
+
+    return fdt_walk(dtb, dtb_size, &ops, &builder) ? -1 : 0;
+}
+
+
+/**
+ * @brief check that compact tree is built from dtb file
+ * 
+ * @param ct: compact tree
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @return int: 0: match, -1: not match
+ */
+int fdt_compact_check(const fdt_compact_t *ct, const void *dtb, const uint64_t dtb_size)
+{
+    fdt_walk_node_t root;
+    uint64_t pos = 0;
+    uint32_t crc = 0;
+    uint8_t flags = 0;
+
+    if(ct->magic != FDT_COMPACT_MAGIC || ct->blob_size != dtb_size || ct->node_count == 0 ||
+       fdt_blob_root(dtb, dtb_size, &flags, &pos, &root) || ct->flags != flags) {
+        return -1;
+    }
+
+    crc = fdt_crc32(0, dtb, dtb_size);
+    if(ct->crc[0] != (uint16_t)crc || ct->crc[1] != (uint16_t)(crc >> 16)) {
+        return -1;
+    }
+
+    return fdt_compact_node_name(ct, dtb, 0) == root.name ? 0 : -1;
+}
+
+
+/**
+ * @brief find node of compact tree by path
+ * 
+ * @param ct: compact tree
+ * @param dtb: dtb file
+ * @param path: node path
+ * @return int: index of node, -1 if not found
+ */
+int fdt_compact_find_node(const fdt_compact_t *ct, const void *dtb, const char *path)
+{
+    const fdt_compact_node_t *nodes = fdt_compact_nodes(ct);
+    uint32_t node = 0;
+    size_t pos = 0;
+
+    while(path[pos]) {
+        if(path[pos] == '/' || path[pos] == ' ') {
+            pos ++;
+            continue;
+        }
+
+        size_t seg = pos;
+        while(path[pos] && path[pos] != '/') {
+            pos ++;
+        }
+
+        uint32_t name_len = 0;
+        uint16_t hash = fdt_hash_segment(path + seg, pos - seg, &name_len);
+        uint32_t child = 0;
+
+        fdt_compact_for_each_child(ct, node, child) {
+            if(nodes[child].hash == hash &&
+               fdt_name_equal_segment((const char*)dtb + nodes[child].name, path + seg, pos - seg)) {
+                break;
+            }
+        }
+
+        if(child == 0) {
+            return -1;
+        }
+        node = child;
+    }
+
+    return (int)node;
+}
+
+
+/**
+ * @brief find property of compact tree node
+ * 
+ * @param ct: compact tree
+ * @param dtb: dtb file
+ * @param node: index of node
+ * @param name: property name
+ * @param prop: output property
+ * @return int: 0: success, -1: fail
+ */
+int fdt_compact_find_prop(const fdt_compact_t *ct, const void *dtb, uint32_t node, const char *name, fdt_walk_prop_t *prop)
+{
+    if(node >= ct->node_count) {
+        return -1;
+    }
+
+    const fdt_compact_node_t *owner = &fdt_compact_nodes(ct)[node];
+    const fdt_compact_prop_t *props = fdt_compact_props(ct) + owner->prop;
+    uint32_t name_len = 0;
+    uint16_t hash = fdt_hash_string(name, &name_len);
+
+    for(uint32_t i = 0; i < owner->prop_count; i++) {
+        const char *prop_name = (const char*)dtb + props[i].name;
+
+        if(props[i].hash != hash || fdt_strcmp(prop_name, name) != 0) {
+            continue;
+        }
+
+        const uint8_t *value = (const uint8_t*)dtb + props[i].value;
+        fdt_walk_decode_prop(value, prop);
+        prop->name = prop_name;
+        prop->name_len = (uint16_t)name_len;
+        prop->hash = hash;
+        prop->size = (uint32_t)fdt_prop_value_size(value, ct->blob_size - props[i].value);
+        return 0;
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief tree builder state of fdt_walk() callbacks
+ * @tree: tree being built.
+ * @node: current node.
+ * @merge: blob is a layer over the tree, its nodes and properties with the
+ *         name of an existing one are merged into it, see fdt_tree_merge().
+ */
+typedef struct fdt_tree_builder {
+    fdt_tree_t *tree;
+    fdt_node_t *node;
+    bool merge;
+
+}fdt_tree_builder_t;
+
+
+/**
+ * @brief find child node of tree being built by exact name
+ * 
+ * @param node: node
+ * @param name: name in blob
+ * @param len: length of name
+ * @param hash: hash of name
+ * @return fdt_node_t*: child, NULL if not found
+ */
+static fdt_node_t* fdt_tree_build_find_child(fdt_node_t *node, const char *name, uint16_t len, uint16_t hash)
+{
+    fdt_node_t *child = NULL;
+
+    fdt_list_for_each_entry(child, &node->child, fdt_node_t, entry) {
+        if(child->hash == hash && child->name_len == len && fdt_memcmp(child->name, name, len) == 0) {
+            return child;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief find property of tree being built by exact name
+ * 
+ * @param node: node
+ * @param name: name in blob
+ * @param len: length of name
+ * @param hash: hash of name
+ * @return fdt_prop_t*: property, NULL if not found
+ */
+static fdt_prop_t* fdt_tree_build_find_prop(fdt_node_t *node, const char *name, uint16_t len, uint16_t hash)
+{
+    fdt_prop_t *prop = NULL;
+
+    fdt_list_for_each_entry(prop, &node->prop, fdt_prop_t, node) {
+        if(prop->hash == hash && prop->name_len == len && fdt_memcmp(prop->name, name, len) == 0) {
+            return prop;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief free property of tree being built which is replaced by a layer
+ * 
+ * @param tree: tree being built
+ * @param prop: property, it is not in the tree any more
+ * @return none
+ * @note in arena it is left as slack until the tree is cleared
+ */
+static void fdt_tree_build_drop_prop(fdt_tree_t *tree, fdt_prop_t *prop)
+{
+    size_t size = sizeof(fdt_prop_t);
+
+    if(*(const uint8_t*)prop->offset == FDT_PROP_REF) {
+        fdt_ref_prop_t *ref = fdt_container_of(prop, fdt_ref_prop_t, prop);
+        fdt_ref_prop_t **link = &tree->refs;
+
+        while(*link != ref) {
+            link = &(*link)->next;
+        }
+        *link = ref->next;
+        size = sizeof(fdt_ref_prop_t) + sizeof(fdt_node_t*) * ref->count;
+    }
+
+    if(tree->arena == NULL) {
+        fdt_mem_free(prop);
+        fdt_mem_release(tree, size);
+        tree->mem[FDT_MEM_PROP] -= size;
+    }
+}
+
+
+/**
+ * @brief create node of tree being built
+ * 
+ * @param ctx: tree builder
+ * @param walk_node: node in blob
+ * @return int: FDT_WALK_CONTINUE, -1 if fail
+ */
+static int fdt_tree_build_begin_node(void *ctx, const fdt_walk_node_t *walk_node)
+{
+    fdt_tree_builder_t *builder = ctx;
+    fdt_tree_t *tree = builder->tree;
+
+    if(walk_node->level == 0) {
+        builder->node = &tree->root;
+        return FDT_WALK_CONTINUE;
+    }
+
+    if(builder->merge) {
+        fdt_node_t *node = fdt_tree_build_find_child(builder->node, walk_node->name, walk_node->name_len, walk_node->hash);
+        if(node) {
+            builder->node = node;
+            return FDT_WALK_CONTINUE;
+        }
+    }
+
+    fdt_node_t *node = fdt_node_create(tree, walk_node->name, walk_node->name_len, walk_node->hash);
+    if(node == NULL) {
+        FDT_LOG_ERROR("create node failed\n");
+        return -1;
+    }
+
+    fdt_node_add_child(builder->node, node);
+    builder->node = node;
+
+    if(tree->phash && tree->node_count < tree->phash->node.total) {
+        tree->phash_nodes[tree->node_count] = node;
+    }
+    tree->node_count ++;
+
+    return FDT_WALK_CONTINUE;
+}
+
+
+/**
+ * @brief create property of tree being built
+ * 
+ * @param ctx: tree builder
+ * @param walk_prop: property in blob
+ * @return int: FDT_WALK_CONTINUE, -1 if fail
+ */
+static int fdt_tree_build_prop(void *ctx, const fdt_walk_prop_t *walk_prop)
+{
+    fdt_tree_builder_t *builder = ctx;
+    fdt_tree_t *tree = builder->tree;
+    fdt_prop_t *old = NULL;
+
+    if(builder->merge) {
+        old = fdt_tree_build_find_prop(builder->node, walk_prop->name, walk_prop->name_len, walk_prop->hash);
+    }
+
+    // a plain value overrides a plain value in place, a reference needs its target slots
+    if(old && *(const uint8_t*)old->offset != FDT_PROP_REF && walk_prop->type != FDT_PROP_REF) {
+        old->name = walk_prop->name;
+        old->offset = walk_prop->value;
+        return FDT_WALK_CONTINUE;
+    }
+
+    fdt_prop_t *prop = fdt_prop_create(tree, walk_prop->name, walk_prop->name_len, walk_prop->hash, (void*)walk_prop->value);
+    if(prop == NULL) {
+        FDT_LOG_ERROR("create string prop failed");
+        return -1;
+    }
+    if(old) {
+        fdt_list_replace_node(&old->node, &prop->node);
+        fdt_tree_build_drop_prop(tree, old);
+    }
+    else {
+        fdt_node_append_prop(builder->node, prop);
+    }
+
+    if(tree->phash && tree->prop_count < tree->phash->prop.total) {
+        tree->phash_props[tree->prop_count] = prop;
+    }
+    tree->prop_count ++;
+
+    return FDT_WALK_CONTINUE;
+}
+
+
+/**
+ * @brief finish node of tree being built
+ * 
+ * @param ctx: tree builder
+ * @param level: node level
+ * @return int: FDT_WALK_CONTINUE
+ */
+static int fdt_tree_build_end_node(void *ctx, uint8_t level)
+{
+    fdt_tree_builder_t *builder = ctx;
+
+    if(level > 0) {
+        builder->node = builder->node->parent;
+    }
+
+    return FDT_WALK_CONTINUE;
+}
+
+
+/**
+ * @brief build tree from blob data of dtb file
+ * 
+ * @param tree: empty tree, it is not visible to readers
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_tree_build(fdt_tree_t *tree, const void *dtb, const uint64_t dtb_size)
+{
+    static const fdt_walk_ops_t ops = {
+        .begin_node = fdt_tree_build_begin_node,
+        .prop = fdt_tree_build_prop,
+        .end_node = fdt_tree_build_end_node,
+    };
+    fdt_tree_builder_t builder = {tree, &tree->root, false};
+
+    if(fdt_walk(dtb, dtb_size, &ops, &builder)) {
+        return -1;
+    }
+
+    tree->version = get_version((uint8_t*)dtb + 3);
+    return 0;
+}
+
+
+/**
+ * @brief merge a layer blob into tree being built, no data is copied
+ * 
+ * @param tree: tree built from lower layers, it is not visible to readers
+ * @param dtb: dtb file of layer
+ * @param dtb_size: dtb file size
+ * @return int: 0: success, -1: fail
+ * @note a node with the name of an existing child is merged into it, a property
+ *       with the name of an existing one replaces its value and keeps its place,
+ *       others are added after existing ones. Version of tree is the layer's.
+ */
+static int fdt_tree_merge(fdt_tree_t *tree, const void *dtb, const uint64_t dtb_size)
+{
+    static const fdt_walk_ops_t ops = {
+        .begin_node = fdt_tree_build_begin_node,
+        .prop = fdt_tree_build_prop,
+        .end_node = fdt_tree_build_end_node,
+    };
+    fdt_tree_builder_t builder = {tree, &tree->root, true};
+
+    if(fdt_walk(dtb, dtb_size, &ops, &builder)) {
+        return -1;
+    }
+
+    tree->version = get_version((uint8_t*)dtb + 3);
+    return 0;
+}
+
+
+/**
+ * @brief resolve reference properties created by loader
+ * 
+ * @param tree: tree being built
+ * @return int: 0: success, -1: a referenced node is not found
+ */
+static int fdt_tree_resolve_refs(fdt_tree_t *tree)
+{
+    for(fdt_ref_prop_t *ref = tree->refs; ref; ref = ref->next) {
+        for(uint32_t i = 0; i < ref->count; i++) {
+            const char *path = fdt_prop_get_ref_path(ref->prop.offset, i);
+
+            ref->target[i] = __fdt_find_node_by_path(&tree->root, path, (size_t)-1);
+            if(ref->target[i] == NULL) {
+                FDT_LOG_ERROR("unresolved reference %s of %s\n", path, ref->prop.name);
+                return -1;
+            }
+        }
+    }
+
+    tree->refs = NULL;
+    return 0;
+}
+
+
+/**
+ * @brief build alias table from string properties of /aliases
+ * 
+ * @param tree: tree being built
+ * @return int: 0: success, -1: fail
+ * @note aliases of eager tree are resolved here, those of lazy tree on first use.
+ *       An alias to a missing node is kept and not found.
+ */
+static int fdt_tree_build_aliases(fdt_tree_t *tree)
+{
+    fdt_node_t *aliases = find_node_by_segment(&tree->root, "aliases", 7);
+    fdt_prop_t *prop = NULL;
+    uint32_t count = 0;
+    uint32_t size = 2;
+
+    if(aliases == NULL) {
+        return 0;
+    }
+    if(fdt_node_materialize(aliases)) {
+        return -1;
+    }
+
+    fdt_list_for_each_entry(prop, &aliases->prop, fdt_prop_t, node) {
+        count += *(const uint8_t*)prop->offset == FDT_PROP_STRING;
+    }
+    while(size < count * 2) {
+        size <<= 1;
+    }
+
+    if(fdt_mem_check_budget(tree, size * sizeof(fdt_alias_t))) {
+        return -1;
+    }
+
+    fdt_alias_t *table = fdt_mem_alloc(size * sizeof(fdt_alias_t));
+    if(table == NULL) {
+        FDT_LOG_ERROR("alias malloc failed\n");
+        return -1;
+    }
+    fdt_memset(table, 0, size * sizeof(fdt_alias_t));
+    fdt_mem_hold(tree, size * sizeof(fdt_alias_t));
+    tree->mem[FDT_MEM_TABLE] += size * sizeof(fdt_alias_t);
+
+    fdt_list_for_each_entry(prop, &aliases->prop, fdt_prop_t, node) {
+        if(*(const uint8_t*)prop->offset != FDT_PROP_STRING) {
+            continue;
+        }
+
+        uint32_t slot = prop->hash & (size - 1);
+        while(table[slot].name) {
+            slot = (slot + 1) & (size - 1);
+        }
+
+        fdt_alias_t *alias = &table[slot];
+        alias->name = prop->name;
+        alias->path = (const char*)prop->offset + 1;
+        alias->hash = prop->hash;
+        alias->name_len = prop->name_len;
+        if(tree->blob == NULL) {
+            alias->node = __fdt_find_node_by_path(&tree->root, alias->path, (size_t)-1);
+        }
+    }
+
+    tree->aliases = table;
+    tree->alias_mask = size - 1;
+    return 0;
+}
+
+
+/**
+ * @brief create properties and children of lazy node from blob, children
+ *        are created lazy and their subtrees are skipped
+ * 
+ * @param tree: tree which the node belongs to
+ * @param node: lazy node
+ * @param level: level of node
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_node_expand_locked(fdt_tree_t *tree, fdt_node_t *node, uint32_t level)
+{
+    const uint8_t *token = node->lazy;
+    const uint8_t *end = tree->blob + tree->blob_size;
+    uint32_t size_size = (tree->flags & FDT_FLAG_SUBTREE_SIZE) ? 8 : 0;
+    bool in_children = false;
+    const char *name = NULL;
+    uint16_t name_len = 0;
+    uint16_t hash = 0;
+
+    while(token < end) {
+        if(*token == 0xff) {
+            uint32_t name_size = get_name(token + 1, end - token - 1, tree->flags, &name, &name_len, &hash);
+            const uint8_t *value = token + 1 + name_size;
+            uint64_t value_size = name_size ? fdt_prop_value_size(value, end - value) : 0;
+            if(value_size == 0) {
+                FDT_LOG_ERROR("invalid property: %s\n", name);
+                goto fail;
+            }
+
+            // properties after the first child belong to skipped subtrees
+            if(!in_children) {
+                fdt_prop_t *prop = fdt_prop_create(tree, name, name_len, hash, (void*)value);
+                if(prop == NULL) {
+                    FDT_LOG_ERROR("create prop failed\n");
+                    goto fail;
+                }
+                fdt_node_append_prop(node, prop);
+            }
+
+            token = value + value_size;
+            continue;
+        }
+
+        uint32_t child_level = *token;
+        if(child_level <= level) {
+            break;
+        }
+
+        fdt_walk_node_t sizes;
+        uint32_t name_size = get_name(token + 1, end - token - 1, tree->flags, &name, &name_len, &hash);
+        const uint8_t *header_end = token + 1 + name_size;
+        if(name_size == 0 ||
+           get_subtree_size(header_end, tree->flags, end - header_end, &sizes) != size_size) {
+            FDT_LOG_ERROR("invalid node: %s\n", name);
+            goto fail;
+        }
+        header_end += size_size;
+
+        if(child_level == level + 1) {
+            fdt_node_t *child = fdt_node_create(tree, name, name_len, hash);
+            if(child == NULL) {
+                FDT_LOG_ERROR("create node failed\n");
+                goto fail;
+            }
+            child->lazy = header_end;
+            fdt_node_add_child(node, child);
+
+            in_children = true;
+            token = size_size ? header_end + sizes.size : header_end;
+        }
+        else if(in_children) {
+            token = header_end;
+        }
+        else {
+            FDT_LOG_ERROR("invalid node level: %"PRIu32"\n", child_level);
+            goto fail;
+        }
+    }
+
+#if FDT_SORTED_INDEX_MIN > 0
+    if(fdt_node_build_index(tree, node)) {
+        goto fail;
+    }
+#endif
+
+    fdt_atomic_store(&node->lazy, NULL);
+    return 0;
+
+fail:
+    fdt_node_free_children(node);
+    fdt_list_init(&node->prop);
+    fdt_list_init(&node->child);
+    return -1;
+}
+
+
+/**
+ * @brief create properties and children of lazy node
+ * 
+ * @param node: node
+ * @return int: 0: success, -1: fail
+ */
+int fdt_node_expand(fdt_node_t *node)
+{
+    fdt_node_t *root = node;
+    uint32_t level = 0;
+    int ret = 0;
+
+    if(fdt_atomic_load(&node->lazy) == NULL) {
+        return 0;
+    }
+
+    while(root->parent != root) {
+        root = root->parent;
+        level ++;
+    }
+
+    fdt_tree_t *tree = fdt_container_of(root, fdt_tree_t, root);
+    while(fdt_atomic_xchg(&tree->expand_lock, 1)) {
+        fdt_cpu_relax();
+    }
+
+    if(node->lazy) {
+        ret = fdt_node_expand_locked(tree, node, level);
+    }
+
+    fdt_atomic_store(&tree->expand_lock, 0);
+    return ret;
+}
+
+
+/**
+ * @brief build lazy tree, only properties of root node and top-level
+ *        nodes are created
+ * 
+ * @param tree: empty tree, it is not visible to readers
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_tree_build_lazy(fdt_tree_t *tree, const void *dtb, const uint64_t dtb_size)
+{
+    fdt_walk_node_t root;
+    uint64_t pos = 0;
+
+    if(fdt_blob_root(dtb, dtb_size, &tree->flags, &pos, &root)) {
+        return -1;
+    }
+
+    tree->blob = dtb;
+    tree->blob_size = dtb_size;
+    tree->version = get_version((uint8_t*)dtb + 3);
+    tree->root.lazy = (const uint8_t*)dtb + pos;
+
+    return fdt_node_expand_locked(tree, &tree->root, 0);
+}
+
+
+/**
+ * @brief load blob data of dtb files as layers of one tree
+ * 
+ * @param layers: dtb files, lowest layer first
+ * @param count: number of layers
+ * @param opts: options, or NULL
+ * @return int: 0: success, -1: fail
+ * @note the new tree is built aside and published at once, readers keep
+ *       seeing the previous tree until then. If it fails, the previous
+ *       tree is kept.
+ */
+int fdt_load_layers(const fdt_layer_t *layers, uint32_t count, const fdt_load_opts_t *opts)
+{
+    if(count == 0 || (count > 1 && opts && (opts->phash || (opts->flags & FDT_LOAD_LAZY)))) {
+        FDT_LOG_ERROR("layers error: %"PRIu32" layers\n", count);
+        return -1;
+    }
+
+    if(fdt_atomic_xchg(&fdt_loading, 1)) {
+        FDT_LOG_ERROR("fdt is loading\n");
+        return -1;
+    }
+
+    fdt_tree_t *tree = fdt_get_spare_tree();
+    int ret = 0;
+
+    if(!opts || !(opts->flags & FDT_LOAD_SKIP_CRC)) {
+        for(uint32_t i = 0; i < count && ret == 0; i++) {
+            ret = fdt_blob_verify(layers[i].dtb, layers[i].dtb_size);
+        }
+    }
+
+    if(ret) {
+        // nothing is built
+    }
+    else if(opts && (opts->flags & FDT_LOAD_LAZY)) {
+        ret = fdt_tree_build_lazy(tree, layers[0].dtb, layers[0].dtb_size);
+        if(ret == 0) {
+            ret = fdt_tree_build_aliases(tree);
+        }
+    }
+    else {
+        ret = fdt_tree_phash_init(tree, opts ? opts->phash : NULL);
+        if(ret == 0) {
+            ret = fdt_tree_build(tree, layers[0].dtb, layers[0].dtb_size);
+        }
+        for(uint32_t i = 1; i < count && ret == 0; i++) {
+            ret = fdt_tree_merge(tree, layers[i].dtb, layers[i].dtb_size);
+        }
+        if(ret == 0) {
+            ret = fdt_tree_resolve_refs(tree);
+        }
+        if(ret == 0) {
+            ret = fdt_tree_build_aliases(tree);
+        }
+        if(ret == 0) {
+            fdt_tree_phash_check(tree);
+        }
+#if FDT_SORTED_INDEX_MIN > 0
+        if(ret == 0) {
+            ret = fdt_node_build_index(tree, &tree->root);
+        }
+#endif
+    }
+
+    if(ret) {
+        fdt_tree_clear(tree);
+    }
+    else {
+        fdt_tree_publish(tree);
+    }
+
+    fdt_atomic_store(&fdt_loading, 0);
+    return ret;
+}
+
+
+/**
+ * @brief load blob data of dtb file with options
+ * 
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @param opts: options, or NULL
+ * @return int: 0: success, -1: fail
+ */
+int fdt_load_ex(const void *dtb, const uint64_t dtb_size, const fdt_load_opts_t *opts)
+{
+    fdt_layer_t layer = {dtb, dtb_size};
+
+    return fdt_load_layers(&layer, 1, opts);
+}
+
+
+/**
+ * @brief load blob data of dtb file
+ * 
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @return int: 0: success, -1: fail
+ */
+int fdt_load(const void *dtb, const uint64_t dtb_size)
+{
+    return fdt_load_ex(dtb, dtb_size, NULL);
+}
+
+
+/**
+ * @brief top-level nodes found by fdt_load_parallel()
+ * @builder: builder of root node, it creates properties of root.
+ * @dtb: dtb file.
+ * @flags: format flags of dtb file.
+ * @offset: position of each top-level node record.
+ * @count: number of top-level nodes.
+ * @cap: capacity of offset.
+ */
+typedef struct fdt_load_split {
+    fdt_tree_builder_t builder;
+    const uint8_t *dtb;
+    uint8_t flags;
+    uint64_t *offset;
+    uint32_t count;
+    uint32_t cap;
+
+}fdt_load_split_t;
+
+
+/**
+ * @brief record position of top-level node and skip its subtree
+ * 
+ * @param ctx: split state
+ * @param node: node in blob
+ * @return int: FDT_WALK_SKIP for top-level nodes, -1 if fail
+ */
+static int fdt_load_split_begin_node(void *ctx, const fdt_walk_node_t *node)
+{
+    fdt_load_split_t *split = ctx;
+
+    if(node->level == 0) {
+        return fdt_tree_build_begin_node(&split->builder, node);
+    }
+
+    if(split->count == split->cap) {
+        uint32_t cap = split->cap ? split->cap * 2 : 64;
+        uint64_t *offset = fdt_mem_alloc(sizeof(uint64_t) * cap);
+        if(offset == NULL) {
+            return -1;
+        }
+        if(split->offset) {
+            fdt_memcpy(offset, split->offset, sizeof(uint64_t) * split->count);
+            fdt_mem_free(split->offset);
+        }
+        split->offset = offset;
+        split->cap = cap;
+    }
+
+    // name follows level byte, and length and hash with FDT_FLAG_NAME_HASH
+    uint32_t head = (split->flags & FDT_FLAG_NAME_HASH) ? 4 : 1;
+    split->offset[split->count ++] = (uint64_t)((const uint8_t*)node->name - split->dtb) - head;
+
+    return FDT_WALK_SKIP;
+}
+
+
+/**
+ * @brief create property of root node
+ * 
+ * @param ctx: split state
+ * @param prop: property in blob
+ * @return int: FDT_WALK_CONTINUE, -1 if fail
+ */
+static int fdt_load_split_prop(void *ctx, const fdt_walk_prop_t *prop)
+{
+    fdt_load_split_t *split = ctx;
+
+    return fdt_tree_build_prop(&split->builder, prop);
+}
+
+
+/**
+ * @brief builder of a group of top-level nodes
+ * @tree: local tree, the nodes are built under its root.
+ * @dtb: dtb file.
+ * @begin: position of the first node record.
+ * @end: end of the last node.
+ * @flags: format flags of dtb file.
+ * @ret: 0: success, -1: fail.
+ * @thread: thread which builds the group.
+ * @started: thread is created.
+ */
+typedef struct fdt_load_worker {
+    fdt_tree_t tree;
+    const void *dtb;
+    uint64_t begin;
+    uint64_t end;
+    uint8_t flags;
+    int ret;
+#ifdef FDT_PARALLEL
+    fdt_thread_t thread;
+    bool started;
+#endif
+
+}fdt_load_worker_t;
+
+
+/**
+ * @brief build a group of top-level nodes into local tree
+ * 
+ * @param worker: worker
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_load_worker_build(fdt_load_worker_t *worker)
+{
+    static const fdt_walk_ops_t ops = {
+        .begin_node = fdt_tree_build_begin_node,
+        .prop = fdt_tree_build_prop,
+        .end_node = fdt_tree_build_end_node,
+    };
+    fdt_tree_t *tree = &worker->tree;
+    fdt_tree_builder_t builder = {tree, &tree->root, false};
+
+    if(fdt_arena_grow(tree, 0)) {
+        return -1;
+    }
+
+    if(fdt_walk_records(worker->dtb, worker->begin, worker->end, worker->flags, 0,
+                        FDT_WALK_CONTINUE, &ops, &builder)) {
+        return -1;
+    }
+
+#if FDT_SORTED_INDEX_MIN > 0
+    fdt_list_node_t *pos = NULL;
+    fdt_list_for_each(pos, &tree->root.child) {
+        if(fdt_node_build_index(tree, fdt_container_of(pos, fdt_node_t, entry))) {
+            return -1;
+        }
+    }
+#endif
+
+    return 0;
+}
+
+
+#ifdef FDT_PARALLEL
+/**
+ * @brief thread entry of worker
+ * 
+ * @param arg: worker
+ * @return void*: NULL
+ */
+static void* fdt_load_worker_thread(void *arg)
+{
+    fdt_load_worker_t *worker = arg;
+
+    worker->ret = fdt_load_worker_build(worker);
+    return NULL;
+}
+#endif
+
+
+/**
+ * @brief move nodes and arena blocks of worker into tree
+ * 
+ * @param tree: tree being built
+ * @param worker: finished worker
+ * @return none
+ */
+static void fdt_load_worker_join(fdt_tree_t *tree, fdt_load_worker_t *worker)
+{
+    fdt_tree_t *local = &worker->tree;
+    fdt_list_node_t *pos = local->root.child.next;
+
+    while(pos != &local->root.child) {
+        fdt_node_t *child = fdt_container_of(pos, fdt_node_t, entry);
+        pos = pos->next;
+        fdt_node_add_child(&tree->root, child);
+    }
+    fdt_list_init(&local->root.child);
+
+    fdt_arena_t **tail = &tree->arena;
+    while(*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = local->arena;
+    local->arena = NULL;
+
+    fdt_ref_prop_t **refs = &tree->refs;
+    while(*refs) {
+        refs = &(*refs)->next;
+    }
+    *refs = local->refs;
+    local->refs = NULL;
+
+    fdt_mem_hold(tree, local->consume);
+    for(int i = 0; i < FDT_MEM_TYPE_MAX; i++) {
+        tree->mem[i] += local->mem[i];
+    }
+    tree->node_count += local->node_count;
+    tree->prop_count += local->prop_count;
+}
+
+
+/**
+ * @brief split top-level nodes into groups of about the same size in
+ *        document order, build each group with a worker and join them
+ * 
+ * @param tree: tree being built
+ * @param split: top-level nodes
+ * @param dtb_size: dtb file size
+ * @param nthreads: number of workers
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_load_workers_run(fdt_tree_t *tree, const fdt_load_split_t *split, const uint64_t dtb_size, uint32_t nthreads)
+{
+    uint32_t count = nthreads == 0 ? 1 : (nthreads < split->count ? nthreads : split->count);
+    fdt_load_worker_t *workers = fdt_mem_alloc(sizeof(fdt_load_worker_t) * count);
+    if(workers == NULL) {
+        return -1;
+    }
+
+    uint64_t first = split->offset[0];
+    uint32_t node = 0;
+    for(uint32_t i = 0; i < count; i++) {
+        fdt_load_worker_t *worker = &workers[i];
+        uint64_t limit = first + (dtb_size - first) * (i + 1) / count;
+
+        fdt_memset(worker, 0, sizeof(fdt_load_worker_t));
+        worker->tree.root.name = "/";
+        fdt_root_init(&worker->tree);
+        worker->dtb = split->dtb;
+        worker->flags = split->flags;
+
+        // leave at least one node to each of the following groups
+        worker->begin = split->offset[node ++];
+        while(node < split->count - (count - i - 1) && split->offset[node] < limit) {
+            node ++;
+        }
+        worker->end = node < split->count ? split->offset[node] : dtb_size;
+    }
+
+    // the caller builds the first group
+    for(uint32_t i = 1; i < count; i++) {
+#ifdef FDT_PARALLEL
+        if(fdt_thread_create(&workers[i].thread, fdt_load_worker_thread, &workers[i]) == 0) {
+            workers[i].started = true;
+            continue;
+        }
+#endif
+        workers[i].ret = fdt_load_worker_build(&workers[i]);
+    }
+    workers[0].ret = fdt_load_worker_build(&workers[0]);
+
+    int ret = 0;
+    for(uint32_t i = 0; i < count; i++) {
+#ifdef FDT_PARALLEL
+        if(workers[i].started) {
+            fdt_thread_join(workers[i].thread);
+        }
+#endif
+        ret |= workers[i].ret;
+        fdt_load_worker_join(tree, &workers[i]);
+    }
+
+    // workers check the budget with their own bytes only
+    if(ret == 0 && fdt_mem_check_budget(tree, 0)) {
+        ret = -1;
+    }
+
+    fdt_mem_free(workers);
+    return ret;
+}
+
+
+/**
+ * @brief build tree with several workers, properties of root node are
+ *        created by the caller
+ * 
+ * @param tree: empty tree, it is not visible to readers
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @param nthreads: number of workers
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_tree_build_parallel(fdt_tree_t *tree, const void *dtb, const uint64_t dtb_size, uint32_t nthreads)
+{
+    static const fdt_walk_ops_t ops = {
+        .begin_node = fdt_load_split_begin_node,
+        .prop = fdt_load_split_prop,
+    };
+    fdt_load_split_t split = {
+        .builder = {tree, &tree->root, false},
+        .dtb = dtb,
+    };
+    uint64_t pos = 0;
+    fdt_walk_node_t root;
+
+    if(fdt_blob_root(dtb, dtb_size, &split.flags, &pos, &root) ||
+       fdt_arena_grow(tree, 0) ||
+       fdt_walk(dtb, dtb_size, &ops, &split)) {
+        if(split.offset) {
+            fdt_mem_free(split.offset);
+        }
+        return -1;
+    }
+
+    tree->version = get_version((uint8_t*)dtb + 3);
+
+    int ret = split.count ? fdt_load_workers_run(tree, &split, dtb_size, nthreads) : 0;
+    if(split.offset) {
+        fdt_mem_free(split.offset);
+    }
+
+    if(ret == 0) {
+        ret = fdt_tree_resolve_refs(tree);
+    }
+    if(ret == 0) {
+        ret = fdt_tree_build_aliases(tree);
+    }
+
+#if FDT_SORTED_INDEX_MIN > 0
+    if(ret == 0) {
+        ret = fdt_node_build_own_index(tree, &tree->root);
+    }
+#endif
+
+    return ret;
+}
+
+
+/**
+ * @brief load blob data of dtb file with several threads
+ * 
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @param nthreads: number of threads
+ * @return int: 0: success, -1: fail
+ * @note the tree is published like fdt_load_ex()
+ */
+int fdt_load_parallel(const void *dtb, const uint64_t dtb_size, uint32_t nthreads)
+{
+    if(fdt_atomic_xchg(&fdt_loading, 1)) {
+        FDT_LOG_ERROR("fdt is loading\n");
+        return -1;
+    }
+
+    fdt_tree_t *tree = fdt_get_spare_tree();
+    int ret = fdt_blob_verify(dtb, dtb_size);
+
+    if(ret == 0) {
+        ret = fdt_tree_build_parallel(tree, dtb, dtb_size, nthreads);
+    }
+
+    if(ret) {
+        fdt_tree_clear(tree);
+    }
+    else {
+        fdt_tree_publish(tree);
+    }
+
+    fdt_atomic_store(&fdt_loading, 0);
+    return ret;
+}
+
+
+#define FDT_ASYNC_IDLE              0
+#define FDT_ASYNC_BUILDING          1
+#define FDT_ASYNC_PUBLISHED         2
+#define FDT_ASYNC_DONE              3
+
+
+/**
+ * @brief background load of fdt_load_async()
+ * @dtb: dtb file.
+ * @dtb_size: dtb file size.
+ * @state: FDT_ASYNC_*.
+ * @ret: result of load.
+ * @thread: worker thread.
+ * @started: worker thread is started and not joined yet.
+ */
+typedef struct fdt_async {
+    const void *dtb;
+    uint64_t dtb_size;
+    uint32_t state;
+    int ret;
+#ifdef FDT_PARALLEL
+    fdt_thread_t thread;
+    bool started;
+#endif
+
+}fdt_async_t;
+
+
+static fdt_async_t fdt_async;
+
+
+/**
+ * @brief expand node and all its descendants
+ * 
+ * @param node: node
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_node_expand_all(fdt_node_t *node)
+{
+    fdt_node_t *child = NULL;
+
+    if(fdt_node_materialize(node)) {
+        return -1;
+    }
+
+    fdt_list_for_each_entry(child, &node->child, fdt_node_t, entry) {
+        if(fdt_node_expand_all(child)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief publish lazy tree, then expand it in document order
+ * 
+ * @param none
+ * @return none
+ */
+static void fdt_load_async_run(void)
+{
+    fdt_tree_t *tree = fdt_get_spare_tree();
+    int ret = fdt_blob_verify(fdt_async.dtb, fdt_async.dtb_size);
+
+    if(ret == 0) {
+        ret = fdt_tree_build_lazy(tree, fdt_async.dtb, fdt_async.dtb_size);
+    }
+
+    if(ret == 0) {
+        ret = fdt_tree_build_aliases(tree);
+    }
+
+    if(ret) {
+        fdt_tree_clear(tree);
+    }
+    else {
+        // like fdt_tree_publish(), but waiters go on before the old tree is freed
+        fdt_tree_t *old = fdt_tree;
+        fdt_atomic_store(&fdt_tree, tree);
+        fdt_atomic_store(&fdt_async.state, FDT_ASYNC_PUBLISHED);
+        fdt_cpu_relax();
+        fdt_synchronize();
+        fdt_tree_clear(old);
+        ret = fdt_node_expand_all(&tree->root);
+    }
+
+    fdt_async.ret = ret;
+    fdt_atomic_store(&fdt_async.state, FDT_ASYNC_DONE);
+    fdt_atomic_store(&fdt_loading, 0);
+}
+
+
+#ifdef FDT_PARALLEL
+/**
+ * @brief thread entry of background load
+ * 
+ * @param arg: not used
+ * @return void*: NULL
+ */
+static void* fdt_load_async_thread(void *arg)
+{
+    (void)arg;
+    fdt_load_async_run();
+    return NULL;
+}
+#endif
+
+
+/**
+ * @brief load blob data of dtb file in the background
+ * 
+ * @param dtb: dtb file
+ * @param dtb_size: dtb file size
+ * @return int: 0: success, -1: fail
+ */
+int fdt_load_async(const void *dtb, const uint64_t dtb_size)
+{
+    if(fdt_atomic_xchg(&fdt_loading, 1)) {
+        FDT_LOG_ERROR("fdt is loading\n");
+        return -1;
+    }
+
+#ifdef FDT_PARALLEL
+    // the previous worker is done since fdt_loading was clear
+    if(fdt_async.started) {
+        fdt_thread_join(fdt_async.thread);
+        fdt_async.started = false;
+    }
+#endif
+
+    fdt_async.dtb = dtb;
+    fdt_async.dtb_size = dtb_size;
+    fdt_async.ret = 0;
+    fdt_atomic_store(&fdt_async.state, FDT_ASYNC_BUILDING);
+
+#ifdef FDT_PARALLEL
+    if(fdt_thread_create(&fdt_async.thread, fdt_load_async_thread, NULL) == 0) {
+        fdt_async.started = true;
+        return 0;
+    }
+#endif
+
+    fdt_load_async_run();
+    return fdt_async.ret;
+}
+
+
+/**
+ * @brief wait for background load to finish
+ * 
+ * @param none
+ * @return int: 0: success, -1: fail
+ */
+int fdt_load_async_join(void)
+{
+#ifdef FDT_PARALLEL
+    if(fdt_async.started) {
+        fdt_thread_join(fdt_async.thread);
+        fdt_async.started = false;
+    }
+#endif
+
+    return fdt_async.ret;
+}
+
+
+/**
+ * @brief wait until node and its subtree are ready
+ * 
+ * @param path: node path
+ * @param timeout_ms: max time to wait for the tree to be published
+ * @return fdt_node_t*: node, NULL if not found or timeout
+ */
+fdt_node_t* fdt_wait_node(const char *path, uint32_t timeout_ms)
+{
+    uint64_t begin = fdt_get_time_ms();
+
+    while(fdt_atomic_load(&fdt_async.state) == FDT_ASYNC_BUILDING) {
+        if(fdt_get_time_ms() - begin >= timeout_ms) {
+            return NULL;
+        }
+        fdt_cpu_relax();
+    }
+
+    fdt_node_t *node = fdt_find_node_by_path(path);
+    if(node == NULL || fdt_node_expand_all(node)) {
+        return NULL;
+    }
+
+    return node;
+}
+
+
+/**
+ * @brief patch being applied
+ * @pos: next op.
+ * @end: end of patch.
+ * @error: sticky error.
+ */
+typedef struct fdt_patch_reader {
+    const uint8_t *pos;
+    const uint8_t *end;
+    int error;
+
+}fdt_patch_reader_t;
+
+
+/**
+ * @brief new blob written by fdt_apply_patch(), in the format of fdt_writer
+ * @buf: output buffer.
+ * @size: bytes written.
+ * @cap: buffer size.
+ * @flags: FDT_FLAG_* format flags of new blob.
+ * @error: sticky error, set by the first failed write.
+ */
+typedef struct fdt_patch_out {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t cap;
+    uint8_t flags;
+    int error;
+
+}fdt_patch_out_t;
+
+
+/**
+ * @brief get varint of patch
+ * 
+ * @param reader: patch
+ * @return uint32_t: value, 0 if patch is broken
+ */
+static uint32_t fdt_patch_get_uint(fdt_patch_reader_t *reader)
+{
+    uint32_t value = 0;
+
+    for(uint32_t shift = 0; shift < 32 && reader->pos < reader->end; shift += 7) {
+        uint8_t byte = *reader->pos ++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+
+    reader->error = -1;
+    return 0;
+}
+
+
+/**
+ * @brief get name of patch
+ * 
+ * @param reader: patch
+ * @return const char*: name, NULL if patch is broken
+ */
+static const char* fdt_patch_get_string(fdt_patch_reader_t *reader)
+{
+    const char *name = (const char*)reader->pos;
+    const uint8_t *zero = fdt_memchr(reader->pos, 0, reader->end - reader->pos);
+
+    if(zero == NULL) {
+        reader->error = -1;
+        return NULL;
+    }
+
+    reader->pos = zero + 1;
+    return name;
+}
+
+
+/**
+ * @brief get raw value of patch
+ * 
+ * @param reader: patch
+ * @param size: output value size
+ * @return const uint8_t*: value, NULL if patch is broken
+ */
+static const uint8_t* fdt_patch_get_value(fdt_patch_reader_t *reader, uint32_t *size)
+{
+    *size = fdt_patch_get_uint(reader);
+
+    if(reader->error || *size == 0 || *size > (uint32_t)(reader->end - reader->pos)) {
+        reader->error = -1;
+        return NULL;
+    }
+
+    const uint8_t *value = reader->pos;
+    reader->pos += *size;
+    return value;
+}
+
+
+/**
+ * @brief put bytes at the end of new blob
+ * 
+ * @param out: new blob
+ * @param data: data
+ * @param len: number of bytes
+ * @return none
+ */
+static void fdt_patch_put(fdt_patch_out_t *out, const void *data, uint32_t len)
+{
+    if(out->error || len > out->cap - out->size) {
+        out->error = -1;
+        return;
+    }
+
+    fdt_memcpy(out->buf + out->size, data, len);
+    out->size += len;
+}
+
+
+/**
+ * @brief put little endian value at the end of new blob
+ * 
+ * @param out: new blob
+ * @param value: value
+ * @param bytes: number of bytes, at most 4
+ * @return none
+ */
+static void fdt_patch_put_le(fdt_patch_out_t *out, uint32_t value, uint8_t bytes)
+{
+    uint8_t data[4];
+
+    for(uint8_t i = 0; i < bytes; i++) {
+        data[i] = (uint8_t)(value >> (i * 8));
+    }
+    fdt_patch_put(out, data, bytes);
+}
+
+
+/**
+ * @brief put node or property name, with length and hash if the format has them
+ * 
+ * @param out: new blob
+ * @param name: name
+ * @return none
+ */
+static void fdt_patch_put_name(fdt_patch_out_t *out, const char *name)
+{
+    uint32_t len = (uint32_t)fdt_strlen(name);
+
+    if(out->flags & FDT_FLAG_NAME_HASH) {
+        if(len > 0xff) {
+            out->error = -1;
+            return;
         }
+        fdt_patch_put_le(out, len, 1);
+        fdt_patch_put_le(out, fdt_hash_name(name, len), 2);
     }
+
+    fdt_patch_put(out, name, len + 1);
 }
 
 
 /**
- * @brief debug print all node and property
+ * @brief put property record
  * 
- * @param node: node
+ * @param out: new blob
+ * @param name: property name
+ * @param value: raw value starting with type byte
+ * @param size: size of value
  * @return none
- * @note only used for debug
  */
-void fdt_debug_put_node_info(fdt_node_t *node)
+static void fdt_patch_put_prop(fdt_patch_out_t *out, const char *name, const void *value, uint32_t size)
 {
-    static int level = 0;
-    fdt_node_t *child = NULL;
+    uint8_t token = 0xff;
 
-    fdt_debug_put_node_prop(node, level);
-    
-    if(fdt_node_have_child(node)) {
-        level ++;
-        fdt_list_for_each_entry(child, &node->child, fdt_node_t, entry) {
-            fdt_debug_put_node_info(child);
-        }
-        level --;
-    }
+    fdt_patch_put(out, &token, 1);
+    fdt_patch_put_name(out, name);
+    fdt_patch_put(out, value, size);
 }
 
 
 /**
- * @brief Debug to get fdt number of bytes consumed
- * @param none
- * @return uint64_t number of bytes consumed
- * @note only used for debug
+ * @brief put loaded property record
+ * 
+ * @param out: new blob
+ * @param prop: property
+ * @return none
  */
-uint64_t fdt_debug_get_consume_bytes(void)
+static inline void fdt_patch_copy_prop(fdt_patch_out_t *out, const fdt_prop_t *prop)
 {
-    return fdt_consume;
+    fdt_patch_put_prop(out, prop->name, prop->offset, fdt_get_prop_value_size(prop));
 }
 
 
 /**
- * @brief get magic of dtb file
+ * @brief put node record, its subtree size fields are filled when it ends
  * 
- * @param token: input token position of dtb file
- * @return uint64_t: magic
+ * @param out: new blob
+ * @param level: level of node, root node is 0
+ * @param name: node name
+ * @return uint32_t: position of subtree size fields
  */
-static uint64_t get_magic(uint8_t *token)
+static uint32_t fdt_patch_begin_node(fdt_patch_out_t *out, uint8_t level, const char *name)
 {
-    uint64_t magic = 0;
+    if(level == 0xff) {
+        out->error = -1;
+        return 0;
+    }
 
-    magic = *(token ++);
-    magic |= (*(token ++) << 8);
-    magic |= (*(token ++) << 16);
+    fdt_patch_put(out, &level, 1);
+    fdt_patch_put_name(out, name);
 
-    return magic & 0xffffff;
+    uint32_t pos = out->size;
+    if(out->flags & FDT_FLAG_SUBTREE_SIZE) {
+        fdt_patch_put_le(out, 0, 4);
+        fdt_patch_put_le(out, UINT32_MAX, 4);
+    }
+
+    return pos;
 }
 
 
 /**
- * @brief get version of dtb file
+ * @brief fill property size of a node if it is not filled yet
  * 
- * @param token: input token position of dtb file
- * @return uint64_t: version number
+ * @param out: new blob
+ * @param pos: position of subtree size fields of node
+ * @return none
  */
-static uint64_t get_version(uint8_t *token)
+static void fdt_patch_end_props(fdt_patch_out_t *out, uint32_t pos)
 {
-    uint64_t version = 0;
+    if(!(out->flags & FDT_FLAG_SUBTREE_SIZE) || out->error) {
+        return;
+    }
 
-    version = *(token ++);
-    version |= (*(token ++) << 8);
-    version |= (*(token ++) << 16);
+    uint8_t *field = out->buf + pos;
+    uint32_t size = out->size - pos - 8;
 
-    return version & 0xffffff;
+    if(field[4] == 0xff && field[5] == 0xff && field[6] == 0xff && field[7] == 0xff) {
+        for(uint8_t i = 0; i < 4; i++) {
+            field[4 + i] = (uint8_t)(size >> (i * 8));
+        }
+    }
 }
 
 
 /**
- * @brief load blob data of dtb file
+ * @brief fill subtree size of a node when it ends
  * 
- * @param dtb: dtb file
- * @param dtb_size: dtb file size
- * @return int: 0: success, -1: fail
+ * @param out: new blob
+ * @param pos: position of subtree size fields of node
+ * @return none
  */
-int fdt_load(const void *dtb, const uint64_t dtb_size)
+static void fdt_patch_end_node(fdt_patch_out_t *out, uint32_t pos)
 {
-    uint64_t pos = 0;
-    uint8_t *token = (uint8_t*)dtb;
-    uint8_t node_level = 0;
-    fdt_node_t *parent_node = &fdt_root;
-    fdt_node_t *curr_node = &fdt_root;
+    if(!(out->flags & FDT_FLAG_SUBTREE_SIZE) || out->error) {
+        return;
+    }
 
-    fdt_root_init();
+    uint8_t *field = out->buf + pos;
+    uint32_t size = out->size - pos - 8;
 
-    if(get_magic(token) != FDT_MAGIC) {
-        FDT_LOG_ERROR("magic error: invalid dtb file\n");
-        return -1;
+    fdt_patch_end_props(out, pos);
+    for(uint8_t i = 0; i < 4; i++) {
+        field[i] = (uint8_t)(size >> (i * 8));
     }
+}
 
-    fdt_version = get_version(token + 3);
-    token += 6;
 
-    if(*token != 0 || *(token + 1) != '/') {
-        FDT_LOG_ERROR("invalid dtb file\n");
+/**
+ * @brief copy a loaded node with its properties and descendants
+ * 
+ * @param out: new blob
+ * @param node: node
+ * @param level: level of node in new blob
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_patch_copy_node(fdt_patch_out_t *out, fdt_node_t *node, uint8_t level)
+{
+    fdt_prop_t *prop = NULL;
+    fdt_node_t *child = NULL;
+    uint32_t pos = fdt_patch_begin_node(out, level, node->name);
+
+    if(fdt_node_expand(node)) {
+        out->error = -1;
         return -1;
     }
 
-    token += 3; pos += 9; //skip magic and version and root node name '/'
+    fdt_for_each_node_prop(node, prop) {
+        fdt_patch_copy_prop(out, prop);
+    }
+    fdt_patch_end_props(out, pos);
 
-    while(pos < dtb_size) {
-        if(*token == 0xff) {
-            // property
-            token ++;
+    fdt_for_each_node_child(node, child) {
+        fdt_patch_copy_node(out, child, level + 1);
+    }
+    fdt_patch_end_node(out, pos);
 
-            char *prop_name = (char*)token;
-            int prop_name_len = fdt_strlen(prop_name) + 1;
-            token += prop_name_len;
-            pos += prop_name_len + 1;
+    return out->error;
+}
 
-            void* value = (void*)token;
 
-            fdt_prop_t *prop = fdt_prop_create(prop_name, value);
-            if(prop == NULL) {
-                FDT_LOG_ERROR("create string prop failed");
-                return -1;
-            }
-            fdt_node_append_prop(curr_node, prop);
+/**
+ * @brief apply ops of a node and put it into new blob
+ * 
+ * @param out: new blob
+ * @param reader: patch
+ * @param node: loaded node, NULL for a node being added
+ * @param name: node name
+ * @param level: level of node in new blob
+ * @return int: 0: success, -1: fail
+ */
+static int fdt_patch_apply_node(fdt_patch_out_t *out, fdt_patch_reader_t *reader, fdt_node_t *node,
+                                const char *name, uint8_t level)
+{
+    fdt_list_node_t *props = NULL, *prop = NULL;
+    fdt_list_node_t *children = NULL, *child = NULL;
+    bool in_props = true;
+    uint32_t size = 0;
 
-            uint8_t prop_type = *token;
-            
-            if(prop_type == FDT_PROP_STRING) {
-                char *prop_str = (char*)(token + 1);
-                int prop_str_len = fdt_strlen(prop_str) + 1;
-                token ++;
-                
-                token += prop_str_len;
-                pos += (prop_str_len + 1);
-            }
-            else if(prop_type >= FDT_PROP_INT && prop_type < FDT_PROP_ARRAY){
-                uint8_t value_bytes = prop_type;
-                token += (value_bytes + 1); pos += (value_bytes + 1);
-            }
-            else if(prop_type > FDT_PROP_ARRAY) {
-                uint8_t cell_bytes = prop_type - 32;
-                uint8_t array_len = *(token + 1);
+    if(node) {
+        if(fdt_node_expand(node)) {
+            return -1;
+        }
+        props = &node->prop;
+        prop = props->next;
+        children = &node->child;
+        child = children->next;
+    }
 
-                int array_size = cell_bytes * array_len + 2;
+    uint32_t pos = fdt_patch_begin_node(out, level, name);
+    while(reader->error == 0 && out->error == 0) {
+        uint32_t op = fdt_patch_get_uint(reader);
+        uint32_t count = 0;
 
-                token += array_size;
-                pos += array_size;
+        if(reader->error) {
+            break;
+        }
+        if(op > FDT_PATCH_ADD_PROP || op == FDT_PATCH_END) {
+            // properties not covered by ops are kept
+            for(; in_props && prop != props; prop = prop->next) {
+                fdt_patch_copy_prop(out, fdt_container_of(prop, fdt_prop_t, node));
             }
+            fdt_patch_end_props(out, pos);
+            in_props = false;
         }
-        else {
-            // node begin
-            if(*token > node_level) {
-                parent_node = curr_node;
+        else if(!in_props) {
+            break;
+        }
+
+        if(op == FDT_PATCH_KEEP_PROP || op == FDT_PATCH_DROP_PROP) {
+            for(count = fdt_patch_get_uint(reader); count > 0 && prop != props; count--) {
+                if(op == FDT_PATCH_KEEP_PROP) {
+                    fdt_patch_copy_prop(out, fdt_container_of(prop, fdt_prop_t, node));
+                }
+                prop = prop->next;
+            }
+        }
+        else if(op == FDT_PATCH_SET_PROP) {
+            const uint8_t *value = fdt_patch_get_value(reader, &size);
+            if(value == NULL || prop == props) {
+                break;
             }
-            else if(*token < node_level) {
-                int diff = node_level - *token;
-                for(int i = 0; i < diff; i ++) {
-                    parent_node = parent_node->parent;
+            fdt_patch_put_prop(out, fdt_container_of(prop, fdt_prop_t, node)->name, value, size);
+            prop = prop->next;
+        }
+        else if(op == FDT_PATCH_ADD_PROP) {
+            const char *prop_name = fdt_patch_get_string(reader);
+            const uint8_t *value = prop_name ? fdt_patch_get_value(reader, &size) : NULL;
+            if(value == NULL) {
+                break;
+            }
+            fdt_patch_put_prop(out, prop_name, value, size);
+        }
+        else if(op == FDT_PATCH_KEEP_NODE || op == FDT_PATCH_DROP_NODE) {
+            for(count = fdt_patch_get_uint(reader); count > 0 && child != children; count--) {
+                if(op == FDT_PATCH_KEEP_NODE) {
+                    fdt_patch_copy_node(out, fdt_container_of(child, fdt_node_t, entry), level + 1);
                 }
+                child = child->next;
             }
-            node_level  = *token;
-            
-            token ++;
-            char *node_name = (char*)token;
-            int node_name_len = fdt_strlen(node_name) + 1;
-
-            curr_node = fdt_node_create(node_name);
-            if(curr_node == NULL) {
-                FDT_LOG_ERROR("create node failed\n");
-                return -1;
+        }
+        else if(op == FDT_PATCH_EDIT_NODE) {
+            if(child == children) {
+                break;
+            }
+            fdt_node_t *entry = fdt_container_of(child, fdt_node_t, entry);
+            fdt_patch_apply_node(out, reader, entry, entry->name, level + 1);
+            child = child->next;
+        }
+        else if(op == FDT_PATCH_ADD_NODE) {
+            const char *node_name = fdt_patch_get_string(reader);
+            if(node_name == NULL) {
+                break;
+            }
+            fdt_patch_apply_node(out, reader, NULL, node_name, level + 1);
+        }
+        else if(op == FDT_PATCH_END) {
+            for(; child != children; child = child->next) {
+                fdt_patch_copy_node(out, fdt_container_of(child, fdt_node_t, entry), level + 1);
             }
+            fdt_patch_end_node(out, pos);
+            return out->error;
+        }
+        else {
+            break;
+        }
+
+        if(count > 0) {
+            break;
+        }
+    }
+
+    reader->error = -1;
+    return -1;
+}
+
+
+/**
+ * @brief apply patch to the loaded tree and load the result
+ * 
+ * @param dtb: blob of the loaded tree, it is the base of patch
+ * @param dtb_size: blob size
+ * @param patch: patch
+ * @param patch_size: patch size
+ * @param buf: output buffer of the new blob
+ * @param cap: output buffer size
+ * @param size: output new blob size
+ * @return int: 0: success, -1: fail
+ */
+int fdt_apply_patch(const void *dtb, uint32_t dtb_size, const void *patch, uint32_t patch_size,
+                    void *buf, uint32_t cap, uint32_t *size)
+{
+    uint8_t *data = (uint8_t*)patch;
+
+    if(buf == NULL || patch_size < FDT_PATCH_HEADER_SIZE || get_magic(data) != FDT_PATCH_MAGIC) {
+        FDT_LOG_ERROR("patch magic error\n");
+        return -1;
+    }
+    if(fdt_get_u32(data + 3) != dtb_size || fdt_get_u32(data + 7) != fdt_patch_hash(dtb, dtb_size)) {
+        FDT_LOG_ERROR("patch does not match dtb\n");
+        return -1;
+    }
+
+    uint32_t new_size = fdt_get_u32(data + 11);
+    uint32_t new_hash = fdt_get_u32(data + 15);
+    if(new_size > cap) {
+        FDT_LOG_ERROR("patch needs %u bytes, buffer is %u bytes\n", new_size, cap);
+        return -1;
+    }
+
+    // the same header as fdt_writer_init(), blob size and crc are filled last
+    fdt_patch_reader_t reader = {data + FDT_PATCH_HEADER_SIZE, data + patch_size, 0};
+    fdt_patch_out_t out = {buf, 0, cap, data[22], 0};
+    fdt_patch_put_le(&out, out.flags ? FDT_MAGIC_EXT : FDT_MAGIC, 3);
+    fdt_patch_put_le(&out, (uint32_t)get_version(data + 19), 3);
+    if(out.flags) {
+        fdt_patch_put_le(&out, out.flags, 1);
+    }
+    if(out.flags & FDT_FLAG_CRC32) {
+        fdt_patch_put_le(&out, 0, 4);
+        fdt_patch_put_le(&out, 0, 4);
+    }
 
-            fdt_node_add_child(parent_node, curr_node);
+    int epoch = fdt_read_begin();
+    int ret = fdt_patch_apply_node(&out, &reader, fdt_get_root_node(), "/", 0);
+    fdt_read_end(epoch);
 
-            token += node_name_len;
-            pos += (node_name_len + 1);
+    if(ret == 0 && (out.flags & FDT_FLAG_CRC32)) {
+        uint32_t crc = fdt_crc32(0, out.buf + 15, out.size - 15);
+        for(uint8_t i = 0; i < 4; i++) {
+            out.buf[7 + i] = (uint8_t)(out.size >> (i * 8));
+            out.buf[11 + i] = (uint8_t)(crc >> (i * 8));
         }
     }
 
+    if(ret || reader.pos != reader.end || out.size != new_size || fdt_patch_hash(out.buf, out.size) != new_hash) {
+        FDT_LOG_ERROR("patch apply failed\n");
+        return -1;
+    }
+
+    *size = out.size;
+    return fdt_load(buf, out.size);
+}
+
+
+/**
+ * @brief unload fdt and free all nodes and properties
+ * 
+ * @param none
+ * @return none
+ * @note it waits until readers have left the tree before freeing it
+ */
+void fdt_unload(void)
+{
+    if(fdt_atomic_xchg(&fdt_loading, 1)) {
+        FDT_LOG_ERROR("fdt is loading\n");
+        return;
+    }
+
+    fdt_tree_publish(fdt_get_spare_tree());
+    fdt_atomic_store(&fdt_loading, 0);
+}
+
+
+/**
+ * @brief set memory budget of tree
+ * 
+ * @param bytes: bytes a tree may consume, 0 is unlimited
+ * @return int: 0: success, -1: fail
+ */
+int fdt_set_mem_budget(uint64_t bytes)
+{
+    if(fdt_atomic_xchg(&fdt_loading, 1)) {
+        FDT_LOG_ERROR("fdt is loading\n");
+        return -1;
+    }
+
+    fdt_mem_budget = bytes;
+
+    fdt_atomic_store(&fdt_loading, 0);
     return 0;
 }
+
+
+/**
+ * @brief set allocator of nodes, properties and tables
+ * 
+ * @param allocator: allocator, NULL restores the default one
+ * @return int: 0: success, -1: fail
+ */
+int fdt_set_allocator(const fdt_allocator_t *allocator)
+{
+    if(fdt_atomic_xchg(&fdt_loading, 1)) {
+        FDT_LOG_ERROR("fdt is loading\n");
+        return -1;
+    }
+
+    fdt_tree_t *tree = fdt_get_tree();
+    int ret = 0;
+
+    if(tree->consume || tree->phash_nodes) {
+        FDT_LOG_ERROR("fdt is loaded, unload it first\n");
+        ret = -1;
+    }
+    else if(allocator) {
+        fdt_allocator = *allocator;
+    }
+    else {
+        fdt_allocator.alloc = fdt_default_alloc;
+        fdt_allocator.free = fdt_default_free;
+        fdt_allocator.ctx = NULL;
+    }
+
+    fdt_atomic_store(&fdt_loading, 0);
+    return ret;
+}
+
+
+/**
+ * @brief link all blocks of pool into free list
+ * 
+ * @param pool: pool
+ * @param buf: blocks
+ * @param block_size: size of each block
+ * @param count: number of blocks
+ * @return none
+ */
+static void fdt_pool_init(fdt_pool_t *pool, void *buf, uint32_t block_size, uint32_t count)
+{
+    pool->base = buf;
+    pool->end = pool->base + (size_t)block_size * count;
+    pool->block_size = block_size;
+    pool->free_list = NULL;
+    pool->used = 0;
+    pool->peak = 0;
+    pool->lock = 0;
+
+    // the first block is at the head, so blocks are taken in address order
+    for(uint32_t i = count; i > 0; i--) {
+        void **block = (void**)(pool->base + (size_t)block_size * (i - 1));
+        *block = pool->free_list;
+        pool->free_list = block;
+    }
+}
+
+
+/**
+ * @brief take a block from pool, under its spin lock
+ * 
+ * @param pool: pool
+ * @return void*: block, NULL if pool is empty
+ */
+static void* fdt_pool_take(fdt_pool_t *pool)
+{
+    while(fdt_atomic_xchg(&pool->lock, 1)) {
+        fdt_cpu_relax();
+    }
+
+    void **block = pool->free_list;
+    if(block) {
+        pool->free_list = *block;
+        if(++ pool->used > pool->peak) {
+            pool->peak = pool->used;
+        }
+    }
+
+    fdt_atomic_store(&pool->lock, 0);
+    return block;
+}
+
+
+/**
+ * @brief give a block back to pool, under its spin lock
+ * 
+ * @param pool: pool
+ * @param ptr: memory
+ * @return bool: false if it is not a block of pool
+ */
+static bool fdt_pool_give(fdt_pool_t *pool, void *ptr)
+{
+    if((uint8_t*)ptr < pool->base || (uint8_t*)ptr >= pool->end) {
+        return false;
+    }
+
+    while(fdt_atomic_xchg(&pool->lock, 1)) {
+        fdt_cpu_relax();
+    }
+
+    *(void**)ptr = pool->free_list;
+    pool->free_list = ptr;
+    pool->used --;
+
+    fdt_atomic_store(&pool->lock, 0);
+    return true;
+}
+
+
+/**
+ * @brief allocator backend of pool allocator
+ * 
+ * @param ctx: pool allocator
+ * @param size: bytes
+ * @return void*: memory, NULL if fail
+ */
+static void* fdt_pool_alloc(void *ctx, size_t size)
+{
+    fdt_pool_allocator_t *pool = ctx;
+    void *ptr = NULL;
+
+    if(size == sizeof(fdt_node_t)) {
+        ptr = fdt_pool_take(&pool->node);
+    }
+    else if(size == sizeof(fdt_prop_t)) {
+        ptr = fdt_pool_take(&pool->prop);
+    }
+
+    if(ptr == NULL && pool->fallback.alloc) {
+        ptr = pool->fallback.alloc(pool->fallback.ctx, size);
+    }
+
+    return ptr;
+}
+
+
+/**
+ * @brief allocator backend of pool allocator
+ * 
+ * @param ctx: pool allocator
+ * @param ptr: memory
+ * @return none
+ */
+static void fdt_pool_free(void *ctx, void *ptr)
+{
+    fdt_pool_allocator_t *pool = ctx;
+
+    if(fdt_pool_give(&pool->node, ptr) || fdt_pool_give(&pool->prop, ptr)) {
+        return;
+    }
+
+    if(pool->fallback.free) {
+        pool->fallback.free(pool->fallback.ctx, ptr);
+    }
+}
+
+
+/**
+ * @brief initialize pool allocator
+ * 
+ * @param pool: pool allocator
+ * @param nodes: node blocks
+ * @param node_count: number of node blocks
+ * @param props: property blocks
+ * @param prop_count: number of property blocks
+ * @param fallback: allocator of other sizes, or NULL
+ * @return none
+ */
+void fdt_pool_allocator_init(fdt_pool_allocator_t *pool, fdt_node_t *nodes, uint32_t node_count,
+                             fdt_prop_t *props, uint32_t prop_count, const fdt_allocator_t *fallback)
+{
+    fdt_pool_init(&pool->node, nodes, sizeof(fdt_node_t), node_count);
+    fdt_pool_init(&pool->prop, props, sizeof(fdt_prop_t), prop_count);
+
+    pool->allocator.alloc = fdt_pool_alloc;
+    pool->allocator.free = fdt_pool_free;
+    pool->allocator.ctx = pool;
+
+    if(fallback) {
+        pool->fallback = *fallback;
+    }
+    else {
+        pool->fallback.alloc = NULL;
+        pool->fallback.free = NULL;
+        pool->fallback.ctx = NULL;
+    }
+}
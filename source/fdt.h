@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
 #endif
 
 #include <stdbool.h>
@@ -36,8 +37,8 @@
  */
 #ifdef x86_64
 #define FDT_LOG(...)                printf(__VA_ARGS__)
-#define FDT_LOG_ERROR(...)          printf("[ERROR]"__VA_ARGS__)
-#define FDT_LOG_INFO(...)           printf("[INFO]"__VA_ARGS__)
+#define FDT_LOG_ERROR(...)          printf("[ERROR]" __VA_ARGS__)
+#define FDT_LOG_INFO(...)           printf("[INFO]" __VA_ARGS__)
 #else
 #define FDT_LOG(...)
 #define FDT_LOG_ERROR(...)
@@ -46,7 +47,8 @@
 
 
 /**
- * you should replace the memory function with your own.
+ * you should replace the memory function with your own, or set an allocator
+ * at runtime with fdt_set_allocator(), these are its default backend.
  */
 #define  fdt_malloc(size)           malloc(size)
 #define  fdt_free(ptr)              free(ptr)
@@ -56,6 +58,90 @@
 
 #define  fdt_memset(buf, val, len)  memset(buf, val, len)
 #define  fdt_memcpy(dst, src, len)  memcpy(dst, src, len)
+#define  fdt_memcmp(a, b, len)      memcmp(a, b, len)
+#define  fdt_memchr(buf, val, len)  memchr(buf, val, len)
+
+
+/**
+ * nodes which have at least FDT_SORTED_INDEX_MIN children or properties get
+ * a sorted index at load, so name lookups use binary search instead of
+ * scanning the list. Set it to 0 to disable the index and save memory.
+ */
+#ifndef FDT_SORTED_INDEX_MIN
+#define  FDT_SORTED_INDEX_MIN       16
+#endif
+
+
+/**
+ * you should replace the atomic function with your own if your compiler
+ * does not provide __atomic builtins.
+ */
+#define  fdt_atomic_load(ptr)            __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define  fdt_atomic_store(ptr, val)      __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST)
+#define  fdt_atomic_xchg(ptr, val)       __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST)
+#define  fdt_atomic_add(ptr, val)        __atomic_add_fetch(ptr, val, __ATOMIC_SEQ_CST)
+#define  fdt_atomic_sub(ptr, val)        __atomic_sub_fetch(ptr, val, __ATOMIC_SEQ_CST)
+#define  fdt_atomic_cas(ptr, old, val)   __atomic_compare_exchange_n(ptr, old, val, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+
+/**
+ * you should replace it with yield function of your os, it is called
+ * while fdt_load() waits for readers.
+ */
+#ifdef x86_64
+#define  fdt_cpu_relax()                 sched_yield()
+#else
+#define  fdt_cpu_relax()
+#endif
+
+
+/**
+ * you should replace it with the millisecond clock of your os, it is used
+ * for the timeout of fdt_wait_node(). Without it, only a timeout of 0 is kept.
+ */
+#ifdef x86_64
+#include <time.h>
+static inline uint64_t fdt_get_time_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+#else
+#define  fdt_get_time_ms()               0
+#endif
+
+
+/**
+ * fdt_crc32() verifies blobs with FDT_FLAG_CRC32 with slice-by-8 tables,
+ * define fdt_crc32_hw(crc, data, len) with the CRC unit of your chip to
+ * replace them. It is CRC-32 of IEEE 802.3 and continues crc as zlib crc32().
+ */
+// #define  fdt_crc32_hw(crc, data, len)   hal_crc32(crc, data, len)
+
+
+/**
+ * fdt_load_parallel() builds nodes in arenas of FDT_ARENA_BLOCK_SIZE bytes.
+ * Define FDT_PARALLEL and replace the thread functions with those of your
+ * os to build them in several threads.
+ */
+#ifndef FDT_ARENA_BLOCK_SIZE
+#define  FDT_ARENA_BLOCK_SIZE            (64 * 1024)
+#endif
+
+/**
+ * fdt_query() keeps the match state of a node in a 64-bit mask, one bit per
+ * pattern segment, so a pattern has at most 63 segments.
+ */
+#define  FDT_QUERY_MAX_SEGMENTS          63
+
+#ifdef FDT_PARALLEL
+#include <pthread.h>
+typedef pthread_t fdt_thread_t;
+#define  fdt_thread_create(thread, func, arg)    pthread_create(thread, NULL, func, arg)
+#define  fdt_thread_join(thread)                 pthread_join(thread, NULL)
+#endif
 
 
 /**
@@ -74,27 +160,51 @@ typedef struct fdt_list_node {
  * @FDT_PROP_STRING : string type.
  * @FDT_PROP_INT    : integer type.
  * @FDT_PROP_ARRAY  : array type.
+ * @FDT_PROP_BYTES  : raw bytes type, 32-bit length.
+ * @FDT_PROP_LONG_ARRAY: array type with 32-bit element count, reported as FDT_PROP_ARRAY.
+ * @FDT_PROP_REF    : node references, 8-bit count followed by node paths.
  * @FDT_PROP_INVALID: invalid value
  */
 typedef enum {
     FDT_PROP_STRING = 0, // string offset
     FDT_PROP_INT = 1,    // int offset,
     FDT_PROP_ARRAY = 32, // array offset  
+    FDT_PROP_BYTES = 64, // bytes offset, followed by 32-bit length
+    FDT_PROP_REF = 65,   // reference offset, followed by 8-bit count and node paths
+    FDT_PROP_LONG_ARRAY = 96, // long array offset, followed by 32-bit count
     FDT_PROP_INVALID = 256
 
 }fdt_prop_type_t;
 
 
+/**
+ * @brief Streaming reader over a bytes or array property.
+ * @data: first byte of the property payload, it points into the blob.
+ * @size: payload size in bytes.
+ * @pos: current read position.
+ */
+typedef struct fdt_prop_stream {
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t pos;
+
+}fdt_prop_stream_t;
+
+
 /** 
  * @brief Property node.
  * @node: next node.
  * @name: property name.
  * @offset: offset of property value.
+ * @hash: hash of property name, see fdt_hash_name().
+ * @name_len: length of property name.
  */
 typedef struct fdt_prop {
     fdt_list_node_t node;
     const char* name;
     const void* offset;
+    uint16_t hash;
+    uint16_t name_len;
 
 }fdt_prop_t;
 
@@ -106,6 +216,11 @@ typedef struct fdt_prop {
  * @child: child of node
  * @name: node name.
  * @prop: property list head of node.
+ * @index: sorted index of children and properties, NULL for small nodes.
+ * @lazy: blob position of properties and children not created yet, NULL
+ *        once they are, see fdt_node_expand().
+ * @hash: hash of node name, see fdt_hash_name().
+ * @name_len: length of node name.
  */
 typedef struct fdt_node {
     struct fdt_node *parent;
@@ -113,10 +228,334 @@ typedef struct fdt_node {
     fdt_list_node_t child;
     const char *name;
     fdt_list_node_t prop;
+    struct fdt_index *index;
+    const void *lazy;
+    uint16_t hash;
+    uint16_t name_len;
 
 }fdt_node_t;
 
 
+/**
+ * @brief Slot of perfect hash table.
+ * @hash: low 32 bits of path hash, see fdt_hash_path().
+ * @ordinal: document order index of node or property.
+ * @owner: document order index of the node owning the property, 0 for nodes.
+ */
+typedef struct fdt_phash_entry {
+    uint32_t hash;
+    uint32_t ordinal;
+    uint32_t owner;
+
+}fdt_phash_entry_t;
+
+
+/**
+ * @brief Perfect hash table over full paths, generated with the blob.
+ * @count: number of slots, it is the number of distinct paths.
+ * @total: number of nodes or properties in the blob, in document order.
+ * @disp: displacement of each bucket, see fdt_phash_slot().
+ * @entry: slots.
+ */
+typedef struct fdt_phash_table {
+    uint32_t count;
+    uint32_t total;
+    const int32_t *disp;
+    const fdt_phash_entry_t *entry;
+
+}fdt_phash_table_t;
+
+
+/**
+ * @brief Perfect hash tables of a blob.
+ * @node: table over node paths, such as "/uart/serial0".
+ * @prop: table over property paths, such as "/uart/serial0/reg".
+ */
+typedef struct fdt_phash {
+    fdt_phash_table_t node;
+    fdt_phash_table_t prop;
+
+}fdt_phash_t;
+
+
+/**
+ * @brief Allocator of nodes, properties and tables built by fdt_load().
+ * @alloc: allocate size bytes aligned for pointers, return NULL if fail.
+ * @free: free memory returned by alloc.
+ * @ctx: context passed to alloc and free.
+ */
+typedef struct fdt_allocator {
+    void* (*alloc)(void *ctx, size_t size);
+    void (*free)(void *ctx, void *ptr);
+    void *ctx;
+
+}fdt_allocator_t;
+
+
+/**
+ * @brief Pool of fixed-size blocks, free blocks are linked in themselves.
+ * @base: first block.
+ * @end: end of the last block.
+ * @block_size: size of each block.
+ * @free_list: first free block.
+ * @used: number of blocks in use.
+ * @peak: the most blocks in use at once.
+ * @lock: spin lock of free_list, used and peak.
+ */
+typedef struct fdt_pool {
+    uint8_t *base;
+    uint8_t *end;
+    uint32_t block_size;
+    void *free_list;
+    uint32_t used;
+    uint32_t peak;
+    uint32_t lock;
+
+}fdt_pool_t;
+
+
+/**
+ * @brief Memory footprint of the loaded tree, in bytes.
+ * @node: node structs.
+ * @prop: property structs, including targets of reference properties.
+ * @index: sorted indexes of nodes.
+ * @table: perfect hash tables and alias table.
+ * @slack: unused tails and headers of arena blocks.
+ * @total: sum of above, the same as fdt_debug_get_consume_bytes().
+ * @peak: the most bytes held at once, both trees count while fdt_load() replaces one with the other.
+ * @budget: memory budget of a tree, 0 if unlimited.
+ */
+typedef struct fdt_mem_stats {
+    uint64_t node;
+    uint64_t prop;
+    uint64_t index;
+    uint64_t table;
+    uint64_t slack;
+    uint64_t total;
+    uint64_t peak;
+    uint64_t budget;
+
+}fdt_mem_stats_t;
+
+
+/**
+ * @brief Allocator with one pool for nodes and one for properties, other
+ *        sizes and allocations beyond the pools go to fallback.
+ * @allocator: pass it to fdt_set_allocator().
+ * @node: pool of fdt_node_t.
+ * @prop: pool of fdt_prop_t.
+ * @fallback: allocator of other sizes, alloc is NULL if there is none.
+ */
+typedef struct fdt_pool_allocator {
+    fdt_allocator_t allocator;
+    fdt_pool_t node;
+    fdt_pool_t prop;
+    fdt_allocator_t fallback;
+
+}fdt_pool_allocator_t;
+
+
+/**
+ * @brief Flags of fdt_load_ex().
+ * @FDT_LOAD_LAZY: only create top-level nodes at load, properties and children
+ *                 of a node are created from the blob on first access. The
+ *                 blob must stay valid while the tree is loaded. phash is
+ *                 ignored in this mode.
+ * @FDT_LOAD_SKIP_CRC: do not verify the checksum of a blob with FDT_FLAG_CRC32,
+ *                 for a warm boot from a blob which is verified before.
+ */
+#define FDT_LOAD_LAZY               0x01
+#define FDT_LOAD_SKIP_CRC           0x02
+
+
+/**
+ * @brief Options of fdt_load_ex().
+ * @phash: perfect hash table generated with the blob, or NULL. Path lookups
+ *         use it instead of walking the tree.
+ * @flags: FDT_LOAD_* flags.
+ */
+typedef struct fdt_load_opts {
+    const fdt_phash_t *phash;
+    uint32_t flags;
+
+}fdt_load_opts_t;
+
+
+/**
+ * @brief Layer of fdt_load_layers().
+ * @dtb: fdt blob, it must stay valid while the tree is loaded.
+ * @dtb_size: fdt blob size.
+ */
+typedef struct fdt_layer {
+    const void *dtb;
+    uint64_t dtb_size;
+
+}fdt_layer_t;
+
+
+/**
+ * @brief Return codes of fdt_walk() callbacks, a negative value aborts the walk.
+ * @FDT_WALK_CONTINUE: go on.
+ * @FDT_WALK_SKIP: skip the rest of current node, its end_node is still called.
+ *                 It jumps over the subtree if the blob has FDT_FLAG_SUBTREE_SIZE.
+ * @FDT_WALK_STOP: stop the walk at once.
+ */
+typedef enum {
+    FDT_WALK_CONTINUE = 0,
+    FDT_WALK_SKIP = 1,
+    FDT_WALK_STOP = 2,
+
+}fdt_walk_ret_t;
+
+
+/**
+ * @brief Node visited by fdt_walk(), name points into the blob.
+ * @name: node name, "/" for root node.
+ * @name_len: length of node name.
+ * @hash: hash of node name, see fdt_hash_name().
+ * @level: level of node, root node is 0.
+ * @size: byte length of its properties and descendants, 0 without FDT_FLAG_SUBTREE_SIZE.
+ * @prop_size: byte length of its own properties, 0 without FDT_FLAG_SUBTREE_SIZE.
+ */
+typedef struct fdt_walk_node {
+    const char *name;
+    uint16_t name_len;
+    uint16_t hash;
+    uint8_t level;
+    uint32_t size;
+    uint32_t prop_size;
+
+}fdt_walk_node_t;
+
+
+/**
+ * @brief Property visited by fdt_walk(), values point into the blob.
+ * @name: property name.
+ * @name_len: length of property name.
+ * @hash: hash of property name, see fdt_hash_name().
+ * @type: FDT_PROP_STRING, FDT_PROP_INT, FDT_PROP_ARRAY or FDT_PROP_BYTES.
+ * @value: raw value starting with type byte, the same as offset of fdt_prop_t.
+ * @size: size of raw value in bytes.
+ * @string: value of string property.
+ * @integer: value of integer property, the low 8 bytes if it is wider.
+ * @data: cells of integer and array property, payload of bytes property.
+ * @cell_size: size of one cell in bytes, 1 for bytes property.
+ * @count: number of cells, 1 for integer property.
+ */
+typedef struct fdt_walk_prop {
+    const char *name;
+    uint16_t name_len;
+    uint16_t hash;
+    fdt_prop_type_t type;
+    const void *value;
+    uint32_t size;
+    const char *string;
+    uint64_t integer;
+    const uint8_t *data;
+    uint8_t cell_size;
+    uint32_t count;
+
+}fdt_walk_prop_t;
+
+
+/**
+ * @brief Callbacks of fdt_walk(), any of them can be NULL.
+ * @begin_node: called at the start of each node, root node first.
+ * @prop: called for each property of current node, before its children.
+ * @end_node: called after all properties and children of node, with its level.
+ */
+typedef struct fdt_walk_ops {
+    int (*begin_node)(void *ctx, const fdt_walk_node_t *node);
+    int (*prop)(void *ctx, const fdt_walk_prop_t *prop);
+    int (*end_node)(void *ctx, uint8_t level);
+
+}fdt_walk_ops_t;
+
+
+/**
+ * @brief Node of compact tree, all fields are 16 bits.
+ * @name: offset of node name in blob.
+ * @hash: hash of node name, see fdt_hash_name().
+ * @parent: index of parent node, the root node is its own parent.
+ * @child: index of the first child, 0 if none.
+ * @next: index of the next sibling, 0 if none.
+ * @prop: index of the first property, properties of a node are contiguous.
+ * @prop_count: number of properties.
+ */
+typedef struct fdt_compact_node {
+    uint16_t name;
+    uint16_t hash;
+    uint16_t parent;
+    uint16_t child;
+    uint16_t next;
+    uint16_t prop;
+    uint16_t prop_count;
+
+}fdt_compact_node_t;
+
+
+/**
+ * @brief Property of compact tree.
+ * @name: offset of property name in blob.
+ * @hash: hash of property name.
+ * @value: offset of property value in blob, it starts with type byte.
+ */
+typedef struct fdt_compact_prop {
+    uint16_t name;
+    uint16_t hash;
+    uint16_t value;
+
+}fdt_compact_prop_t;
+
+
+/**
+ * @brief Compact tree of a blob up to 64KB, it holds no pointer, so it can
+ *        be copied, or kept in retained RAM and used again with the same blob.
+ *        It is followed by nodes in document order and then properties,
+ *        node 0 is root.
+ * @magic: FDT_COMPACT_MAGIC.
+ * @flags: FDT_FLAG_* format flags of blob.
+ * @blob_size: size of blob.
+ * @node_count: number of nodes.
+ * @prop_count: number of properties.
+ * @crc: fdt_crc32() of blob, low half first.
+ */
+typedef struct fdt_compact {
+    uint16_t magic;
+    uint16_t flags;
+    uint16_t blob_size;
+    uint16_t node_count;
+    uint16_t prop_count;
+    uint16_t crc[2];
+
+}fdt_compact_t;
+
+#define FDT_COMPACT_MAGIC           0x6366
+
+
+/**
+ * @brief Get the slot of path hash in perfect hash table.
+ * @param disp: displacement of each bucket.
+ * @param count: number of slots.
+ * @param hash: path hash.
+ * @return slot, a negative displacement is the slot itself.
+ */
+static inline uint32_t fdt_phash_slot(const int32_t *disp, uint32_t count, uint64_t hash)
+{
+    int32_t d = disp[(uint32_t)hash % count];
+    uint32_t h = (uint32_t)(hash >> 32) ^ (uint32_t)d;
+
+    if(d < 0) {
+        return (uint32_t)(-(d + 1));
+    }
+
+    h ^= h >> 16; h *= 0x85ebca6bu;
+    h ^= h >> 13; h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h % count;
+}
+
+
 /**
  * @brief Get the offset of internal members of the structure
  * 
@@ -203,21 +642,457 @@ typedef struct fdt_node {
 #define FDT_MAGIC                   0x746466
 
 
+/**
+ * @brief FDT magic number of extended format. meaning "fdx"
+ * the version is followed by a byte of FDT_FLAG_* flags.
+ */
+#define FDT_MAGIC_EXT               0x786466
+
+
+/**
+ * @brief Flags of extended format.
+ * @FDT_FLAG_NAME_HASH: each node and property name is prefixed by its
+ *                      length (1 byte) and hash (2 bytes, little endian).
+ * @FDT_FLAG_SUBTREE_SIZE: each node name, root included, is followed by the
+ *                      byte length of its subtree and of its own properties
+ *                      (4 bytes each, little endian), counted from the end
+ *                      of these two fields.
+ * @FDT_FLAG_CRC32: the flags byte is followed by the blob size and the
+ *                      fdt_crc32() of the blob after these two fields (4 bytes
+ *                      each, little endian), fdt_load() verifies it and
+ *                      fails if the blob size passed in differs.
+ */
+#define FDT_FLAG_NAME_HASH          0x01
+#define FDT_FLAG_SUBTREE_SIZE       0x02
+#define FDT_FLAG_CRC32              0x04
+#define FDT_FLAG_MASK               (FDT_FLAG_NAME_HASH | FDT_FLAG_SUBTREE_SIZE | FDT_FLAG_CRC32)
+
+
+/**
+ * @brief Patch magic number, meaning "fdp".
+ */
+#define FDT_PATCH_MAGIC             0x706466
+
+
+/**
+ * @brief Patch ops, a patch is the header and the ops of the root node.
+ * Ops of a node edit its properties first and then its children, both in
+ * document order of the base blob. Properties which are not covered when
+ * the first child op comes are kept, so are children at FDT_PATCH_END.
+ *
+ * FDT_PATCH_KEEP_PROP count    copy properties
+ * FDT_PATCH_DROP_PROP count    skip properties
+ * FDT_PATCH_SET_PROP size value    copy the next property with a new value
+ * FDT_PATCH_ADD_PROP name size value    add a property
+ * FDT_PATCH_KEEP_NODE count    copy child nodes with their descendants
+ * FDT_PATCH_DROP_NODE count    skip child nodes
+ * FDT_PATCH_EDIT_NODE ops      copy the next child node, edited by ops
+ * FDT_PATCH_ADD_NODE name ops  add a child node, built by ops
+ * FDT_PATCH_END                end of the node
+ *
+ * Ops, counts and sizes are base-128 varints, names are zero terminated
+ * and values are raw values starting with type byte.
+ */
+#define FDT_PATCH_END               0x0
+#define FDT_PATCH_KEEP_PROP         0x1
+#define FDT_PATCH_DROP_PROP         0x2
+#define FDT_PATCH_SET_PROP          0x3
+#define FDT_PATCH_ADD_PROP          0x4
+#define FDT_PATCH_KEEP_NODE         0x5
+#define FDT_PATCH_DROP_NODE         0x6
+#define FDT_PATCH_EDIT_NODE         0x7
+#define FDT_PATCH_ADD_NODE          0x8
+
+// magic, base size, base hash, size, hash, version and flags of result
+#define FDT_PATCH_HEADER_SIZE       23
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
+/**
+ * Thread safety:
+ * Once fdt_load() has returned, all lookup functions and fdt_read_prop_*()
+ * functions only read the tree and keep their state on the caller's stack,
+ * so any number of threads may call them concurrently without locks.
+ * fdt_load() and fdt_unload() may run concurrently with readers, readers
+ * keep nodes and properties valid with fdt_read_begin()/fdt_read_end().
+ * Only one fdt_load() or fdt_unload() runs at a time, a concurrent call
+ * fails.
+ * A tree loaded with FDT_LOAD_LAZY is still safe for concurrent readers,
+ * fdt_node_expand() creates a node's members under a per-tree spin lock
+ * and publishes them before readers can see them.
+ * Expansion, the free of a replaced tree and fdt_load_parallel() call the
+ * allocator of fdt_set_allocator() from several threads, so it must be
+ * thread safe, fdt_pool_allocator_init() is.
+ */
+
+
 /**
  * @brief load fdt blob.
  * @param dtb: fdt blob.
  * @param dtb_size: fdt blob size.
  * @return 0 if success, or -1.
  * @note: fdt_load() must be called before any other functions.
+ *        Calling it again reloads fdt, the previous tree is kept if it fails.
  */
 int fdt_load(const void *dtb, const uint64_t dtb_size);
 
 
+/**
+ * @brief load fdt blob with options.
+ * @param dtb: fdt blob.
+ * @param dtb_size: fdt blob size.
+ * @param opts: options, NULL is the same as fdt_load().
+ * @return 0 if success, or -1.
+ */
+int fdt_load_ex(const void *dtb, const uint64_t dtb_size, const fdt_load_opts_t *opts);
+
+
+/**
+ * @brief load several fdt blobs as one tree, e.g. soc, board and product blobs.
+ * @param layers: blobs, lowest layer first.
+ * @param count: number of layers.
+ * @param opts: options, NULL is the same as fdt_load(). FDT_LOAD_LAZY and phash
+ *              are only valid for one layer.
+ * @return 0 if success, or -1.
+ * @note a node of an upper layer with the name of an existing node extends it,
+ *       a property with the name of an existing one overrides its value and
+ *       keeps its place. Nothing is copied: properties point into the blob of
+ *       the layer which set them, so every blob must stay valid, each one can
+ *       live in its own flash partition. A layer can not remove nodes or
+ *       properties. References resolve across layers, the version is the one
+ *       of the top layer.
+ */
+int fdt_load_layers(const fdt_layer_t *layers, uint32_t count, const fdt_load_opts_t *opts);
+
+
+/**
+ * @brief Apply patch to the loaded tree, write the new blob into buf and load it.
+ * @param dtb: blob of the loaded tree, it must be the base of patch.
+ * @param dtb_size: blob size.
+ * @param patch: patch built by fdt_writer_build_patch().
+ * @param patch_size: patch size.
+ * @param buf: output buffer, it must not overlap dtb which the loaded tree points into.
+ * @param cap: output buffer size.
+ * @param size: output new blob size.
+ * @return 0 if success, or -1 and the loaded tree is kept.
+ * @note readers switch to the new tree as with fdt_load(), dtb can be reused
+ *       for the next patch after it returns.
+ */
+int fdt_apply_patch(const void *dtb, uint32_t dtb_size, const void *patch, uint32_t patch_size,
+                    void *buf, uint32_t cap, uint32_t *size);
+
+
+/**
+ * @brief load fdt blob with several threads.
+ * @param dtb: fdt blob.
+ * @param dtb_size: fdt blob size.
+ * @param nthreads: number of threads, top-level nodes are split into this
+ *                  many groups of about the same size.
+ * @return 0 if success, or -1.
+ * @note: each group is built in its own arena by its own thread and the
+ *        groups are joined under the root in document order. Without
+ *        FDT_PARALLEL the groups are built one by one in the caller.
+ */
+int fdt_load_parallel(const void *dtb, const uint64_t dtb_size, uint32_t nthreads);
+
+
+/**
+ * @brief Load fdt blob in the background, the caller goes on at once.
+ * @param dtb: fdt blob, it must stay valid while the tree is loaded.
+ * @param dtb_size: fdt blob size.
+ * @return 0 if the load is started, or -1.
+ * @note a worker thread publishes a lazy tree (root properties and top-level
+ *       nodes), then expands all nodes in document order. Readers never wait
+ *       for nodes they do not touch: a node which the worker has not reached
+ *       yet is expanded by the reader, as with FDT_LOAD_LAZY. Other loads and
+ *       fdt_unload() fail until it is done, see fdt_load_async_join().
+ *       Without FDT_PARALLEL the whole tree is loaded in the caller.
+ */
+int fdt_load_async(const void *dtb, const uint64_t dtb_size);
+
+
+/**
+ * @brief Wait for the worker of fdt_load_async() to finish.
+ * @param none
+ * @return 0 if the tree is loaded, or -1.
+ * @note call it from one thread, before the next load or fdt_unload().
+ */
+int fdt_load_async_join(void);
+
+
+/**
+ * @brief Wait until a node and its whole subtree are ready.
+ * @param path: node path.
+ * @param timeout_ms: max time to wait for fdt_load_async() to publish its tree.
+ * @return node, or NULL if it is not found or the timeout expires.
+ * @note it only waits for the node itself, parts of its subtree which are not
+ *       built yet are built by the caller. It works with any loaded tree.
+ */
+fdt_node_t* fdt_wait_node(const char *path, uint32_t timeout_ms);
+
+
+/**
+ * @brief Walk fdt blob without building the tree.
+ * @param dtb: fdt blob.
+ * @param dtb_size: fdt blob size.
+ * @param ops: callbacks.
+ * @param ctx: user context passed to callbacks.
+ * @return 0 if the whole blob is walked, FDT_WALK_STOP if a callback stops it,
+ *         or -1 if the blob is invalid or a callback fails.
+ * @note it does not allocate memory and does not touch the loaded tree.
+ */
+int fdt_walk(const void *dtb, const uint64_t dtb_size, const fdt_walk_ops_t *ops, void *ctx);
+
+
+/**
+ * @brief Find property in fdt blob without loading it.
+ * @param dtb: fdt blob.
+ * @param dtb_size: fdt blob size.
+ * @param node_path: node path.
+ * @param name: property name.
+ * @param prop: output property, values point into the blob.
+ * @return 0 if success, or -1.
+ * @note subtrees off the path are skipped, in O(1) each if the blob has
+ *       FDT_FLAG_SUBTREE_SIZE.
+ */
+int fdt_blob_find_prop(const void *dtb, const uint64_t dtb_size, const char *node_path, const char *name,
+                       fdt_walk_prop_t *prop);
+
+
+/**
+ * @brief Set allocator of nodes, properties and tables.
+ * @param allocator: allocator, it is copied. NULL restores fdt_malloc() and fdt_free().
+ * @return 0 if success, or -1 if fdt is loaded.
+ * @note call it before fdt_load() or after fdt_unload(). fdt_load_parallel()
+ *       allocates arena blocks from several threads.
+ */
+int fdt_set_allocator(const fdt_allocator_t *allocator);
+
+
+/**
+ * @brief Set memory budget of a tree, allocations beyond it fail and fdt_load() fails fast.
+ * @param bytes: bytes a tree may consume, 0 is unlimited.
+ * @return 0 if success, or -1 if fdt is loading.
+ * @note lazy nodes expanded after load are limited by it as well, a node
+ *       which cannot be expanded stays lazy and lookups below it fail.
+ */
+int fdt_set_mem_budget(uint64_t bytes);
+
+
+/**
+ * @brief Get memory footprint of the loaded tree.
+ * @param stats: output.
+ * @return 0 if success, or -1.
+ */
+int fdt_get_mem_stats(fdt_mem_stats_t *stats);
+
+
+/**
+ * @brief Get bytes of node and its subtree, use it to find subtrees worth trimming.
+ * @param node: node, the root node excludes itself and tables.
+ * @return bytes, 0 if node is NULL.
+ * @note children of lazy nodes which are not expanded yet cost nothing.
+ */
+uint64_t fdt_get_node_mem_bytes(fdt_node_t *node);
+
+
+/**
+ * @brief Reset the peak of fdt_get_mem_stats() to bytes held now.
+ * @return none
+ */
+void fdt_reset_mem_peak(void);
+
+
+/**
+ * @brief Initialize pool allocator, allocation and free are O(1).
+ * @param pool: pool allocator.
+ * @param nodes: node blocks.
+ * @param node_count: number of node blocks.
+ * @param props: property blocks.
+ * @param prop_count: number of property blocks.
+ * @param fallback: allocator of other sizes, or NULL.
+ * @return none
+ * @note each pool takes and gives blocks under its own spin lock, so it is
+ *       safe for lazy expansion by readers, frees of a reload or
+ *       fdt_load_async() and arenas of fdt_load_parallel(). The fallback is
+ *       called on those paths as well and must be thread safe if they run.
+ */
+void fdt_pool_allocator_init(fdt_pool_allocator_t *pool, fdt_node_t *nodes, uint32_t node_count,
+                             fdt_prop_t *props, uint32_t prop_count, const fdt_allocator_t *fallback);
+
+
+/**
+ * @brief Build compact tree of blob.
+ * @param dtb: fdt blob, it is smaller than 64KB.
+ * @param dtb_size: fdt blob size.
+ * @param buf: output buffer, it is aligned to 2 bytes. If the value is NULL,
+ *             only size is returned.
+ * @param cap: output buffer size.
+ * @param size: output size of compact tree.
+ * @return 0 if success, or -1.
+ */
+int fdt_compact_build(const void *dtb, const uint64_t dtb_size, void *buf, uint32_t cap, uint32_t *size);
+
+
+/**
+ * @brief Check that compact tree is built from blob, call it before using
+ *        a compact tree kept across reset or copied from elsewhere. The
+ *        whole blob is hashed, so a blob changed in place does not match.
+ * @param ct: compact tree.
+ * @param dtb: fdt blob.
+ * @param dtb_size: fdt blob size.
+ * @return 0 if it matches, or -1.
+ */
+int fdt_compact_check(const fdt_compact_t *ct, const void *dtb, const uint64_t dtb_size);
+
+
+/**
+ * @brief Find node of compact tree by path.
+ * @param ct: compact tree.
+ * @param dtb: fdt blob.
+ * @param path: node path, "/" is the root node.
+ * @return index of node, or -1.
+ */
+int fdt_compact_find_node(const fdt_compact_t *ct, const void *dtb, const char *path);
+
+
+/**
+ * @brief Find property of compact tree node and decode its value.
+ * @param ct: compact tree.
+ * @param dtb: fdt blob.
+ * @param node: index of node.
+ * @param name: property name.
+ * @param prop: output property, values point into the blob.
+ * @return 0 if success, or -1.
+ */
+int fdt_compact_find_prop(const fdt_compact_t *ct, const void *dtb, uint32_t node, const char *name, fdt_walk_prop_t *prop);
+
+
+/**
+ * @brief Get nodes of compact tree.
+ * @param ct: compact tree.
+ * @return nodes, they follow the header.
+ */
+static inline const fdt_compact_node_t* fdt_compact_nodes(const fdt_compact_t *ct)
+{
+    return (const fdt_compact_node_t*)(ct + 1);
+}
+
+
+/**
+ * @brief Get properties of compact tree.
+ * @param ct: compact tree.
+ * @return properties, they follow nodes.
+ */
+static inline const fdt_compact_prop_t* fdt_compact_props(const fdt_compact_t *ct)
+{
+    return (const fdt_compact_prop_t*)(fdt_compact_nodes(ct) + ct->node_count);
+}
+
+
+/**
+ * @brief Get name of compact tree node.
+ * @param ct: compact tree.
+ * @param dtb: fdt blob.
+ * @param node: index of node.
+ * @return node name.
+ */
+static inline const char* fdt_compact_node_name(const fdt_compact_t *ct, const void *dtb, uint32_t node)
+{
+    return (const char*)dtb + fdt_compact_nodes(ct)[node].name;
+}
+
+
+/**
+ * @brief for each child of compact tree node.
+ * @param ct: compact tree.
+ * @param parent_node: index of parent node.
+ * @param child_node: index of child node, an unsigned integer.
+ * @note it is a for each loop, children are visited in document order.
+ */
+#define fdt_compact_for_each_child(ct, parent_node, child_node) \
+    for(child_node = fdt_compact_nodes(ct)[parent_node].child; child_node; child_node = fdt_compact_nodes(ct)[child_node].next)
+
+
+/**
+ * @brief unload fdt, free all nodes and properties.
+ * @param none
+ * @return none
+ * @note it waits until all readers have left, see fdt_read_begin().
+ */
+void fdt_unload(void);
+
+
+/**
+ * @brief Enter a read-side critical section.
+ * @param none
+ * @return epoch token, pass it to fdt_read_end().
+ * @note fdt_load() and fdt_unload() publish the new tree with one pointer
+ *       swap and free the previous tree only after every reader has left.
+ *       Nodes and properties got inside the section stay valid until
+ *       fdt_read_end(). Readers never block. It is not needed if the
+ *       tree is never reloaded.
+ */
+int fdt_read_begin(void);
+
+
+/**
+ * @brief Leave a read-side critical section.
+ * @param epoch: token returned by fdt_read_begin().
+ * @return none
+ */
+void fdt_read_end(int epoch);
+
+
+/**
+ * @brief Hash of node or property name.
+ * @param name: name, it does not need to be terminated by zero.
+ * @param len: length of name.
+ * @return hash, it is the value stored in the blob with FDT_FLAG_NAME_HASH.
+ */
+uint16_t fdt_hash_name(const char *name, uint32_t len);
+
+
+/**
+ * @brief CRC-32 of IEEE 802.3, the checksum of blobs with FDT_FLAG_CRC32.
+ * @param crc: crc of previous data, 0 for the first.
+ * @param data: data.
+ * @param len: length of data.
+ * @return crc, the same as zlib crc32().
+ * @note it calls fdt_crc32_hw() if it is defined.
+ */
+uint32_t fdt_crc32(uint32_t crc, const void *data, size_t len);
+
+
+/**
+ * @brief FNV-1a hash of blob, a patch records it for its base and result.
+ * @param data: blob.
+ * @param size: blob size.
+ * @return 32-bit hash.
+ */
+uint32_t fdt_patch_hash(const void *data, uint32_t size);
+
+
+/**
+ * @brief Hash of node path, segments are normalized like fdt_find_node_by_path().
+ * @param path: node path.
+ * @return 64-bit hash.
+ */
+uint64_t fdt_hash_path(const char *path);
+
+
+/**
+ * @brief Hash of property path, the last segment is the property name.
+ * @param path: property path.
+ * @return 64-bit hash.
+ */
+uint64_t fdt_hash_prop_path(const char *path);
+
+
 /**
  * @brief Get root node of fdt.
  * @param none
@@ -235,11 +1110,23 @@ fdt_node_t* fdt_get_root_node(void);
 uint64_t fdt_get_version(void);
 
 
+/**
+ * @brief Create properties and children of a node loaded with FDT_LOAD_LAZY.
+ * @param node: node.
+ * @return 0 if success, or -1.
+ * @note lookup functions call it by themselves, call it before
+ *       fdt_for_each_node_child() and fdt_for_each_node_prop(). It does
+ *       nothing for a node which is already expanded.
+ */
+int fdt_node_expand(fdt_node_t *node);
+
+
 /**
  * @brief for each child of node.
  * @param parent_node: parent node.
  * @param child_node: child node.
- * @note it is a for each loop.
+ * @note it is a for each loop, children are visited in document order.
+ *       Call fdt_node_expand() first if the tree is loaded with FDT_LOAD_LAZY.
  */
 #define fdt_for_each_node_child(parent_node, child_node)   fdt_list_for_each_entry(child_node, &parent_node->child, fdt_node_t, entry)
 
@@ -249,6 +1136,7 @@ uint64_t fdt_get_version(void);
  * @param parent_node: parent node.
  * @param node_prop: property of node.
  * @note it is a for each loop.
+ *       Call fdt_node_expand() first if the tree is loaded with FDT_LOAD_LAZY.
  */
 #define fdt_for_each_node_prop(parent_node, node_prop)     fdt_list_for_each_entry(node_prop, &parent_node->prop, fdt_prop_t, node)
 
@@ -266,10 +1154,38 @@ fdt_node_t* fdt_find_node_by_name(fdt_node_t *parent, const char *name);
  * @brief Find node by path.
  * @param path: node path.
  * @return node of found node, or NULL.
+ * @note path segments are compared in place, so path length is not limited
+ *       and no buffer is used. "/" is the root node. If the first segment of
+ *       a path without leading '/' is an alias of /aliases, the path starts
+ *       from the aliased node, e.g. "serial0/foo".
  */
 fdt_node_t* fdt_find_node_by_path(const char *path);
 
 
+/**
+ * @brief Find node by alias, a string property of /aliases node whose value is a node path.
+ * @param alias: alias name, e.g. "serial0".
+ * @return aliased node, or NULL.
+ * @note aliases are hashed and resolved once at load, so it is O(1). Those
+ *       of a tree loaded with FDT_LOAD_LAZY are resolved on first use.
+ */
+fdt_node_t* fdt_find_node_by_alias(const char *alias);
+
+
+/**
+ * @brief Find all nodes matching a path pattern, in one pruned traversal.
+ * @param pattern: path pattern, "*" matches any characters and "?" one character
+ *        within a name, a "**" segment matches zero or more levels. So "/spi?"
+ *        matches top-level nodes spi0 to spi9, and segments "**" then "led*"
+ *        match led nodes at any level. At most FDT_QUERY_MAX_SEGMENTS segments.
+ * @param out: output buffer of matched nodes in document order, it can be NULL.
+ * @param max: capacity of output buffer.
+ * @return number of matched nodes, it can be more than max, or -1.
+ * @note each node is visited at most once, subtrees that can not match are skipped.
+ */
+int fdt_query(const char *pattern, fdt_node_t **out, uint32_t max);
+
+
 /**
  * @brief Find property by name.
  * @param node: node.
@@ -301,7 +1217,8 @@ const char* fdt_read_prop_string(fdt_node_t *node, const char *name);
  * @param node: node.
  * @param name: property name.
  * @param value: property value.
- * @return 0 if success, or -1.
+ * @return 0 if success, or -1 if it fails, the cell is wider than 8 bytes or
+ *         the value does not fit in size_t.
  */
 int fdt_read_prop_int(fdt_node_t *node, const char *name, size_t *value);
 
@@ -311,10 +1228,94 @@ int fdt_read_prop_int(fdt_node_t *node, const char *name, size_t *value);
  * 
  * @param node: node
  * @param name: property name
+ * @param index: index of cell
  * @param value: property value
- * @return int: 0: success, -1: fail
+ * @return int: 0: success, -1: fail, cell is wider than 8 bytes or value
+ *         does not fit in size_t
+ */
+int fdt_read_prop_int_index(fdt_node_t *node, const char *name, uint32_t index, size_t *value);
+
+
+/**
+ * @brief Read property value for integer type as uint32_t.
+ * @param node: node.
+ * @param name: property name, the first cell is read for array type.
+ * @param value: property value.
+ * @return 0 if success, or -1 if it is not found or does not fit.
+ */
+int fdt_read_prop_u32(fdt_node_t *node, const char *name, uint32_t *value);
+
+
+/**
+ * @brief Read property value for integer type as uint64_t.
+ * @param node: node.
+ * @param name: property name, the first cell is read for array type.
+ * @param value: property value.
+ * @return 0 if success, or -1 if it is not found or does not fit.
+ */
+int fdt_read_prop_u64(fdt_node_t *node, const char *name, uint64_t *value);
+
+
+/**
+ * @brief Read property value for integer type as int32_t, it is sign
+ *        extended from the cell width.
+ * @param node: node.
+ * @param name: property name, the first cell is read for array type.
+ * @param value: property value.
+ * @return 0 if success, or -1 if it is not found or does not fit.
+ */
+int fdt_read_prop_s32(fdt_node_t *node, const char *name, int32_t *value);
+
+
+/**
+ * @brief Read property payload for bytes or array type, without copying.
+ * @param node: node.
+ * @param name: property name.
+ * @param data: pointer to the payload in the blob.
+ * @param len: payload size in bytes.
+ * @return 0 if success, or -1.
+ */
+int fdt_read_prop_bytes(fdt_node_t *node, const char *name, const void **data, uint32_t *len);
+
+
+/**
+ * @brief Read node referenced by property of reference type.
+ * @param node: node.
+ * @param name: property name.
+ * @param index: index of reference.
+ * @return referenced node, or NULL if index is beyond the references.
+ * @note references are resolved once at load, with FDT_LOAD_LAZY on first read.
+ */
+fdt_node_t* fdt_read_prop_node(fdt_node_t *node, const char *name, uint32_t index);
+
+
+/**
+ * @brief Open a streaming reader over a bytes or array property.
+ * @param node: node.
+ * @param name: property name.
+ * @param stream: reader to initialize.
+ * @return 0 if success, or -1.
  */
-int fdt_read_prop_int_index(fdt_node_t *node, const char *name, uint8_t index, size_t *value);
+int fdt_prop_stream_open(fdt_node_t *node, const char *name, fdt_prop_stream_t *stream);
+
+
+/**
+ * @brief Get the next window of a streaming reader, without copying.
+ * @param stream: reader.
+ * @param window: max number of bytes wanted.
+ * @param chunk: pointer to the window in the blob.
+ * @return number of bytes in the window, 0 at the end of the payload.
+ */
+uint32_t fdt_prop_stream_next(fdt_prop_stream_t *stream, uint32_t window, const void **chunk);
+
+
+/**
+ * @brief Move the read position of a streaming reader.
+ * @param stream: reader.
+ * @param offset: new read position from the start of the payload.
+ * @return 0 if success, or -1 if offset is beyond the payload.
+ */
+int fdt_prop_stream_seek(fdt_prop_stream_t *stream, uint32_t offset);
 
 
 /**
@@ -344,7 +1345,55 @@ int fdt_read_prop_int_by_path(const char *node_path, const char *name, size_t *v
  * @param value: property value
  * @return int: 0: success, -1: fail
  */
-int fdt_read_prop_int_index_by_path(const char *node_path, const char *name, uint8_t index, size_t *value);
+int fdt_read_prop_int_index_by_path(const char *node_path, const char *name, uint32_t index, size_t *value);
+
+
+/**
+ * @brief Read bytes or array property payload by path.
+ * @param node_path: node path.
+ * @param name: property name.
+ * @param data: pointer to the payload in the blob.
+ * @param len: payload size in bytes.
+ * @return 0 if success, or -1.
+ */
+int fdt_read_prop_bytes_by_path(const char *node_path, const char *name, const void **data, uint32_t *len);
+
+
+/**
+ * @brief get size of property value in blob.
+ * @param prop: property.
+ * @return size of value in bytes, including the type byte.
+ */
+uint32_t fdt_get_prop_value_size(const fdt_prop_t *prop);
+
+
+/**
+ * @brief get type of property value.
+ * @param prop: property.
+ * @return property type, FDT_PROP_INVALID if the value is invalid.
+ */
+fdt_prop_type_t fdt_get_prop_value_type(const fdt_prop_t *prop);
+
+
+/**
+ * @brief get cells of int or array property, without copying.
+ * @param prop: property.
+ * @param cells: pointer to the first cell in the blob, cells are little endian.
+ * @param cell_size: bytes of each cell.
+ * @param count: number of cells, 1 for int property.
+ * @return 0 if success, or -1 if property is not int or array.
+ */
+int fdt_get_prop_cells(const fdt_prop_t *prop, const void **cells, uint8_t *cell_size, uint32_t *count);
+
+
+/**
+ * @brief get payload of bytes or array property, without copying.
+ * @param prop: property.
+ * @param data: pointer to the payload in the blob.
+ * @param len: payload size in bytes.
+ * @return 0 if success, or -1 if property is not bytes or array.
+ */
+int fdt_get_prop_payload(const fdt_prop_t *prop, const void **data, uint32_t *len);
 
 
 /**
@@ -401,6 +1450,15 @@ void fdt_debug_put_node_info(fdt_node_t *node);
 uint64_t fdt_debug_get_consume_bytes(void);
 
 
+/**
+ * @brief Debug print memory footprint and bytes of each top-level subtree.
+ * @param none
+ * @return void.
+ * @note you should call it in debug mode.
+ */
+void fdt_debug_put_mem_report(void);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,486 @@
+/*
+ * File Name: fdt.hpp
+ *
+ * Copyright 2024-, lishanwen (1477153217@qq.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FDT_HPP__
+#define __FDT_HPP__
+
+#include "fdt.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+
+/**
+ * C++17 wrapper of fdt.h, header only. Every type is a pointer sized value
+ * and every call is an inline call of the C function, so it compiles to the
+ * same code as the C API. Values point into the blob and the loaded tree,
+ * they stay valid as long as the nodes do, see fdt::read_section.
+ */
+namespace fdt {
+
+
+/**
+ * @brief View over contiguous values, the subset of std::span of C++20 used here.
+ */
+template<typename T>
+class span {
+public:
+    using element_type = T;
+    using value_type = std::remove_cv_t<T>;
+    using size_type = std::size_t;
+    using iterator = T*;
+
+    constexpr span() noexcept = default;
+    constexpr span(T *data, size_type size) noexcept : data_(data), size_(size) {}
+
+    constexpr T* data() const noexcept { return data_; }
+    constexpr size_type size() const noexcept { return size_; }
+    constexpr size_type size_bytes() const noexcept { return size_ * sizeof(T); }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T& operator[](size_type index) const noexcept { return data_[index]; }
+    constexpr iterator begin() const noexcept { return data_; }
+    constexpr iterator end() const noexcept { return data_ + size_; }
+
+private:
+    T *data_ = nullptr;
+    size_type size_ = 0;
+};
+
+
+/**
+ * @brief View over cells of exactly sizeof(T) bytes, see fdt::cells::as().
+ *        The cell size is known at compile time, so loops over it vectorize
+ *        as a loop over a plain array does.
+ */
+template<typename T>
+class cell_span {
+public:
+    static_assert(std::is_integral_v<T> && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8),
+                  "fdt::cell_span reads 1, 2, 4 or 8 byte integers");
+
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = T;
+
+        iterator() noexcept = default;
+        explicit iterator(const uint8_t *pos) noexcept : pos_(pos) {}
+
+        T operator*() const noexcept { return cell_span::load(pos_); }
+        T operator[](difference_type index) const noexcept { return cell_span::load(pos_ + index * sizeof(T)); }
+        iterator& operator++() noexcept { pos_ += sizeof(T); return *this; }
+        iterator operator++(int) noexcept { iterator old = *this; pos_ += sizeof(T); return old; }
+        iterator& operator--() noexcept { pos_ -= sizeof(T); return *this; }
+        iterator operator--(int) noexcept { iterator old = *this; pos_ -= sizeof(T); return old; }
+        iterator& operator+=(difference_type n) noexcept { pos_ += n * sizeof(T); return *this; }
+        iterator& operator-=(difference_type n) noexcept { pos_ -= n * sizeof(T); return *this; }
+        iterator operator+(difference_type n) const noexcept { return iterator(pos_ + n * sizeof(T)); }
+        iterator operator-(difference_type n) const noexcept { return iterator(pos_ - n * sizeof(T)); }
+        difference_type operator-(const iterator &other) const noexcept { return (pos_ - other.pos_) / (difference_type)sizeof(T); }
+        bool operator==(const iterator &other) const noexcept { return pos_ == other.pos_; }
+        bool operator!=(const iterator &other) const noexcept { return pos_ != other.pos_; }
+        bool operator<(const iterator &other) const noexcept { return pos_ < other.pos_; }
+
+    private:
+        const uint8_t *pos_ = nullptr;
+    };
+
+    cell_span() noexcept = default;
+    cell_span(const uint8_t *data, uint32_t count) noexcept : data_(data), count_(count) {}
+
+    const uint8_t* data() const noexcept { return data_; }
+    uint32_t size() const noexcept { return count_; }
+    std::size_t size_bytes() const noexcept { return static_cast<std::size_t>(count_) * sizeof(T); }
+    bool empty() const noexcept { return count_ == 0; }
+    T operator[](uint32_t index) const noexcept { return load(data_ + static_cast<std::size_t>(index) * sizeof(T)); }
+    iterator begin() const noexcept { return iterator(data_); }
+    iterator end() const noexcept { return iterator(data_ + size_bytes()); }
+
+    // cells are not aligned in the blob
+    static T load(const uint8_t *cell) noexcept
+    {
+        T value = 0;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        for(std::size_t i = sizeof(T); i > 0; i--) {
+            value = static_cast<T>((static_cast<uint64_t>(value) << 8) | cell[i - 1]);
+        }
+#else
+        std::memcpy(&value, cell, sizeof(T));
+#endif
+        return value;
+    }
+
+private:
+    const uint8_t *data_ = nullptr;
+    uint32_t count_ = 0;
+};
+
+
+/**
+ * @brief View over the cells of an int or array property. Cells are little
+ *        endian of 1 to 8 bytes, wider cells are left to prop::as_bytes().
+ */
+class cells {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = uint64_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = uint64_t;
+
+        iterator() noexcept = default;
+        iterator(const uint8_t *pos, uint8_t cell_size) noexcept : pos_(pos), cell_size_(cell_size) {}
+
+        uint64_t operator*() const noexcept { return cells::load(pos_, cell_size_); }
+        iterator& operator++() noexcept { pos_ += cell_size_; return *this; }
+        iterator operator++(int) noexcept { iterator old = *this; pos_ += cell_size_; return old; }
+        bool operator==(const iterator &other) const noexcept { return pos_ == other.pos_; }
+        bool operator!=(const iterator &other) const noexcept { return pos_ != other.pos_; }
+
+    private:
+        const uint8_t *pos_ = nullptr;
+        uint8_t cell_size_ = 0;
+    };
+
+    cells() noexcept = default;
+    cells(const void *data, uint8_t cell_size, uint32_t count) noexcept
+        : data_(static_cast<const uint8_t*>(data)), cell_size_(cell_size), count_(count) {}
+
+    const uint8_t* data() const noexcept { return data_; }
+    uint32_t size() const noexcept { return count_; }
+    uint8_t cell_size() const noexcept { return cell_size_; }
+    std::size_t size_bytes() const noexcept { return static_cast<std::size_t>(cell_size_) * count_; }
+    bool empty() const noexcept { return count_ == 0; }
+    uint64_t operator[](uint32_t index) const noexcept { return load(data_ + static_cast<std::size_t>(index) * cell_size_, cell_size_); }
+    iterator begin() const noexcept { return iterator(data_, cell_size_); }
+    iterator end() const noexcept { return iterator(data_ + size_bytes(), cell_size_); }
+
+    /**
+     * @brief View cells as T, for a tight loop over an array.
+     * @return view, or nullopt if cells are not sizeof(T) bytes.
+     */
+    template<typename T>
+    std::optional<cell_span<T>> as() const noexcept
+    {
+        if(cell_size_ != sizeof(T)) {
+            return std::nullopt;
+        }
+        return cell_span<T>(data_, count_);
+    }
+
+    /**
+     * @brief Read one cell, the same as fdt_read_prop_int_index() does.
+     * @param cell: first byte of cell.
+     * @param size: cell size, at most 8 bytes.
+     * @return cell value.
+     */
+    static uint64_t load(const uint8_t *cell, uint8_t size) noexcept
+    {
+        uint64_t value = 0;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if(size == 1 || size == 2 || size == 4 || size == 8) {
+            std::memcpy(&value, cell, size);
+            return value;
+        }
+#endif
+        for(uint8_t i = (size < 8 ? size : 8); i > 0; i--) {
+            value = (value << 8) | cell[i - 1];
+        }
+        return value;
+    }
+
+private:
+    const uint8_t *data_ = nullptr;
+    uint8_t cell_size_ = 0;
+    uint32_t count_ = 0;
+};
+
+
+/**
+ * @brief Range over an intrusive list of the tree, W wraps each entry.
+ */
+template<typename W>
+class list_range {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = W;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = W;
+
+        iterator() noexcept = default;
+        explicit iterator(fdt_list_node_t *pos) noexcept : pos_(pos) {}
+
+        W operator*() const noexcept { return W::from_list(pos_); }
+        iterator& operator++() noexcept { pos_ = pos_->next; return *this; }
+        iterator operator++(int) noexcept { iterator old = *this; pos_ = pos_->next; return old; }
+        bool operator==(const iterator &other) const noexcept { return pos_ == other.pos_; }
+        bool operator!=(const iterator &other) const noexcept { return pos_ != other.pos_; }
+
+    private:
+        fdt_list_node_t *pos_ = nullptr;
+    };
+
+    explicit list_range(fdt_list_node_t *head) noexcept : head_(head) {}
+
+    iterator begin() const noexcept { return iterator(head_->next); }
+    iterator end() const noexcept { return iterator(head_); }
+    bool empty() const noexcept { return head_->next == head_; }
+
+private:
+    fdt_list_node_t *head_;
+};
+
+
+/**
+ * @brief Property, a nullable handle of fdt_prop_t.
+ */
+class prop {
+public:
+    prop() noexcept = default;
+    prop(fdt_prop_t *raw) noexcept : prop_(raw) {}
+
+    static prop from_list(fdt_list_node_t *pos) noexcept
+    {
+        return prop(reinterpret_cast<fdt_prop_t*>(reinterpret_cast<char*>(pos) - offsetof(fdt_prop_t, node)));
+    }
+
+    static prop find(const char *path) noexcept { return fdt_find_prop_by_path(path); }
+
+    fdt_prop_t* get() const noexcept { return prop_; }
+    explicit operator bool() const noexcept { return prop_ != nullptr; }
+    bool operator==(const prop &other) const noexcept { return prop_ == other.prop_; }
+    bool operator!=(const prop &other) const noexcept { return prop_ != other.prop_; }
+
+    std::string_view name() const noexcept { return std::string_view(prop_->name, prop_->name_len); }
+    fdt_prop_type_t type() const noexcept { return fdt_get_prop_value_type(prop_); }
+    uint32_t value_size() const noexcept { return fdt_get_prop_value_size(prop_); }
+
+    /**
+     * @brief Read value as string.
+     * @return string, or nullopt if property is not a string.
+     */
+    std::optional<std::string_view> as_string() const noexcept
+    {
+        const char *value = static_cast<const char*>(prop_->offset);
+        if(*value != FDT_PROP_STRING) {
+            return std::nullopt;
+        }
+        return std::string_view(value + 1);
+    }
+
+    /**
+     * @brief Read value as cells.
+     * @return cells, or nullopt if property is not int or array or its
+     *         cells are wider than 8 bytes.
+     */
+    std::optional<fdt::cells> as_cells() const noexcept
+    {
+        const void *data = nullptr;
+        uint8_t cell_size = 0;
+        uint32_t count = 0;
+
+        if(fdt_get_prop_cells(prop_, &data, &cell_size, &count) || cell_size > 8) {
+            return std::nullopt;
+        }
+        return fdt::cells(data, cell_size, count);
+    }
+
+    /**
+     * @brief Read the first cell as T.
+     * @return value, or nullopt if property is not int or array or it does not fit in T.
+     */
+    template<typename T>
+    std::optional<T> as() const noexcept
+    {
+        static_assert(std::is_integral_v<T>, "fdt::prop::as reads integers");
+        std::optional<fdt::cells> value = as_cells();
+        if(!value || value->empty() || value->cell_size() > sizeof(T)) {
+            return std::nullopt;
+        }
+        return static_cast<T>((*value)[0]);
+    }
+
+    /**
+     * @brief Read payload of bytes or array property.
+     * @return bytes in the blob, or nullopt.
+     */
+    std::optional<span<const uint8_t>> as_bytes() const noexcept
+    {
+        const void *data = nullptr;
+        uint32_t len = 0;
+
+        if(fdt_get_prop_payload(prop_, &data, &len)) {
+            return std::nullopt;
+        }
+        return span<const uint8_t>(static_cast<const uint8_t*>(data), len);
+    }
+
+private:
+    fdt_prop_t *prop_ = nullptr;
+};
+
+
+/**
+ * @brief Node, a nullable handle of fdt_node_t.
+ * @note children() and props() walk the lists as fdt_for_each_node_child()
+ *       and fdt_for_each_node_prop() do, call expand() first on a lazy tree.
+ */
+class node {
+public:
+    node() noexcept = default;
+    node(fdt_node_t *raw) noexcept : node_(raw) {}
+
+    static node from_list(fdt_list_node_t *pos) noexcept
+    {
+        return node(reinterpret_cast<fdt_node_t*>(reinterpret_cast<char*>(pos) - offsetof(fdt_node_t, entry)));
+    }
+
+    static node root() noexcept { return fdt_get_root_node(); }
+    static node find(const char *path) noexcept { return fdt_find_node_by_path(path); }
+    static node alias(const char *name) noexcept { return fdt_find_node_by_alias(name); }
+
+    fdt_node_t* get() const noexcept { return node_; }
+    explicit operator bool() const noexcept { return node_ != nullptr; }
+    bool operator==(const node &other) const noexcept { return node_ == other.node_; }
+    bool operator!=(const node &other) const noexcept { return node_ != other.node_; }
+
+    // root node keeps its name "/" with no length
+    std::string_view name() const noexcept
+    {
+        return node_->name_len ? std::string_view(node_->name, node_->name_len) : std::string_view(node_->name);
+    }
+
+    // parent of root node is root node itself
+    node parent() const noexcept { return node_->parent; }
+    bool expand() const noexcept { return fdt_node_expand(node_) == 0; }
+
+    node child(const char *name) const noexcept { return fdt_find_node_by_name(node_, name); }
+    fdt::prop prop(const char *name) const noexcept { return fdt_find_prop_by_name(node_, name); }
+    list_range<node> children() const noexcept { return list_range<node>(&node_->child); }
+    list_range<fdt::prop> props() const noexcept { return list_range<fdt::prop>(&node_->prop); }
+
+    /**
+     * @brief Read property as T with the C reader of T.
+     * @param name: property name.
+     * @return value, or nullopt if it is missing or does not fit.
+     * @note T is uint32_t, uint64_t, int32_t, size_t, std::string_view,
+     *       or fdt::node for the first reference.
+     */
+    template<typename T>
+    std::optional<T> read(const char *name) const noexcept
+    {
+        if constexpr(std::is_same_v<T, uint32_t>) {
+            uint32_t value = 0;
+            return fdt_read_prop_u32(node_, name, &value) ? std::nullopt : std::optional<T>(value);
+        }
+        else if constexpr(std::is_same_v<T, uint64_t>) {
+            uint64_t value = 0;
+            return fdt_read_prop_u64(node_, name, &value) ? std::nullopt : std::optional<T>(value);
+        }
+        else if constexpr(std::is_same_v<T, int32_t>) {
+            int32_t value = 0;
+            return fdt_read_prop_s32(node_, name, &value) ? std::nullopt : std::optional<T>(value);
+        }
+        else if constexpr(std::is_same_v<T, std::size_t>) {
+            std::size_t value = 0;
+            return fdt_read_prop_int(node_, name, &value) ? std::nullopt : std::optional<T>(value);
+        }
+        else if constexpr(std::is_same_v<T, std::string_view>) {
+            const char *value = fdt_read_prop_string(node_, name);
+            return value ? std::optional<T>(value) : std::nullopt;
+        }
+        else if constexpr(std::is_same_v<T, node>) {
+            fdt_node_t *value = fdt_read_prop_node(node_, name, 0);
+            return value ? std::optional<T>(value) : std::nullopt;
+        }
+        else {
+            static_assert(!std::is_same_v<T, T>, "fdt::node::read has no reader of T");
+        }
+    }
+
+    /**
+     * @brief Read cell of int or array property.
+     * @param name: property name.
+     * @param index: index of cell.
+     * @return value, or nullopt if it is missing, the cell is wider than
+     *         8 bytes or the value does not fit in size_t.
+     */
+    std::optional<std::size_t> read_index(const char *name, uint32_t index) const noexcept
+    {
+        std::size_t value = 0;
+        return fdt_read_prop_int_index(node_, name, index, &value) ? std::nullopt : std::optional<std::size_t>(value);
+    }
+
+    std::optional<fdt::cells> read_cells(const char *name) const noexcept
+    {
+        fdt::prop found = prop(name);
+        return found ? found.as_cells() : std::nullopt;
+    }
+
+    std::optional<span<const uint8_t>> read_bytes(const char *name) const noexcept
+    {
+        const void *data = nullptr;
+        uint32_t len = 0;
+
+        if(fdt_read_prop_bytes(node_, name, &data, &len)) {
+            return std::nullopt;
+        }
+        return span<const uint8_t>(static_cast<const uint8_t*>(data), len);
+    }
+
+    node ref(const char *name, uint32_t index = 0) const noexcept { return fdt_read_prop_node(node_, name, index); }
+
+private:
+    fdt_node_t *node_ = nullptr;
+};
+
+
+/**
+ * @brief Read-side critical section, see fdt_read_begin(), for the scope of the object.
+ */
+class read_section {
+public:
+    read_section() noexcept : epoch_(fdt_read_begin()) {}
+    ~read_section() { fdt_read_end(epoch_); }
+
+    read_section(const read_section&) = delete;
+    read_section& operator=(const read_section&) = delete;
+
+private:
+    int epoch_;
+};
+
+
+} // namespace fdt
+
+
+#endif // !__FDT_HPP__
@@ -1,4 +1,5 @@
 #include "fdt.h"
+#include "fdt-writer.h"
 #include <stdio.h>
 
 extern const void *fdt_dts_blob;
@@ -19,6 +20,135 @@ void ut_case(int result, const char *msg)
 }
 
 
+typedef struct walk_count {
+    int nodes;
+    int props;
+    int ends;
+    int ints;
+    const char *skip;
+    const char *stop;
+
+}walk_count_t;
+
+
+static void* pool_test_alloc(void *ctx, size_t size)
+{
+    fdt_atomic_add((size_t*)ctx, 1);
+    return malloc(size);
+}
+
+
+static void pool_test_free(void *ctx, void *ptr)
+{
+    fdt_atomic_sub((size_t*)ctx, 1);
+    free(ptr);
+}
+
+
+static int walk_begin_node(void *ctx, const fdt_walk_node_t *node)
+{
+    walk_count_t *count = ctx;
+
+    count->nodes ++;
+    if(count->skip && strcmp(node->name, count->skip) == 0) {
+        return FDT_WALK_SKIP;
+    }
+    if(count->stop && strcmp(node->name, count->stop) == 0) {
+        return FDT_WALK_STOP;
+    }
+    return FDT_WALK_CONTINUE;
+}
+
+
+static int walk_prop(void *ctx, const fdt_walk_prop_t *prop)
+{
+    walk_count_t *count = ctx;
+
+    count->props ++;
+    if(prop->type == FDT_PROP_INT && strcmp(prop->name, "int") == 0) {
+        count->ints += (int)prop->integer;
+    }
+    return FDT_WALK_CONTINUE;
+}
+
+
+static int walk_end_node(void *ctx, uint8_t level)
+{
+    walk_count_t *count = ctx;
+
+    (void)level;
+    count->ends ++;
+    return FDT_WALK_CONTINUE;
+}
+
+
+// / { compatible = "t,board"; #address-cells = <1>;
+//     uart@1000 { compatible = "a,uart", "b,uart"; reg = <0x1000 0x100>; clock-frequency = <115200>; dma-coherent; }; };
+static const uint8_t dtb_uart[] = {
+    0xd0, 0x0d, 0xfe, 0xed, 0x00, 0x00, 0x01, 0x07, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0xcc,
+    0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x11, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x3b, 0x00, 0x00, 0x00, 0x94, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x74, 0x2c, 0x62, 0x6f,
+    0x61, 0x72, 0x64, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x0b,
+    0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x75, 0x61, 0x72, 0x74, 0x40, 0x31, 0x30, 0x30,
+    0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x0e, 0x00, 0x00, 0x00, 0x00,
+    0x61, 0x2c, 0x75, 0x61, 0x72, 0x74, 0x00, 0x62, 0x2c, 0x75, 0x61, 0x72, 0x74, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x1a, 0x00, 0x00, 0x10, 0x00,
+    0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x1e,
+    0x00, 0x01, 0xc2, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2e,
+    0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x09, 0x63, 0x6f, 0x6d, 0x70,
+    0x61, 0x74, 0x69, 0x62, 0x6c, 0x65, 0x00, 0x23, 0x61, 0x64, 0x64, 0x72, 0x65, 0x73, 0x73, 0x2d,
+    0x63, 0x65, 0x6c, 0x6c, 0x73, 0x00, 0x72, 0x65, 0x67, 0x00, 0x63, 0x6c, 0x6f, 0x63, 0x6b, 0x2d,
+    0x66, 0x72, 0x65, 0x71, 0x75, 0x65, 0x6e, 0x63, 0x79, 0x00, 0x64, 0x6d, 0x61, 0x2d, 0x63, 0x6f,
+    0x68, 0x65, 0x72, 0x65, 0x6e, 0x74, 0x00,
+};
+
+
+// board of version 1, and version 2 with a property changed, added and
+// removed, a node changed, added and removed
+static int patch_build_board(fdt_writer_t *writer, int version, const void **blob, uint32_t *size)
+{
+    fdt_writer_init(writer, NULL, 0, 0x260101, FDT_FLAG_NAME_HASH | FDT_FLAG_SUBTREE_SIZE);
+    fdt_writer_prop_string(writer, "model", version == 1 ? "board-v1" : "board-v2");
+    fdt_writer_begin_node(writer, "soc");
+    fdt_writer_prop_int(writer, "reg", 0x1000);
+    if(version == 1) {
+        fdt_writer_prop_string(writer, "status", "okay");
+    }
+    fdt_writer_prop_int(writer, "clk", 5);
+    if(version == 2) {
+        fdt_writer_prop_int(writer, "irq", 7);
+    }
+    fdt_writer_begin_node(writer, "uart@0");
+    fdt_writer_prop_int(writer, "reg", 0x10);
+    fdt_writer_begin_node(writer, "port");
+    fdt_writer_prop_int(writer, "id", 3);
+    fdt_writer_end_node(writer);
+    fdt_writer_end_node(writer);
+    if(version == 1) {
+        fdt_writer_begin_node(writer, "spi@0");
+        fdt_writer_prop_int(writer, "reg", 0x20);
+        fdt_writer_end_node(writer);
+    }
+    fdt_writer_begin_node(writer, "i2c@0");
+    fdt_writer_prop_int(writer, "reg", version == 1 ? 0x30 : 0x31);
+    fdt_writer_end_node(writer);
+    if(version == 2) {
+        fdt_writer_begin_node(writer, "gpio@0");
+        fdt_writer_begin_node(writer, "pin0");
+        fdt_writer_prop_int(writer, "id", 1);
+        fdt_writer_end_node(writer);
+        fdt_writer_end_node(writer);
+    }
+    fdt_writer_end_node(writer);
+    fdt_writer_begin_node(writer, "cpus");
+    fdt_writer_prop_int(writer, "freq", 100);
+    fdt_writer_end_node(writer);
+    return fdt_writer_finish(writer, blob, size);
+}
+
+
 int main(void)
 {
     int ret = -1;
@@ -42,12 +172,38 @@ int main(void)
     fdt_node_t *subnode1 = fdt_find_node_by_path("/node1/subnode1");
     ut_case(subnode1 && strcmp(subnode1->name, "subnode1") == 0, "fdt_find_node_by_path");
 
+    char long_path[1024];
+    memset(long_path, '/', sizeof(long_path));
+    memcpy(long_path + 600, "node1/ sub node1 /", 18);
+    long_path[sizeof(long_path) - 1] = 0;
+    ut_case(fdt_find_node_by_path(long_path) == subnode1, "fdt_find_node_by_path long path");
+
+    fdt_node_t *nested = fdt_find_node_by_name(NULL, "subnode1");
+    ut_case(nested && nested == subnode1, "fdt_find_node_by_name nested");
+
+    fdt_node_t *matches[4];
+    fdt_node_t *subnode2 = fdt_find_node_by_path("/node2/subnode2");
+    ret = fdt_query("/node?", matches, 4);
+    ut_case(ret == 2 && matches[0] == node1 && matches[1] == fdt_find_node_by_path("/node2") &&
+            fdt_query("/*/sub*1", matches, 4) == 1 && matches[0] == subnode1 &&
+            fdt_query("node1/subnode1", matches, 4) == 1 && matches[0] == subnode1 &&
+            fdt_query("/n*e/*", matches, 4) == 0, "fdt_query");
+
+    ret = fdt_query("/**", matches, 2);
+    ut_case(ret == 5 && matches[0] == node_root && matches[1] == node1 &&
+            fdt_query("/**/**/subnode?", matches, 4) == 2 && matches[1] == subnode2 &&
+            fdt_query("/** / *node2/**", matches, 4) == 2 && matches[0] == fdt_find_node_by_path("/node2") &&
+            fdt_query("/", NULL, 0) == 1, "fdt_query globstar");
+
     fdt_prop_t *string = fdt_find_prop_by_name(node1, "string");
     ut_case(string && strcmp(string->name, "string") == 0, "fdt_find_prop_by_name");
 
     string = fdt_find_prop_by_path("/node1/subnode1/string");
     ut_case(string && strcmp(string->name, "string") == 0, "fdt_find_prop_by_path");
 
+    memcpy(long_path + sizeof(long_path) - 7, "string", 7);
+    ut_case(fdt_find_prop_by_path(long_path) == fdt_find_prop_by_name(subnode1, "string"), "fdt_find_prop_by_path long path");
+
 
     /* read property */
     const char *string_val = fdt_read_prop_string(node1, "string");
@@ -61,6 +217,31 @@ int main(void)
     ret = fdt_read_prop_int_index(node1, "array", 1, &int_val_index);
     ut_case(ret == 0 && int_val_index == 0x787de, "fdt_read_prop_int_index");
 
+    // a 64-bit cell fails instead of being truncated when size_t is narrower
+    int wide_ok = SIZE_MAX >= UINT64_MAX;
+    ret = fdt_read_prop_int_index(node1, "array16", 3, &int_val_index);
+    ut_case(ret == 0 && int_val_index == 0x4020 &&
+            fdt_read_prop_int_index(node1, "array64", 1, &int_val_index) == (wide_ok ? 0 : -1) &&
+            (!wide_ok || int_val_index == (size_t)0x20de40de6045de10ull) &&
+            fdt_read_prop_int(node1, "int64", &int_val) == (wide_ok ? 0 : -1) &&
+            fdt_read_prop_int_index(node1, "array16", 4, &int_val_index) == -1,
+            "fdt_read_prop_int_index cell width");
+
+    uint32_t u32_val = 0;
+    ret = fdt_read_prop_u32(node1, "int32", &u32_val);
+    ut_case(ret == 0 && u32_val == 0x1050de10 && fdt_read_prop_u32(node1, "int64", &u32_val) == -1 &&
+            fdt_read_prop_u32(node1, "string", &u32_val) == -1, "fdt_read_prop_u32");
+
+    uint64_t u64_val = 0;
+    ret = fdt_read_prop_u64(node1, "int64", &u64_val);
+    ut_case(ret == 0 && u64_val == 0x1050de40de20de0ull && fdt_read_prop_u64(node1, "array64", &u64_val) == 0 &&
+            u64_val == 0x1050de4020de4020ull, "fdt_read_prop_u64");
+
+    int32_t s32_val = 0;
+    ret = fdt_read_prop_s32(node1, "int16", &s32_val);
+    ut_case(ret == 0 && s32_val == (int16_t)0xf550 && fdt_read_prop_s32(node1, "int8", &s32_val) == 0 && s32_val == 50 &&
+            fdt_read_prop_s32(node1, "int64", &s32_val) == -1, "fdt_read_prop_s32");
+
 
     /* read property by path */
     const char *string_val_path = fdt_read_prop_string_by_path("/node1", "string");
@@ -104,6 +285,705 @@ int main(void)
     type_by_path = fdt_get_prop_type_by_path("/node1", "array");
     ut_case(type_by_path == FDT_PROP_ARRAY, "fdt_get_prop_type_by_path array");
 
+    const void *cells = NULL;
+    uint8_t cell_size = 0;
+    uint32_t cell_count = 0;
+    const void *payload = NULL;
+    uint32_t payload_len = 0;
+    fdt_prop_t *array16 = fdt_find_prop_by_name(node1, "array16");
+    ret = fdt_get_prop_cells(array16, &cells, &cell_size, &cell_count);
+    ret |= fdt_get_prop_payload(array16, &payload, &payload_len);
+    ut_case(ret == 0 && fdt_get_prop_value_type(array16) == FDT_PROP_ARRAY && cell_size == 2 && cell_count == 4 &&
+            payload == cells && payload_len == 8 && ((const uint8_t*)cells)[2] == 0xde && ((const uint8_t*)cells)[3] == 0x20 &&
+            fdt_get_prop_value_type(fdt_find_prop_by_name(node1, "int16")) == FDT_PROP_INT &&
+            fdt_get_prop_cells(fdt_find_prop_by_name(node1, "string"), &cells, &cell_size, &cell_count) == -1 &&
+            fdt_get_prop_payload(fdt_find_prop_by_name(node1, "int"), &payload, &payload_len) == -1, "fdt_get_prop_cells");
+
+
+    /* bytes and long array property */
+    static uint8_t lut[70000];
+    uint64_t table[300];
+    for(size_t i = 0; i < sizeof(lut); i++) {
+        lut[i] = (uint8_t)(i * 7);
+    }
+    for(int i = 0; i < 300; i++) {
+        table[i] = i * 1000;
+    }
+
+    fdt_writer_t writer;
+    const void *blob = NULL;
+    uint32_t blob_size = 0;
+    fdt_writer_init(&writer, NULL, 0, 0x260101, 0);
+    fdt_writer_begin_node(&writer, "fw");
+    fdt_writer_prop_bytes(&writer, "lut", lut, sizeof(lut));
+    fdt_writer_prop_array(&writer, "table", table, 300);
+    fdt_writer_end_node(&writer);
+    ret = fdt_writer_finish(&writer, &blob, &blob_size);
+    ut_case(ret == 0 && fdt_load(blob, blob_size) == 0, "fdt_writer_finish");
+
+    fdt_node_t *fw = fdt_find_node_by_path("/fw");
+    type = fdt_get_prop_type(fw, "lut");
+    ut_case(type == FDT_PROP_BYTES, "fdt_get_prop_type bytes");
+
+    const void *bytes = NULL;
+    uint32_t bytes_len = 0;
+    ret = fdt_read_prop_bytes(fw, "lut", &bytes, &bytes_len);
+    ut_case(ret == 0 && bytes_len == sizeof(lut) && memcmp(bytes, lut, sizeof(lut)) == 0, "fdt_read_prop_bytes");
+
+    ret = fdt_read_prop_bytes_by_path("/fw", "lut", &bytes, &bytes_len);
+    ut_case(ret == 0 && bytes_len == sizeof(lut), "fdt_read_prop_bytes_by_path");
+
+    fdt_prop_stream_t stream;
+    uint32_t window = 0, total = 0;
+    const void *chunk = NULL;
+    ret = fdt_prop_stream_open(fw, "lut", &stream);
+    while((window = fdt_prop_stream_next(&stream, 4096, &chunk)) > 0) {
+        if(memcmp(chunk, lut + total, window)) {
+            break;
+        }
+        total += window;
+    }
+    ut_case(ret == 0 && total == sizeof(lut), "fdt_prop_stream_next");
+
+    ret = fdt_prop_stream_seek(&stream, 69990);
+    window = fdt_prop_stream_next(&stream, 4096, &chunk);
+    ut_case(ret == 0 && window == 10 && memcmp(chunk, lut + 69990, 10) == 0, "fdt_prop_stream_seek");
+
+    ret = fdt_read_prop_int_index(fw, "table", 299, &int_val_index);
+    ut_case(ret == 0 && int_val_index == 299000, "fdt_read_prop_int_index long array");
+
+    int_size = fdt_get_prop_int_size(fw, "table");
+    ut_case(int_size == 300 && fdt_get_prop_type(fw, "table") == FDT_PROP_ARRAY, "fdt_get_prop_int_size long array");
+    fdt_writer_release(&writer);
+
+
+    /* names with length and hash */
+    fdt_writer_init(&writer, NULL, 0, 0x260101, FDT_FLAG_NAME_HASH);
+    fdt_writer_begin_node(&writer, "uart");
+    fdt_writer_prop_string(&writer, "compatible", "ns16550");
+    fdt_writer_begin_node(&writer, "serial0");
+    fdt_writer_prop_int(&writer, "reg", 0x10000000);
+    fdt_writer_end_node(&writer);
+    fdt_writer_end_node(&writer);
+    ret = fdt_writer_finish(&writer, &blob, &blob_size);
+    ut_case(ret == 0 && fdt_load(blob, blob_size) == 0 && fdt_get_version() == 0x260101, "fdt_load name hash");
+
+    fdt_node_t *serial0 = fdt_find_node_by_path("/uart/serial0");
+    ut_case(serial0 && serial0->name_len == 7 && serial0->hash == fdt_hash_name("serial0", 7), "fdt_hash_name");
+
+    ret = fdt_read_prop_int_by_path("/uart/serial0", "reg", &int_val);
+    ut_case(ret == 0 && int_val == 0x10000000 && fdt_find_node_by_name(NULL, "serial0") == serial0, "fdt_read_prop_int name hash");
+    fdt_writer_release(&writer);
+
+
+    /* sorted index of wide node */
+    char name[32];
+    fdt_writer_init(&writer, NULL, 0, 0x260101, 0);
+    fdt_writer_begin_node(&writer, "gpio");
+    for(int i = 0; i < 40; i++) {
+        snprintf(name, sizeof(name), "p%d", i);
+        fdt_writer_prop_int(&writer, name, i);
+    }
+    fdt_writer_prop_int(&writer, "p3", 999);
+    for(int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "pin%d", (i * 37) % 200);
+        fdt_writer_begin_node(&writer, name);
+        fdt_writer_prop_int(&writer, "id", (i * 37) % 200);
+        fdt_writer_end_node(&writer);
+    }
+    fdt_writer_begin_node(&writer, "pin5");
+    fdt_writer_prop_int(&writer, "id", 999);
+    fdt_writer_end_node(&writer);
+    fdt_writer_end_node(&writer);
+    fdt_writer_finish(&writer, &blob, &blob_size);
+    ret = fdt_load(blob, blob_size);
+
+    int found = 0;
+    for(int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "/gpio/pin%d", i);
+        if(fdt_read_prop_int_by_path(name, "id", &int_val) == 0 && int_val == (size_t)i) {
+            found ++;
+        }
+    }
+    ut_case(ret == 0 && found == 200 && fdt_find_node_by_path("/gpio/pin200") == NULL, "fdt_find_node_by_path sorted index");
+
+    fdt_node_t *gpio = fdt_find_node_by_path("/gpio");
+    found = 0;
+    for(int i = 0; i < 40; i++) {
+        snprintf(name, sizeof(name), "p%d", i);
+        if(fdt_read_prop_int(gpio, name, &int_val) == 0 && int_val == (size_t)i) {
+            found ++;
+        }
+    }
+    ut_case(found == 40 && fdt_find_prop_by_name(gpio, "p40") == NULL, "fdt_find_prop_by_name sorted index");
+
+    fdt_node_t *pin = NULL;
+    found = 0;
+    fdt_for_each_node_child(gpio, pin) {
+        snprintf(name, sizeof(name), "pin%d", (found * 37) % 200);
+        if(found < 200 && strcmp(pin->name, name) == 0) {
+            found ++;
+        }
+    }
+    ut_case(found == 200, "fdt_for_each_node_child document order");
+
+
+    /* perfect hash of paths */
+    fdt_phash_t phash;
+    fdt_load_opts_t opts = {.phash = &phash};
+    ret = fdt_writer_build_phash(fdt_get_root_node(), &phash);
+    ut_case(ret == 0 && phash.node.count == 201 && phash.node.total == 203 && phash.prop.count == 240, "fdt_writer_build_phash");
+
+    ret = fdt_load_ex(blob, blob_size, &opts);
+    found = 0;
+    for(int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "/gpio/pin%d", i);
+        pin = fdt_find_node_by_path(name);
+        if(pin && fdt_read_prop_int(pin, "id", &int_val) == 0 && int_val == (size_t)i) {
+            found ++;
+        }
+    }
+    ut_case(ret == 0 && found == 200 && fdt_find_node_by_path("/ gpio / pin7 ") == fdt_find_node_by_path("/gpio/pin7"), "fdt_load_ex node phash");
+
+    found = 0;
+    for(int i = 0; i < 40; i++) {
+        snprintf(name, sizeof(name), "/gpio/p%d", i);
+        fdt_prop_t *prop = fdt_find_prop_by_path(name);
+        if(prop && prop == fdt_find_prop_by_name(fdt_find_node_by_path("/gpio"), name + 6)) {
+            found ++;
+        }
+    }
+    ut_case(found == 40 && fdt_find_prop_by_path("/gpio/pin3/id") && fdt_find_prop_by_path("/gpio/p40") == NULL, "fdt_load_ex prop phash");
+
+    ut_case(fdt_find_node_by_path("/gpio/pin200") == NULL && fdt_find_node_by_path("/pin7") == NULL &&
+            fdt_find_prop_by_path("/gpio/id") == NULL && fdt_find_node_by_path("/") == fdt_get_root_node(), "fdt_load_ex phash miss");
+
+    ret = fdt_load_ex(fdt_dts_blob, fdt_dts_size, &opts);
+    ut_case(ret == 0 && fdt_find_node_by_path("/node1/subnode1") && fdt_find_prop_by_path("/node2/int"), "fdt_load_ex phash mismatch");
+    fdt_writer_free_phash(&phash);
+    fdt_writer_release(&writer);
+
+
+    /* walk blob without tree */
+    fdt_walk_ops_t walk_ops = {walk_begin_node, walk_prop, walk_end_node};
+    walk_count_t walk_count = {0};
+    ret = fdt_walk(fdt_dts_blob, fdt_dts_size, &walk_ops, &walk_count);
+    ut_case(ret == 0 && walk_count.nodes == 5 && walk_count.ends == 5 && walk_count.props == 27 &&
+            walk_count.ints == 95 + 100 + 95 + 100, "fdt_walk");
+
+    memset(&walk_count, 0, sizeof(walk_count));
+    walk_count.skip = "node1";
+    ret = fdt_walk(fdt_dts_blob, fdt_dts_size, &walk_ops, &walk_count);
+    ut_case(ret == 0 && walk_count.nodes == 4 && walk_count.ends == 4 && walk_count.props == 13, "fdt_walk skip");
+
+    memset(&walk_count, 0, sizeof(walk_count));
+    walk_count.stop = "subnode1";
+    ret = fdt_walk(fdt_dts_blob, fdt_dts_size, &walk_ops, &walk_count);
+    ut_case(ret == FDT_WALK_STOP && walk_count.nodes == 3 && walk_count.props == 11, "fdt_walk stop");
+    ut_case(fdt_walk(fdt_dts_blob, 3, &walk_ops, &walk_count) == -1, "fdt_walk invalid blob");
+
+    /* name and value fields must not cross the end of blob */
+    uint8_t cut_blob[32];
+    fdt_writer_init(&writer, NULL, 0, 0x260101, FDT_FLAG_NAME_HASH);
+    fdt_writer_prop_bytes(&writer, "lut", "\x01\x02", 2);
+    ret = fdt_writer_finish(&writer, &blob, &blob_size);
+    memcpy(cut_blob, blob, blob_size < sizeof(cut_blob) ? blob_size : sizeof(cut_blob));
+    ut_case(ret == 0 && blob_size == 28 && fdt_walk(cut_blob, 28, &walk_ops, &walk_count) == 0 &&
+            fdt_walk(cut_blob, 24, &walk_ops, &walk_count) == -1 && fdt_walk(cut_blob, 20, &walk_ops, &walk_count) == -1 &&
+            (cut_blob[14] = 0xff, fdt_walk(cut_blob, 28, &walk_ops, &walk_count)) == -1, "fdt_walk truncated field");
+    fdt_writer_release(&writer);
+
+    fdt_walk_prop_t walk_prop;
+    ret = fdt_blob_find_prop(fdt_dts_blob, fdt_dts_size, "/node2/subnode2", "int", &walk_prop);
+    ut_case(ret == 0 && walk_prop.type == FDT_PROP_INT && walk_prop.integer == 100 &&
+            fdt_blob_find_prop(fdt_dts_blob, fdt_dts_size, "/node2/subnode1", "int", &walk_prop) == -1, "fdt_blob_find_prop");
+
+
+    /* subtree size */
+    fdt_writer_init(&writer, NULL, 0, 0x260101, FDT_FLAG_NAME_HASH | FDT_FLAG_SUBTREE_SIZE);
+    fdt_writer_prop_string(&writer, "model", "board");
+    for(int i = 0; i < 8; i++) {
+        snprintf(name, sizeof(name), "bus%d", i);
+        fdt_writer_begin_node(&writer, name);
+        fdt_writer_prop_int(&writer, "id", i);
+        for(int j = 0; j < 8; j++) {
+            snprintf(name, sizeof(name), "dev%d", j);
+            fdt_writer_begin_node(&writer, name);
+            fdt_writer_prop_int(&writer, "reg", i * 8 + j);
+            fdt_writer_end_node(&writer);
+        }
+        fdt_writer_end_node(&writer);
+    }
+    ret = fdt_writer_finish(&writer, &blob, &blob_size);
+    ut_case(ret == 0 && fdt_load(blob, blob_size) == 0 && fdt_read_prop_int_by_path("/bus7/dev7", "reg", &int_val) == 0 &&
+            int_val == 63, "fdt_load subtree size");
+
+    memset(&walk_count, 0, sizeof(walk_count));
+    walk_count.skip = "bus3";
+    ret = fdt_walk(blob, blob_size, &walk_ops, &walk_count);
+    ut_case(ret == 0 && walk_count.nodes == 1 + 8 + 7 * 8 && walk_count.ends == walk_count.nodes &&
+            walk_count.props == 1 + 8 + 7 * 8 - 1, "fdt_walk skip subtree size");
+
+    ret = fdt_blob_find_prop(blob, blob_size, "/bus6/dev5", "reg", &walk_prop);
+    ut_case(ret == 0 && walk_prop.integer == 53 && fdt_blob_find_prop(blob, blob_size, "/", "model", &walk_prop) == 0 &&
+            strcmp(walk_prop.string, "board") == 0, "fdt_blob_find_prop subtree size");
+
+
+    /* lazy load */
+    uint64_t eager_bytes = fdt_debug_get_consume_bytes();
+    fdt_load_opts_t lazy_opts = {.flags = FDT_LOAD_LAZY};
+    ret = fdt_load_ex(blob, blob_size, &lazy_opts);
+    uint64_t lazy_bytes = fdt_debug_get_consume_bytes();
+    fdt_node_t *bus = fdt_find_node_by_path("/bus5");
+    ut_case(ret == 0 && bus && bus->lazy && lazy_bytes < eager_bytes / 8, "fdt_load_ex lazy");
+
+    ret = fdt_read_prop_int_by_path("/bus5/dev6", "reg", &int_val);
+    ut_case(ret == 0 && int_val == 46 && bus->lazy == NULL && fdt_find_node_by_path("/bus4")->lazy, "fdt_read_prop_int_by_path lazy");
+
+    found = 0;
+    fdt_node_t *dev = NULL;
+    fdt_node_t *bus2 = fdt_find_node_by_path("/bus2");
+    ret = fdt_node_expand(bus2);
+    fdt_for_each_node_child(bus2, dev) {
+        if(fdt_read_prop_int(dev, "reg", &int_val) == 0 && int_val == (size_t)(16 + found)) {
+            found ++;
+        }
+    }
+    ut_case(ret == 0 && found == 8 && fdt_find_node_by_name(NULL, "dev7") == fdt_find_node_by_path("/bus0/dev7"), "fdt_node_expand");
+
+
+    /* parallel load */
+    ret = fdt_load_parallel(blob, blob_size, 3);
+    found = 0;
+    fdt_for_each_node_child(fdt_get_root_node(), bus) {
+        fdt_for_each_node_child(bus, dev) {
+            if(fdt_read_prop_int(dev, "reg", &int_val) == 0 && int_val == (size_t)found && dev->parent == bus) {
+                found ++;
+            }
+        }
+    }
+    ut_case(ret == 0 && found == 64 && fdt_find_node_by_path("/bus7")->parent == fdt_get_root_node() &&
+            fdt_find_prop_by_path("/model"), "fdt_load_parallel");
+
+    ret = fdt_load_parallel(blob, blob_size, 16);
+    ut_case(ret == 0 && fdt_read_prop_int_by_path("/bus7/dev7", "reg", &int_val) == 0 && int_val == 63 &&
+            fdt_load_parallel(blob, blob_size, 0) == 0 && fdt_find_node_by_path("/bus0/dev0"), "fdt_load_parallel threads");
+    fdt_writer_release(&writer);
+
+    ret = fdt_load_parallel(fdt_dts_blob, fdt_dts_size, 2);
+    ut_case(ret == 0 && fdt_read_prop_int_by_path("/node1/subnode1", "int", &int_val) == 0 && int_val == 100 &&
+            fdt_find_prop_by_path("/node2/subnode2/array8") && fdt_load_parallel(fdt_dts_blob, 3, 2) == -1 &&
+            fdt_find_node_by_path("/node2"), "fdt_load_parallel plain blob");
+
+    ret = fdt_load_ex(fdt_dts_blob, fdt_dts_size, &lazy_opts);
+    ut_case(ret == 0 && fdt_read_prop_int_by_path("/node1/subnode1", "int", &int_val) == 0 && int_val == 100 &&
+            fdt_find_prop_by_path("/node2/subnode2/array8") && fdt_find_node_by_name(NULL, "subnode3") == NULL, "fdt_load_ex lazy plain blob");
+
+
+    /* cells wider than 8 bytes fail instead of returning their low 8 bytes */
+    static const uint8_t wide_blob[] = {
+        'f', 'd', 't', 0x01, 0x01, 0x26, 0x00, '/', 0,
+        0xff, 'w', 'i', 'd', 'e', 0, 9, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+        0xff, 'w', 'a', 'r', 'r', 0, FDT_PROP_ARRAY + 9, 2, 1, 2, 3, 4, 5, 6, 7, 8, 9, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+    };
+    ret = fdt_load(wide_blob, sizeof(wide_blob));
+    ut_case(ret == 0 && fdt_get_prop_type_by_path("/", "wide") == FDT_PROP_INT &&
+            fdt_read_prop_int(fdt_get_root_node(), "wide", &int_val) == -1 &&
+            fdt_read_prop_int_index(fdt_get_root_node(), "warr", 1, &int_val_index) == -1 &&
+            fdt_read_prop_int_index(fdt_get_root_node(), "warr", 2, &int_val_index) == -1, "fdt_read_prop_int wide cell");
+
+
+    /* reference */
+    static const char *const clock_paths[] = {"/clk/apb", "/ clk / ahb"};
+    static const char *const bad_paths[] = {"/clk/nope"};
+    fdt_writer_init(&writer, NULL, 0, 0x260101, 0);
+    fdt_writer_begin_node(&writer, "uart");
+    fdt_writer_prop_ref(&writer, "clocks", clock_paths, 2);
+    fdt_writer_prop_int(&writer, "reg", 7);
+    fdt_writer_end_node(&writer);
+    fdt_writer_begin_node(&writer, "clk");
+    fdt_writer_begin_node(&writer, "apb");
+    fdt_writer_end_node(&writer);
+    fdt_writer_begin_node(&writer, "ahb");
+    fdt_writer_end_node(&writer);
+    fdt_writer_end_node(&writer);
+    ret = fdt_writer_finish(&writer, &blob, &blob_size);
+    ut_case(ret == 0 && fdt_load(blob, blob_size) == 0 && fdt_get_prop_type_by_path("/uart", "clocks") == FDT_PROP_REF &&
+            fdt_read_prop_node(fdt_find_node_by_path("/uart"), "clocks", 1) == fdt_find_node_by_path("/clk/ahb") &&
+            fdt_read_prop_node(fdt_find_node_by_path("/uart"), "clocks", 2) == NULL &&
+            fdt_read_prop_node(fdt_find_node_by_path("/uart"), "reg", 0) == NULL, "fdt_read_prop_node");
+
+    ret = fdt_load_ex(blob, blob_size, &lazy_opts);
+    ut_case(ret == 0 && fdt_read_prop_node(fdt_find_node_by_path("/uart"), "clocks", 0) == fdt_find_node_by_path("/clk/apb") &&
+            fdt_load_parallel(blob, blob_size, 2) == 0 &&
+            fdt_read_prop_node(fdt_find_node_by_path("/uart"), "clocks", 0) == fdt_find_node_by_path("/clk/apb"),
+            "fdt_read_prop_node lazy and parallel");
+
+    // a lazy reference is resolved in its own tree, even after another tree is published
+    ret = fdt_load_ex(blob, blob_size, &lazy_opts);
+    int ref_epoch = fdt_read_begin();
+    fdt_node_t *lazy_uart = fdt_find_node_by_path("/uart");
+    ret |= fdt_load_async(fdt_dts_blob, fdt_dts_size);
+    fdt_node_t *lazy_apb = fdt_wait_node("/node1", 1000) ? fdt_read_prop_node(lazy_uart, "clocks", 0) : NULL;
+    ret |= (lazy_apb && strcmp(lazy_apb->name, "apb") == 0 && lazy_apb->parent->parent == lazy_uart->parent) ? 0 : 1;
+    fdt_read_end(ref_epoch);
+    ret |= fdt_load_async_join();
+    ut_case(ret == 0 && fdt_load(blob, blob_size) == 0, "fdt_read_prop_node owning tree");
+
+    ret = fdt_blob_find_prop(blob, blob_size, "/uart", "clocks", &walk_prop);
+    ut_case(ret == 0 && walk_prop.type == FDT_PROP_REF && walk_prop.count == 2 && strcmp(walk_prop.string, "/clk/apb") == 0 &&
+            fdt_blob_find_prop(blob, blob_size, "/uart", "reg", &walk_prop) == 0 && walk_prop.integer == 7, "fdt_blob_find_prop ref");
+
+    // the loaded tree keeps pointing into the first blob
+    fdt_writer_t bad_writer;
+    fdt_writer_init(&bad_writer, NULL, 0, 0x260101, 0);
+    fdt_writer_begin_node(&bad_writer, "uart");
+    fdt_writer_prop_ref(&bad_writer, "clocks", bad_paths, 1);
+    ret = fdt_writer_finish(&bad_writer, &blob, &blob_size);
+    ut_case(ret == 0 && fdt_load(blob, blob_size) == -1 && fdt_find_node_by_path("/clk/apb"), "fdt_load unresolved reference");
+    fdt_writer_release(&bad_writer);
+    fdt_load(fdt_dts_blob, fdt_dts_size);
+    fdt_writer_release(&writer);
+
+    /* aliases */
+    fdt_writer_init(&writer, NULL, 0, 0x260101, FDT_FLAG_NAME_HASH);
+    fdt_writer_begin_node(&writer, "aliases");
+    fdt_writer_prop_string(&writer, "serial0", "/soc/uart@0");
+    fdt_writer_prop_string(&writer, "serial1", "/soc/none");
+    fdt_writer_prop_int(&writer, "count", 2);
+    fdt_writer_end_node(&writer);
+    fdt_writer_begin_node(&writer, "soc");
+    fdt_writer_begin_node(&writer, "uart@0");
+    fdt_writer_prop_int(&writer, "reg", 0x1000);
+    fdt_writer_begin_node(&writer, "port");
+    fdt_writer_prop_int(&writer, "id", 3);
+    fdt_writer_end_node(&writer);
+    fdt_writer_end_node(&writer);
+    fdt_writer_end_node(&writer);
+    ret = fdt_writer_finish(&writer, &blob, &blob_size);
+    ret |= fdt_load(blob, blob_size);
+    fdt_node_t *uart = fdt_find_node_by_path("/soc/uart@0");
+    ut_case(ret == 0 && uart && fdt_find_node_by_alias("serial0") == uart && fdt_find_node_by_alias("serial1") == NULL &&
+            fdt_find_node_by_alias("count") == NULL && fdt_find_node_by_alias("serial") == NULL,
+            "fdt_find_node_by_alias");
+
+    ret = fdt_read_prop_int_by_path("serial0", "reg", &int_val);
+    ut_case(ret == 0 && int_val == 0x1000 && fdt_find_node_by_path(" serial0 /port") == fdt_find_node_by_path("/soc/uart@0/port") &&
+            fdt_find_prop_by_path("serial0/port/id") == fdt_find_prop_by_path("/soc/uart@0/port/id") &&
+            fdt_find_node_by_path("soc/uart@0") == uart && fdt_find_node_by_path("serial1/port") == NULL,
+            "fdt_find_node_by_path alias");
+
+    ret = fdt_load_ex(blob, blob_size, &lazy_opts);
+    ut_case(ret == 0 && fdt_find_node_by_path("serial0/port") == fdt_find_node_by_path("/soc/uart@0/port") &&
+            fdt_load_parallel(blob, blob_size, 2) == 0 && fdt_find_node_by_alias("serial0") == fdt_find_node_by_path("/soc/uart@0"),
+            "fdt_find_node_by_alias lazy");
+    fdt_load(fdt_dts_blob, fdt_dts_size);
+    fdt_writer_release(&writer);
+
+    /* standard dtb */
+    fdt_writer_init(&writer, NULL, 0, 0x260101, FDT_FLAG_NAME_HASH);
+    ret = fdt_writer_import_dtb(&writer, dtb_uart, sizeof(dtb_uart));
+    ret |= fdt_writer_finish(&writer, &blob, &blob_size);
+    ret |= fdt_load(blob, blob_size);
+    ret |= fdt_read_prop_int_index_by_path("/uart@1000", "reg", 1, &int_val_index);
+    ret |= fdt_read_prop_bytes_by_path("/uart@1000", "compatible", &bytes, &bytes_len);
+    ut_case(ret == 0 && strcmp(fdt_read_prop_string(fdt_get_root_node(), "compatible"), "t,board") == 0 &&
+            int_val_index == 0x100 && bytes_len == 14 && memcmp(bytes, "a,uart\0b,uart", 14) == 0 &&
+            fdt_read_prop_int_by_path("/uart@1000", "clock-frequency", &int_val) == 0 && int_val == 115200 &&
+            fdt_read_prop_bytes_by_path("/uart@1000", "dma-coherent", &bytes, &bytes_len) == 0 && bytes_len == 0,
+            "fdt_writer_import_dtb");
+    fdt_load(fdt_dts_blob, fdt_dts_size);
+    fdt_writer_release(&writer);
+
+    fdt_writer_init(&writer, NULL, 0, 0x260101, 0);
+    ret = fdt_writer_import_dtb(&writer, dtb_uart, sizeof(dtb_uart) - 8);
+    fdt_writer_release(&writer);
+    fdt_writer_init(&writer, NULL, 0, 0x260101, 0);
+    ret |= fdt_writer_import_dtb(&writer, fdt_dts_blob, fdt_dts_size) == -1 ? 0 : 1;
+    fdt_writer_release(&writer);
+    ut_case(ret == -1, "fdt_writer_import_dtb invalid");
+
+
+    /* patch */
+    fdt_writer_t board1, board2;
+    const void *blob1 = NULL, *blob2 = NULL;
+    uint32_t blob1_size = 0, blob2_size = 0, patch_size = 0, new_size = 0;
+    void *patch = NULL;
+    static uint8_t patch_buf[512];
+    ret = patch_build_board(&board1, 1, &blob1, &blob1_size);
+    ret |= patch_build_board(&board2, 2, &blob2, &blob2_size);
+    ret |= fdt_writer_build_patch(blob1, blob1_size, blob2, blob2_size, &patch, &patch_size);
+    ret |= fdt_load(blob1, blob1_size);
+    ret |= fdt_apply_patch(blob1, blob1_size, patch, patch_size, patch_buf, sizeof(patch_buf), &new_size);
+    ut_case(ret == 0 && patch_size < blob2_size / 2 && new_size == blob2_size && memcmp(patch_buf, blob2, new_size) == 0 &&
+            strcmp(fdt_read_prop_string(fdt_get_root_node(), "model"), "board-v2") == 0 &&
+            fdt_read_prop_int_by_path("/soc/gpio@0/pin0", "id", &int_val) == 0 && int_val == 1 &&
+            fdt_find_node_by_path("/soc/spi@0") == NULL && fdt_find_prop_by_path("/soc/status") == NULL &&
+            fdt_read_prop_int_by_path("/soc/i2c@0", "reg", &int_val) == 0 && int_val == 0x31, "fdt_apply_patch");
+
+    ret = fdt_apply_patch(blob2, blob2_size, patch, patch_size, patch_buf, sizeof(patch_buf), &new_size);
+    ret |= fdt_load(blob1, blob1_size) ? 0 : 1;
+    ret |= fdt_apply_patch(blob1, blob1_size, patch, patch_size - 1, patch_buf, sizeof(patch_buf), &new_size) == -1 ? 0 : 1;
+    ret |= fdt_apply_patch(blob1, blob1_size, patch, patch_size, patch_buf, blob2_size - 1, &new_size) == -1 ? 0 : 1;
+    ut_case(ret == -1 && fdt_find_node_by_path("/soc/spi@0"), "fdt_apply_patch invalid");
+    fdt_free(patch);
+
+    ret = fdt_writer_build_patch(blob2, blob2_size, blob1, blob1_size, &patch, &patch_size);
+    ret |= fdt_load(blob2, blob2_size);
+    ret |= fdt_apply_patch(blob2, blob2_size, patch, patch_size, patch_buf, sizeof(patch_buf), &new_size);
+    ut_case(ret == 0 && new_size == blob1_size && memcmp(patch_buf, blob1, new_size) == 0 &&
+            fdt_find_node_by_path("/soc/spi@0"), "fdt_apply_patch reverse");
+    fdt_free(patch);
+
+    ret = fdt_writer_build_patch(blob1, blob1_size, blob1, blob1_size, &patch, &patch_size);
+    ut_case(ret == 0 && patch_size == 24, "fdt_writer_build_patch same blob");
+    fdt_free(patch);
+    fdt_writer_release(&board1);
+    fdt_writer_release(&board2);
+    fdt_load(fdt_dts_blob, fdt_dts_size);
+
+
+    /* checksum */
+    ut_case(fdt_crc32(0, "123456789", 9) == 0xcbf43926 && fdt_crc32(fdt_crc32(0, "1234", 4), "56789", 5) == 0xcbf43926 &&
+            fdt_crc32(0, "", 0) == 0, "fdt_crc32");
+
+    fdt_writer_t crc_writer;
+    const void *crc_blob = NULL;
+    uint32_t crc_size = 0;
+    static uint8_t crc_buf[256];
+    fdt_writer_init(&crc_writer, crc_buf, sizeof(crc_buf), 0x260101, FDT_FLAG_CRC32 | FDT_FLAG_SUBTREE_SIZE);
+    fdt_writer_prop_string(&crc_writer, "model", "crc-board");
+    fdt_writer_begin_node(&crc_writer, "soc");
+    fdt_writer_prop_int(&crc_writer, "reg", 0x1000);
+    fdt_writer_end_node(&crc_writer);
+    ret = fdt_writer_finish(&crc_writer, &crc_blob, &crc_size);
+    ret |= fdt_load(crc_blob, crc_size);
+    ut_case(ret == 0 && fdt_read_prop_int_by_path("/soc", "reg", &int_val) == 0 && int_val == 0x1000 &&
+            crc_buf[7] == crc_size, "fdt_load checksum");
+    ut_case(fdt_load(crc_blob, crc_size + 1) == -1 && fdt_load(crc_blob, crc_size - 1) == -1 &&
+            fdt_find_node_by_path("/soc"), "fdt_load checksum size");
+
+    for(uint32_t i = 0; i + 9 <= crc_size; i++) {
+        if(memcmp(crc_buf + i, "crc-board", 9) == 0) {
+            crc_buf[i] = 'x';
+        }
+    }
+    fdt_load_opts_t crc_opts = {.flags = FDT_LOAD_SKIP_CRC};
+    ret = fdt_load(crc_blob, crc_size);
+    ut_case(ret == -1 && fdt_find_node_by_path("/soc"), "fdt_load checksum error");
+
+    ret = fdt_load_ex(crc_blob, crc_size, &crc_opts);
+    ut_case(ret == 0 && strcmp(fdt_read_prop_string(fdt_get_root_node(), "model"), "xrc-board") == 0,
+            "fdt_load_ex FDT_LOAD_SKIP_CRC");
+    fdt_load(fdt_dts_blob, fdt_dts_size);
+
+
+    /* layers */
+    fdt_writer_t soc_writer, board_writer, product_writer;
+    fdt_layer_t layers[3];
+    const char *clock_path[] = {"/soc/clk"};
+    fdt_writer_init(&soc_writer, NULL, 0, 0x260101, FDT_FLAG_SUBTREE_SIZE);
+    fdt_writer_prop_string(&soc_writer, "model", "soc");
+    fdt_writer_begin_node(&soc_writer, "soc");
+    fdt_writer_prop_ref(&soc_writer, "clocks", clock_path, 1);
+    fdt_writer_begin_node(&soc_writer, "uart@0");
+    fdt_writer_prop_int(&soc_writer, "reg", 0x10);
+    fdt_writer_prop_string(&soc_writer, "status", "disabled");
+    fdt_writer_end_node(&soc_writer);
+    fdt_writer_begin_node(&soc_writer, "clk");
+    fdt_writer_end_node(&soc_writer);
+    fdt_writer_end_node(&soc_writer);
+    ret = fdt_writer_finish(&soc_writer, &layers[0].dtb, &crc_size);
+    layers[0].dtb_size = crc_size;
+
+    const char *pll_path[] = {"/soc/pll"};
+    fdt_writer_init(&board_writer, NULL, 0, 0x260102, FDT_FLAG_NAME_HASH);
+    fdt_writer_prop_string(&board_writer, "model", "board");
+    fdt_writer_begin_node(&board_writer, "soc");
+    fdt_writer_prop_ref(&board_writer, "clocks", pll_path, 1);
+    fdt_writer_begin_node(&board_writer, "uart@0");
+    fdt_writer_prop_string(&board_writer, "status", "okay");
+    fdt_writer_prop_int(&board_writer, "baud", 115200);
+    fdt_writer_end_node(&board_writer);
+    fdt_writer_end_node(&board_writer);
+    ret |= fdt_writer_finish(&board_writer, &layers[1].dtb, &crc_size);
+    layers[1].dtb_size = crc_size;
+
+    fdt_writer_init(&product_writer, NULL, 0, 0x260103, FDT_FLAG_CRC32);
+    fdt_writer_begin_node(&product_writer, "soc");
+    fdt_writer_begin_node(&product_writer, "pll");
+    fdt_writer_end_node(&product_writer);
+    fdt_writer_begin_node(&product_writer, "uart@0");
+    fdt_writer_prop_int(&product_writer, "baud", 9600);
+    fdt_writer_end_node(&product_writer);
+    fdt_writer_end_node(&product_writer);
+    ret |= fdt_writer_finish(&product_writer, &layers[2].dtb, &crc_size);
+    layers[2].dtb_size = crc_size;
+
+    ret |= fdt_load_layers(layers, 3, NULL);
+    fdt_node_t *layer_uart = fdt_find_node_by_path("/soc/uart@0");
+    fdt_prop_t *status = fdt_find_prop_by_path("/soc/uart@0/status");
+    fdt_prop_t *first = layer_uart ? fdt_container_of(layer_uart->prop.next, fdt_prop_t, node) : NULL;
+    ut_case(ret == 0 && fdt_get_version() == 0x260103 && strcmp(fdt_read_prop_string(fdt_get_root_node(), "model"), "board") == 0 &&
+            fdt_read_prop_int_by_path("/soc/uart@0", "reg", &int_val) == 0 && int_val == 0x10 &&
+            fdt_read_prop_int_by_path("/soc/uart@0", "baud", &int_val) == 0 && int_val == 9600 &&
+            status && strcmp(fdt_read_prop_string(layer_uart, "status"), "okay") == 0 && first && strcmp(first->name, "reg") == 0 &&
+            (const uint8_t*)status->offset > (const uint8_t*)layers[1].dtb &&
+            (const uint8_t*)status->offset < (const uint8_t*)layers[1].dtb + layers[1].dtb_size &&
+            fdt_read_prop_node(fdt_find_node_by_path("/soc"), "clocks", 0) == fdt_find_node_by_path("/soc/pll"), "fdt_load_layers");
+
+    fdt_load_opts_t layer_opts = {.flags = FDT_LOAD_LAZY};
+    ret = fdt_load_layers(layers, 0, NULL) == -1 ? 0 : 1;
+    ret |= fdt_load_layers(layers, 2, &layer_opts) == -1 ? 0 : 1;
+    layers[2].dtb_size --;
+    ret |= fdt_load_layers(layers, 3, NULL) == -1 ? 0 : 1;
+    layers[2].dtb_size ++;
+    ut_case(ret == 0 && fdt_find_node_by_path("/soc/pll") && fdt_load_layers(layers, 1, &layer_opts) == 0 &&
+            fdt_find_node_by_path("/soc/pll") == NULL, "fdt_load_layers invalid");
+    fdt_load(fdt_dts_blob, fdt_dts_size);
+    fdt_writer_release(&soc_writer);
+    fdt_writer_release(&board_writer);
+    fdt_writer_release(&product_writer);
+
+
+    /* compact tree */
+    uint32_t compact_size = 0;
+    uint16_t compact_buf[512];
+    uint16_t compact_copy[512];
+    const fdt_compact_t *ct = (const fdt_compact_t*)compact_copy;
+    ret = fdt_compact_build(fdt_dts_blob, fdt_dts_size, NULL, 0, &compact_size);
+    ut_case(ret == 0 && compact_size == sizeof(fdt_compact_t) + 5 * sizeof(fdt_compact_node_t) + 27 * sizeof(fdt_compact_prop_t) &&
+            fdt_compact_build(fdt_dts_blob, fdt_dts_size, compact_buf, compact_size - 1, &compact_size) == -1, "fdt_compact_build");
+
+    ret = fdt_compact_build(fdt_dts_blob, fdt_dts_size, compact_buf, sizeof(compact_buf), &compact_size);
+    memcpy(compact_copy, compact_buf, compact_size);
+    memset(compact_buf, 0, sizeof(compact_buf));
+    int subnode = fdt_compact_find_node(ct, fdt_dts_blob, "/node1/ subnode1");
+    ut_case(ret == 0 && fdt_compact_check(ct, fdt_dts_blob, fdt_dts_size) == 0 && subnode > 0 &&
+            strcmp(fdt_compact_node_name(ct, fdt_dts_blob, subnode), "subnode1") == 0 &&
+            fdt_compact_find_node(ct, fdt_dts_blob, "/") == 0 && fdt_compact_find_node(ct, fdt_dts_blob, "/node1/subnode2") == -1,
+            "fdt_compact_find_node");
+
+    ret = fdt_compact_find_prop(ct, fdt_dts_blob, subnode, "int", &walk_prop);
+    ut_case(ret == 0 && walk_prop.integer == 100 &&
+            fdt_compact_find_prop(ct, fdt_dts_blob, fdt_compact_find_node(ct, fdt_dts_blob, "/node2"), "array16", &walk_prop) == 0 &&
+            walk_prop.type == FDT_PROP_ARRAY && walk_prop.count == 4 && walk_prop.cell_size == 2 &&
+            fdt_compact_find_prop(ct, fdt_dts_blob, subnode, "int8", &walk_prop) == -1, "fdt_compact_find_prop");
+
+    found = 0;
+    uint32_t compact_child = 0;
+    fdt_compact_for_each_child(ct, 0, compact_child) {
+        found += fdt_compact_nodes(ct)[compact_child].parent == 0;
+    }
+    ut_case(found == 2 && fdt_compact_check(ct, fdt_dts_blob, fdt_dts_size - 1) == -1, "fdt_compact_for_each_child");
+
+    uint8_t *changed_blob = malloc(fdt_dts_size);
+    memcpy(changed_blob, fdt_dts_blob, fdt_dts_size);
+    changed_blob[fdt_dts_size - 1] ^= 0x5a;
+    ut_case(fdt_compact_check(ct, changed_blob, fdt_dts_size) == -1, "fdt_compact_check changed blob");
+    free(changed_blob);
+
+
+    /* allocator */
+    static fdt_node_t pool_nodes[8];
+    static fdt_prop_t pool_props[32];
+    fdt_pool_allocator_t pool;
+    fdt_unload();
+    fdt_pool_allocator_init(&pool, pool_nodes, 8, pool_props, 32, NULL);
+    ret = fdt_set_allocator(&pool.allocator);
+    ut_case(ret == 0 && fdt_load(fdt_dts_blob, fdt_dts_size) == 0 && pool.node.used == 4 && pool.prop.used == 27 &&
+            fdt_read_prop_int_by_path("/node2/subnode2", "int", &int_val) == 0 && int_val == 100 &&
+            fdt_set_allocator(NULL) == -1, "fdt_set_allocator pool");
+
+    fdt_unload();
+    fdt_pool_allocator_init(&pool, pool_nodes, 8, pool_props, 20, NULL);
+    fdt_set_allocator(&pool.allocator);
+    ret = fdt_load(fdt_dts_blob, fdt_dts_size);
+    ut_case(ret == -1 && pool.prop.used == 0 && pool.prop.peak == 20 && pool.node.used == 0, "fdt_set_allocator pool exhausted");
+
+    fdt_allocator_t fallback = {pool_test_alloc, pool_test_free, &int_val};
+    int_val = 0;
+    fdt_pool_allocator_init(&pool, pool_nodes, 2, pool_props, 20, &fallback);
+    fdt_set_allocator(&pool.allocator);
+    ret = fdt_load(fdt_dts_blob, fdt_dts_size);
+    ut_case(ret == 0 && pool.node.used == 2 && pool.prop.used == 20 && int_val == 2 + 7, "fdt_set_allocator pool fallback");
+    fdt_unload();
+    ut_case(int_val == 0 && pool.node.used == 0 && fdt_set_allocator(NULL) == 0, "fdt_set_allocator default");
+
+    // the worker frees the old tree while the waiter expands the new one
+    size_t pool_fallback = 0;
+    fallback.ctx = &pool_fallback;
+    fdt_pool_allocator_init(&pool, pool_nodes, 8, pool_props, 32, &fallback);
+    fdt_set_allocator(&pool.allocator);
+    ret = fdt_load_ex(fdt_dts_blob, fdt_dts_size, &lazy_opts);
+    for(int i = 0; i < 50 && ret == 0; i++) {
+        ret |= fdt_load_async(fdt_dts_blob, fdt_dts_size);
+        ret |= fdt_wait_node("/node2/subnode2", 1000) ? 0 : 1;
+        ret |= fdt_load_async_join();
+    }
+    fdt_unload();
+    ut_case(ret == 0 && pool.node.used == 0 && pool.prop.used == 0 && pool_fallback == 0 && pool.prop.peak == 32 &&
+            fdt_set_allocator(NULL) == 0, "fdt_set_allocator pool async");
+
+
+    /* memory budget */
+    fdt_mem_stats_t stats;
+    ret = fdt_load(fdt_dts_blob, fdt_dts_size);
+    ret |= fdt_get_mem_stats(&stats);
+    ut_case(ret == 0 && stats.node == 4 * sizeof(fdt_node_t) && stats.prop == 27 * sizeof(fdt_prop_t) &&
+            stats.slack == 0 && stats.total == fdt_debug_get_consume_bytes() &&
+            stats.total == stats.node + stats.prop + stats.index + stats.table && fdt_get_mem_stats(NULL) == -1,
+            "fdt_get_mem_stats");
+
+    uint64_t node_bytes = fdt_get_node_mem_bytes(fdt_find_node_by_path("/node1")) +
+                          fdt_get_node_mem_bytes(fdt_find_node_by_path("/node2"));
+    ut_case(fdt_get_node_mem_bytes(fdt_get_root_node()) == stats.node + stats.prop + stats.index &&
+            fdt_get_node_mem_bytes(fdt_find_node_by_path("/node1/subnode1")) == sizeof(fdt_node_t) + 3 * sizeof(fdt_prop_t) &&
+            node_bytes == fdt_get_node_mem_bytes(fdt_get_root_node()) &&
+            fdt_get_node_mem_bytes(NULL) == 0, "fdt_get_node_mem_bytes");
+
+    fdt_reset_mem_peak();
+    ret = fdt_load(fdt_dts_blob, fdt_dts_size);
+    fdt_get_mem_stats(&stats);
+    ut_case(ret == 0 && stats.peak == 2 * stats.total, "fdt_get_mem_stats peak");
+
+    ret = fdt_set_mem_budget(stats.total - 1);
+    ut_case(ret == 0 && fdt_load(fdt_dts_blob, fdt_dts_size) == -1 && fdt_find_node_by_path("/node1/subnode1") &&
+            fdt_load_parallel(fdt_dts_blob, fdt_dts_size, 2) == -1 && fdt_set_mem_budget(stats.total) == 0 &&
+            fdt_load(fdt_dts_blob, fdt_dts_size) == 0 && fdt_get_mem_stats(&stats) == 0 &&
+            stats.budget == stats.total && fdt_set_mem_budget(0) == 0, "fdt_set_mem_budget");
+
+    ret = fdt_load_parallel(fdt_dts_blob, fdt_dts_size, 2);
+    fdt_get_mem_stats(&stats);
+    ut_case(ret == 0 && stats.slack > 0 && stats.total == stats.node + stats.prop + stats.index + stats.table + stats.slack,
+            "fdt_get_mem_stats arena");
+
+    /* background load */
+    ret = fdt_load_async(fdt_dts_blob, fdt_dts_size);
+    fdt_node_t *waited = fdt_wait_node("/node1/subnode1", 1000);
+    ut_case(ret == 0 && waited && strcmp(waited->name, "subnode1") == 0 && fdt_wait_node("/node3", 1000) == NULL &&
+            fdt_read_prop_int(waited, "int", &int_val) == 0 && int_val == 100 && fdt_load_async_join() == 0 &&
+            fdt_find_node_by_path("/node2/subnode2"), "fdt_load_async");
+
+    ret = fdt_load_async(fdt_dts_blob, 3);
+    ut_case(fdt_load_async_join() == -1 && fdt_wait_node("/node1", 0) && fdt_load(fdt_dts_blob, fdt_dts_size) == 0,
+            "fdt_load_async failed keeps tree");
+
+    /* unload and reload */
+    ret = fdt_load(fdt_dts_blob, fdt_dts_size);
+    ut_case(ret == 0 && fdt_find_node_by_path("/fw") == NULL && fdt_find_node_by_path("/node1"), "fdt_load reload");
+
+    ret = fdt_load(fdt_dts_blob, 3);
+    ut_case(ret == -1 && fdt_find_node_by_path("/node1/subnode1"), "fdt_load failed keeps tree");
+
+    int epoch = fdt_read_begin();
+    node1 = fdt_find_node_by_name(NULL, "node1");
+    fdt_read_end(epoch);
+    ut_case(node1 && strcmp(node1->name, "node1") == 0, "fdt_read_begin");
+
+    fdt_unload();
+    ut_case(fdt_find_node_by_name(NULL, "node1") == NULL && fdt_debug_get_consume_bytes() == 0, "fdt_unload");
+
     printf("================== UNIT TEST END ================\n");
     return 0;
 }